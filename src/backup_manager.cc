@@ -10,48 +10,131 @@
  * 09/28/2014 - Handle missing files
  * 10/05/2014 - Initial DB integration
  * 12/22/2015 - New design
+ * 10/19/2026 - Configurable DB connection pool
+ * 10/19/2026 - Selectable DB backend
+ * 10/19/2026 - Compare against disk manifests when available
+ * 10/19/2026 - Configurable DB cache sizes
+ * 10/19/2026 - Optional Bloom filter for file lookups
+ * 10/19/2026 - Worker blocks on state changes instead of polling
+ * 10/19/2026 - Throttle scans by rate and host pressure
+ * 10/19/2026 - Per device limits from [Limits], idle I/O priority
+ * 10/19/2026 - Binary event log of scan results
+ * 10/19/2026 - Log rotation settings, SIGHUP reopens the log
+ * 10/19/2026 - Reload the config on SIGHUP, applied live
+ * 10/19/2026 - DB and log setup shared with SyncManager
  */
 
 #include <algorithm>
+#include <iostream>
+#include <cstdlib>
 #include <unistd.h>
 
 #include "config_parse.hpp"
 #include "backup_manager.hpp"
 #include "common.hpp"
+#include "db_sqlite.hpp"
+#include "sync_manager.hpp"
 
 
-BackupManager::BackupManager(const std::string& cfg) 
+// most connections db_pool_size can ask for, well under MySQL's
+// default max_connections of 151
+#define DB_POOL_MAX 128
+// most entries in either DB cache, db_cache_ids and db_cache_dirs
+#define DB_CACHE_MAX (1 << 24)
+// most MB db_bloom_max_mb can give the Bloom filter
+#define BLOOM_MAX_MB (1 << 20)
+
+
+// a record as its file is found on disk. A compressed sync copy is
+// found at its stored size and CRC
+static File as_stored(const File& f)
+{
+    File ret = f;
+
+    if (f.stored) {
+	ret.size = f.stored;
+	ret.crc = f.stored_crc;
+    }
+
+    return (ret);
+}
+
+
+// the record to write for a file found on disk as f, when the DB had
+// known. A compressed copy keeps the size and CRC of its data, what was
+// found is its stored size and CRC
+static File to_record(const File& f, const File& known)
+{
+    File ret = f;
+
+    if (known.stored) {
+	ret.size = known.size;
+	ret.crc = known.crc;
+	ret.stored = f.size;
+	ret.stored_crc = f.crc;
+    }
+
+    return (ret);
+}
+
+
+// settings that are only read at startup. A reload that changes
+// one of these warns that a restart is needed
+static const char* restart_settings[] = {
+    "log_path", "db_backend", "db_ip", "db_user", "db_pass", "db_pool_size", "db_path",
+    "db_cache_ids", "db_cache_dirs", "db_bloom_fp_rate", "db_bloom_max_mb", "manifest_dir",
+    "event_log", "io_idle", "priority", NULL
+};
+
+
+BackupManager::BackupManager(const std::string& cfg) : _cfg(cfg), _disks_changed(false)
 {
     try {
 	ConfigParse config(cfg);
+	_config = new ConfigParse(config);
 
 	_log = new Logger(config.get_value("Settings", "log_path"));
-	std::string level = config.get_value("Settings", "log_level");
-	std::string ip = config.get_value("Settings", "db_ip");
-	std::string pass = config.get_value("Settings", "db_pass");
-	std::string user = config.get_value("Settings", "db_user");
+	_db = open_db(config, _log);
+
+	std::string bloom_fp = config.get_value("Settings", "db_bloom_fp_rate");
+	std::string bloom_mb = config.get_value("Settings", "db_bloom_max_mb");
+	double fp_rate = 0;
+	int64_t max_mb = 64;
+	char *end;
+	if (!bloom_fp.empty()) {
+	    fp_rate = strtod(bloom_fp.c_str(), &end);
+	    if (end == bloom_fp.c_str() || *end != '\0' || !(fp_rate > 0 && fp_rate < 1)) {
+		throw ConfigParseEx("Invalid db_bloom_fp_rate \"" + bloom_fp + "\"");
+	    }
+	}
+	if (!bloom_mb.empty() && !parse_number(bloom_mb, max_mb, 1, BLOOM_MAX_MB)) {
+	    throw ConfigParseEx("Invalid db_bloom_max_mb \"" + bloom_mb + "\"");
+	}
 	
-	if (level.compare("DEBUG") == 0) {
-	    _log->set_level(DEBUG);
-	} else if (level.compare("INFO") == 0) {
-	    _log->set_level(INFO);
-	} else if (level.compare("WARNING") == 0) {
-	    _log->set_level(WARNING);
-	} else if (level.compare("ERROR") == 0) {
-	    _log->set_level(ERROR);
-	} else {
-	    _log->set_level(INFO);
+	if (!bloom_fp.empty() && SyncManager::wanted(config)) {
+	    // the sync adds files behind the filter's back
+	    LOG(*_log, WARNING) << "db_bloom_fp_rate is ignored when there is a [Sync] section"
+				<< std::endl;
+	} else if (!bloom_fp.empty()) {
+	    _db->enable_bloom(fp_rate, (uint64_t)max_mb << 20);
 	}
 
-	_db = new BackupManagerDB(ip, user, pass, _log);
-	_db->init_tables();
-	
-	ConfigParse::const_iterator it = config.begin("Dirs");
-	    
-	for (; it != config.end("Dirs"); ++it) {
-	    _disk_names.push_back(it->second);
+	_manifest_dir = config.get_value("Settings", "manifest_dir");
+
+	_events = NULL;
+	std::string events = config.get_value("Settings", "event_log");
+	if (!events.empty()) {
+	    _events = new EventLog();
+	    if (!_events->open(events)) {
+		throw ConfigParseEx("Cannot open event log \"" + events + "\"");
+	    }
 	}
-	    
+
+	_io_idle = (config.get_value("Settings", "io_idle") == "1");
+	_throttle = new Throttle(_log);
+	_throttles = new ThrottleRegistry(_throttle, _log);
+	
+	apply_config(config);
     } catch (ConfigParseEx& e) {
 	std::cerr << e.what() << std::endl;
 	exit(EXIT_FAILURE);
@@ -63,16 +146,21 @@ BackupManager::BackupManager(const std::string& cfg)
 
 BackupManager::~BackupManager()
 {
-    *_log << DEBUG << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
 
     set_state(SHUTDOWN);
+    _throttles->cancel();
     
     if (_main_thread.joinable()) {
 	_main_thread.join();
     }
 
-    *_log << DEBUG << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
 
+    delete _events;
+    delete _config;
+    delete _throttles;
+    delete _throttle;
     delete _db;
     delete _log;
 }
@@ -80,53 +168,321 @@ BackupManager::~BackupManager()
 
 void BackupManager::init()
 {
-   *_log << DEBUG << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+   LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
    
     set_state(INIT);
 
-    *_log << DEBUG << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
 }
 
 
 void BackupManager::run()
 {
-    *_log << DEBUG << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
     
     set_state(RUN);
     
-    *_log << DEBUG << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
 }
 
 
 void BackupManager::wait()
 {
-    *_log << DEBUG << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
     
     set_state(WAIT);
     
-    *_log << DEBUG << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
 }
 
 
 void BackupManager::shutdown()
 {
-    *_log << DEBUG << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
     
     set_state(SHUTDOWN);
+    // don't leave the worker paused on a busy host
+    _throttles->cancel();
+    
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+}
+
+
+/* Reopens the log and reloads the config. Everything but the settings
+ * in restart_settings takes effect straight away, and a scan in progress
+ * carries on where it was. A config that doesn't parse is ignored.
+ */
+void BackupManager::hangup()
+{
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+
+    _log->reopen();
+    LOG(*_log, INFO) << "Reloading " << _cfg << std::endl;
+
+    try {
+	ConfigParse config(_cfg);
+	mode_e m;
+	std::string first, second;
+
+	// the scheduler reloads its own settings, but can't say when
+	// they are wrong
+	if (!read_schedule(config, m, first, second) || !Scheduler::valid(m, first, second)) {
+	    LOG(*_log, ERROR) << "Invalid schedule in " << _cfg << ", keeping the current one"
+			      << std::endl;
+	}
+	
+	apply_config(config);
+	
+	for (uint32_t i = 0; restart_settings[i]; ++i) {
+	    if (config.get_value("Settings", restart_settings[i]) !=
+		_config->get_value("Settings", restart_settings[i])) {
+		LOG(*_log, WARNING) << "Changing " << restart_settings[i]
+				    << " needs a restart to take effect" << std::endl;
+	    }
+	}
+    } catch (std::exception& e) {
+	LOG(*_log, ERROR) << "Reload of " << _cfg << " failed: " << e.what() << std::endl;
+    }
     
-    *_log << DEBUG << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+}
+
+
+/* Reads the schedule settings, as used by Scheduler::configure. false if
+ * the mode isn't one we know.
+ */
+bool BackupManager::read_schedule(const ConfigParse& config, mode_e& m,
+				  std::string& first, std::string& second)
+{
+    std::string mode = config.get_value("Settings", "mode");
+
+    first.clear();
+    second.clear();
+    if (!mode.compare("RUN_STOP")) {
+	m = RUN_STOP;
+    } else if (!mode.compare("RUN_ALWAYS")) {
+	m = RUN_ALWAYS;
+    } else if (!mode.compare("RUN_WAIT")) {
+	m = RUN_WAIT;
+	first = config.get_value("Settings", "wait_time");
+    } else if (!mode.compare("WINDOW")) {
+	m = WINDOW;
+	// windows= takes a list of windows, otherwise a single daily
+	// window from start_time to stop_time
+	first = config.get_value("Settings", "windows");
+	if (first.empty()) {
+	    first = config.get_value("Settings", "start_time");
+	    second = config.get_value("Settings", "stop_time");
+	}
+    } else if (!mode.compare("CRON")) {
+	m = CRON;
+	first = config.get_value("Settings", "cron");
+    } else {
+	return (false);
+    }
+
+    return (true);
+}
+
+
+/* Connects to the DB given in [Settings]. Throws ConfigParseEx if the
+ * settings are wrong.
+ */
+BackupManagerDB* BackupManager::open_db(const ConfigParse& config, Logger *log)
+{
+    BackupManagerDB *db;
+    std::string backend = config.get_value("Settings", "db_backend");
+    std::string cache_ids = config.get_value("Settings", "db_cache_ids");
+    std::string cache_dirs = config.get_value("Settings", "db_cache_dirs");
+    int64_t ids = 65536, dirs = 64;
+
+    if (!cache_ids.empty() && !parse_number(cache_ids, ids, 0, DB_CACHE_MAX)) {
+	throw ConfigParseEx("Invalid db_cache_ids \"" + cache_ids + "\"");
+    }
+    if (!cache_dirs.empty() && !parse_number(cache_dirs, dirs, 0, DB_CACHE_MAX)) {
+	throw ConfigParseEx("Invalid db_cache_dirs \"" + cache_dirs + "\"");
+    }
+
+    if (backend.empty() || backend.compare("mysql") == 0) {
+#ifndef NO_MYSQL
+	std::string ip = config.get_value("Settings", "db_ip");
+	std::string pass = config.get_value("Settings", "db_pass");
+	std::string user = config.get_value("Settings", "db_user");
+	std::string pool = config.get_value("Settings", "db_pool_size");
+	int64_t size = 4;
+	
+	if (!pool.empty() && !parse_number(pool, size, 1, DB_POOL_MAX)) {
+	    throw ConfigParseEx("Invalid db_pool_size \"" + pool + "\"");
+	}
+	db = new BackupManagerDB(ip, user, pass, log, size);
+#else
+	throw ConfigParseEx("Built without MySQL support - set db_backend=sqlite");
+#endif
+    } else if (backend.compare("sqlite") == 0) {
+	std::string path = config.get_value("Settings", "db_path");
+	    
+	if (path.empty()) {
+	    throw ConfigParseEx("db_path is required when db_backend=sqlite");
+	}
+	db = new BackupManagerDB(new SQLiteBackend(path, log), log);
+    } else {
+	throw ConfigParseEx("Unknown db_backend \"" + backend + "\"");
+    }
+    db->init_tables();
+
+    // a SyncManager writes the same tables through its own connection,
+    // which the other's caches would never see, so both run uncached
+    if (SyncManager::wanted(config)) {
+	ids = dirs = 0;
+    }
+    db->set_cache_size(ids, dirs);
+    
+    return (db);
+}
+
+
+/* Applies log_level and the log rotation settings to log. Throws
+ * ConfigParseEx, without changing anything, if they are wrong.
+ */
+void BackupManager::configure_log(const ConfigParse& config, Logger *log)
+{
+    logger_level level = INFO;
+    std::string value = config.get_value("Settings", "log_level");
+    
+    if (value.compare("DEBUG") == 0) {
+	level = DEBUG;
+    } else if (value.compare("WARNING") == 0) {
+	level = WARNING;
+    } else if (value.compare("ERROR") == 0) {
+	level = ERROR;
+    }
+
+    // log rotation, off unless log_max_size or log_max_age is set.
+    // log_max_age is in seconds
+    double max_size = 0;
+    value = config.get_value("Settings", "log_max_size");
+    if (!value.empty() && !parse_rate(value, max_size)) {
+	throw ConfigParseEx("Invalid log_max_size \"" + value + "\"");
+    }
+    std::string max_age = config.get_value("Settings", "log_max_age");
+    std::string keep = config.get_value("Settings", "log_keep");
+    uint32_t age = max_age.empty() ? 0 : std::stoul(max_age);
+    uint32_t count = keep.empty() ? 0 : std::stoul(keep);
+    
+    log->set_level(level);
+    log->set_rotation(max_size, age, count, config.get_value("Settings", "log_compress") == "1");
+}
+
+
+static double read_threshold(const ConfigParse& config, const std::string& key)
+{
+    std::string value = config.get_value("Settings", key);
+    double ret = 0;
+    char *end;
+
+    if (value.empty()) {
+	return (ret);
+    }
+    ret = strtod(value.c_str(), &end);
+    if (end == value.c_str() || *end != '\0' || !(ret >= 0)) {
+	throw ConfigParseEx("Invalid " + key + " \"" + value + "\"");
+    }
+
+    return (ret);
+}
+
+
+/* Reads throttle_io_pressure, throttle_load and throttle_util, 0 when
+ * unset. Throws ConfigParseEx if one isn't a number 0 or over. Also
+ * used by SyncManager, whose copies pause for the same host pressure.
+ */
+void BackupManager::read_thresholds(const ConfigParse& config, double& pressure, double& load,
+				    double& util)
+{
+    pressure = read_threshold(config, "throttle_io_pressure");
+    load = read_threshold(config, "throttle_load");
+    util = read_threshold(config, "throttle_util");
+}
+
+
+/* The settings that can change while running: log level and rotation,
+ * throttling, [Limits] and [Dirs]. Everything is parsed before anything
+ * is applied, so a bad config changes nothing. The new [Dirs] list is
+ * picked up by the worker in update_disks().
+ */
+void BackupManager::apply_config(const ConfigParse& config)
+{
+    // 0 or unset turns a limit off. The limits here cover everything,
+    // the [Limits] section adds limits for the device under each [Dirs]
+    // entry, as bytes/sec,ops/sec
+    double bps = 0, iops = 0, pressure, load, util;
+    read_thresholds(config, pressure, load, util);
+    std::string value = config.get_value("Settings", "throttle_bps");
+    if (!value.empty() && !parse_rate(value, bps)) {
+	throw ConfigParseEx("Invalid throttle_bps \"" + value + "\"");
+    }
+    value = config.get_value("Settings", "throttle_iops");
+    if (!value.empty() && !parse_rate(value, iops)) {
+	throw ConfigParseEx("Invalid throttle_iops \"" + value + "\"");
+    }
+
+    std::vector<std::string> names;
+    std::vector<std::pair<std::string, std::pair<double, double> > > limits;
+    ConfigParse::const_iterator it = config.begin("Dirs");
+    
+    for (; it != config.end("Dirs"); ++it) {
+	names.push_back(it->second);
+	
+	std::string limit = config.get_value("Limits", it->first);
+	if (!limit.empty()) {
+	    size_t comma = limit.find(',');
+	    double dev_bps = 0, dev_iops = 0;
+	    if (!parse_rate(limit.substr(0, comma), dev_bps) ||
+		(comma != std::string::npos && !parse_rate(limit.substr(comma + 1), dev_iops))) {
+		throw ConfigParseEx("Invalid limit \"" + limit + "\" for " + it->first);
+	    }
+	    limits.push_back(std::make_pair(it->second, std::make_pair(dev_bps, dev_iops)));
+	}
+    }
+
+    configure_log(config, _log);
+    _throttle->set_limits(bps, iops);
+    _throttle->set_thresholds(pressure, load, 0);
+    _throttles->set_max_utilisation(util);
+
+    // devices that lost their limit go back to unlimited. Dirs on the
+    // same device share its limits, the last one set wins
+    for (uint32_t i = 0; i < _limited.size(); ++i) {
+	_limited[i]->set_limits(0, 0);
+    }
+    _limited.clear();
+    for (uint32_t i = 0; i < limits.size(); ++i) {
+	Throttle *t = _throttles->get(limits[i].first);
+	t->set_limits(limits[i].second.first, limits[i].second.second);
+	_limited.push_back(t);
+    }
+
+    std::lock_guard<std::mutex> l(_disks_lock);
+    _new_disk_names = names;
+    _disks_changed = true;
 }
 
 
 void BackupManager::worker()
 {
-    *_log << DEBUG << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
     
     Directory current_dir;
+
+    if (_io_idle && !set_io_idle()) {
+	LOG(*_log, WARNING) << "Could not set idle I/O priority" << std::endl;
+    }
     
     while (_state != SHUTDOWN) {
-	*_log << DEBUG << "Current state: " << state_to_str(_state) << std::endl;
-	switch (_state) {
+	state_e state = _state;
+	
+	LOG(*_log, DEBUG) << "Current state: " << state_to_str(state) << std::endl;
+	switch (state) {
 	case INIT:
 	    setup_disks();
 	    current_dir = next_dir();
@@ -139,31 +495,37 @@ void BackupManager::worker()
 		wait();
 	    }
 	    break;
-	case SHUTDOWN:
 	case NONE:
 	case WAIT:
+	    wait_for_change(state);
+	    break;
+	case SHUTDOWN:
 	    break;
 	default:
 	    assert(false);
 	}
-	sleep(1);
     }
 
-    *_log << DEBUG << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+    _db->thread_end();
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
 }
 
 
 void BackupManager::setup_disks()
 {
-    *_log << DEBUG << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
 
+    // a pass that is restarted never completed, so its
+    // manifest would be missing files
+    close_manifest(false);
     _disks.clear();
+    update_disks();
     
     for (uint32_t i = 0; i < _disk_names.size(); ++i) {
-	_disks.push_back(Disk(_disk_names[i], _log));
+	_disks.push_back(Disk(_disk_names[i], _log, _throttles->get(_disk_names[i])));
     }
 
-    *_log << DEBUG << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
 }
 
 
@@ -173,44 +535,141 @@ void BackupManager::setup_disks()
  */
 Directory BackupManager::next_dir()
 {
-    *_log << DEBUG << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
 
     Directory ret;
-    
+
+    update_disks();
     if (_disks.size()) {
+	if (_disks[0].mount() != _manifest_mount) {
+	    open_manifest();
+	}
 	ret = _disks[0].next_directory();
 	if (ret.empty()) {
+	    close_manifest(true);
+	    if (_events && !_events->flush()) {
+		LOG(*_log, ERROR) << "Failed to write event log" << std::endl;
+	    }
 	    _disks.erase(_disks.begin());
-	    *_log << DEBUG << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+	    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
 	    return next_dir();
 	}
     }
     
-    *_log << DEBUG << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
     return (ret);
 }
 
 
+/* Picks up a [Dirs] list changed by a reload. Disks that were removed
+ * stop being scanned, new ones join the pass in progress. Runs on the
+ * worker, so the pass never changes under it.
+ */
+void BackupManager::update_disks()
+{
+    std::vector<std::string> names;
+    
+    {
+	std::lock_guard<std::mutex> l(_disks_lock);
+	if (!_disks_changed) {
+	    return;
+	}
+	names.swap(_new_disk_names);
+	_disks_changed = false;
+    }
+
+    bool scanning = !_disks.empty();
+    
+    for (std::vector<Disk>::iterator it = _disks.begin(); it != _disks.end();) {
+	if (std::find(names.begin(), names.end(), it->mount()) == names.end()) {
+	    if (it->mount() == _manifest_mount) {
+		close_manifest(false);
+	    }
+	    it = _disks.erase(it);
+	} else {
+	    ++it;
+	}
+    }
+    
+    for (uint32_t i = 0; i < _disk_names.size(); ++i) {
+	if (std::find(names.begin(), names.end(), _disk_names[i]) == names.end()) {
+	    LOG(*_log, INFO) << "No longer scanning " << _disk_names[i] << std::endl;
+	}
+    }
+    for (uint32_t i = 0; i < names.size(); ++i) {
+	if (std::find(_disk_names.begin(), _disk_names.end(), names[i]) == _disk_names.end()) {
+	    if (!_disk_names.empty()) {
+		LOG(*_log, INFO) << "Now scanning " << names[i] << std::endl;
+	    }
+	    if (scanning) {
+		_disks.push_back(Disk(names[i], _log, _throttles->get(names[i])));
+	    }
+	}
+    }
+
+    _disk_names = names;
+}
+
+
 void BackupManager::check_dir(Directory& d)
 {
-    *_log << DEBUG << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
     if (d.empty()) {
-	*_log << DEBUG << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+	LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
 	return;
     }
 
+    uint64_t first, last;
+    
+    if (_manifest.find(d.path, first, last)) {
+	check_dir_manifest(d, first, last);
+    } else {
+	check_dir_db(d);
+    }
+
+    if (!_manifest_dir.empty()) {
+	for (file_cit it = d.files.cbegin(); it != d.files.cend(); ++it) {
+	    _manifest_out.add(it->second);
+	}
+    }
+    
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+}
+
+
+void BackupManager::check_dir_db(Directory& d)
+{
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+
     Directory from_db = _db->get(d);
+    Directory expected = from_db;
+
+    // compared as the files are stored, not as the data they hold
+    for (file_it it = expected.files.begin(); it != expected.files.end(); ++it) {
+	it->second = as_stored(it->second);
+    }
 
     if (!from_db.files.size()) {
 	_db->insert(d);
-    } else if (d != from_db) {
+	for (file_cit it = d.files.cbegin(); it != d.files.cend(); ++it) {
+	    event(EVENT_NEW, it->second);
+	}
+    } else if (d != expected) {
 	if (from_db.files.size() > d.files.size()) {
-	    *_log << WARNING << "Database entry for directory " << d.path << " has more files "
+	    LOG(*_log, WARNING) << "Database entry for directory " << d.path << " has more files "
 		" than disk" << std::endl;
-	    for (file_cit it = from_db.files.cbegin(); it != from_db.files.cend(); ++it) {
-		if (d.files.find(it->first) == d.files.end()) {
-		    *_log << WARNING << "File " << it->second <<
-			" is in DB but not on disk." << std::endl;
+	}
+	// a file can go missing as another is added, so every record is
+	// looked for whatever the counts
+	for (file_cit it = from_db.files.cbegin(); it != from_db.files.cend(); ++it) {
+	    if (d.files.find(it->first) == d.files.end()) {
+		LOG(*_log, WARNING) << "File " << it->second <<
+		    " is in DB but not on disk." << std::endl;
+		event(EVENT_MISSING, it->second);
+		// the DB keeps its record, so the next manifest does too and
+		// the file is reported again by the manifest pass
+		if (!_manifest_dir.empty()) {
+		    _manifest_out.add(it->second);
 		}
 	    }
 	}
@@ -218,16 +677,169 @@ void BackupManager::check_dir(Directory& d)
 	    file_it from_db_it = from_db.files.find(it->first);
 	    if (from_db_it == from_db.files.end()) {
 		_db->insert(it->second);
+		event(EVENT_NEW, it->second);
 	    } else {
-		if (from_db_it->second != it->second) {
-		    *_log << WARNING << "File " << it->second << " does NOT match DB record!"
-			  << std::endl;
+		File known = as_stored(from_db_it->second);
+		
+		if (known != it->second) {
+		    LOG(*_log, WARNING) << "File " << it->second << " does NOT match DB record!"
+					<< std::endl;
+		    event(EVENT_MISMATCH, it->second, known);
+		} else {
+		    event(EVENT_CHECKED, it->second);
 		}
 		it->second.checked = std::time(NULL);
-		_db->update(it->second);
+		_db->update(to_record(it->second, from_db_it->second));
 	    }   
 	}
+    } else {
+	for (file_it it = d.files.begin(); it != d.files.end(); ++it) {
+	    it->second.checked = from_db.files[it->first].checked;
+	    event(EVENT_CHECKED, it->second);
+	}
+    }
+    
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+}
+
+
+/* Same checks as check_dir_db, but against the disk's manifest from the
+ * last completed pass instead of the DB. Both sides are sorted by name
+ * and walked together, so the DB is only read when something changed.
+ */
+void BackupManager::check_dir_manifest(Directory& d, const uint64_t first, const uint64_t last)
+{
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+
+    std::vector<File*> on_disk;
+    std::vector<File*> to_update;
+    std::vector<File*> to_insert;
+    bool changed = false;
+    
+    for (file_it it = d.files.begin(); it != d.files.end(); ++it) {
+	on_disk.push_back(&it->second);
+    }
+    std::sort(on_disk.begin(), on_disk.end(), [](const File *a, const File *b) {
+	    return (a->name.compare(b->name) < 0);
+	});
+
+    if (last - first > on_disk.size()) {
+	LOG(*_log, WARNING) << "Database entry for directory " << d.path << " has more files "
+	    " than disk" << std::endl;
+    }
+    
+    uint64_t i = first;
+    uint32_t j = 0;
+    
+    while (i < last || j < on_disk.size()) {
+	int c;
+	
+	if (i == last) {
+	    c = 1;
+	} else if (j == on_disk.size()) {
+	    c = -1;
+	} else {
+	    c = _manifest.compare_name(i, on_disk[j]->name);
+	}
+
+	if (c < 0) {
+	    File known = _manifest.record(i);
+	    
+	    LOG(*_log, WARNING) << "File " << known << " is in DB but not on disk." << std::endl;
+	    event(EVENT_MISSING, known);
+	    // the DB keeps its record, so the next manifest does too and
+	    // the file is reported again next pass
+	    _manifest_out.add(known);
+	    changed = true;
+	    ++i;
+	} else if (c > 0) {
+	    to_insert.push_back(on_disk[j]);
+	    event(EVENT_NEW, *on_disk[j]);
+	    changed = true;
+	    ++j;
+	} else {
+	    File known = _manifest.record(i);
+	    
+	    if (known != *on_disk[j]) {
+		LOG(*_log, WARNING) << "File " << *on_disk[j] << " does NOT match DB record!"
+				    << std::endl;
+		event(EVENT_MISMATCH, *on_disk[j], known);
+		changed = true;
+	    } else {
+		event(EVENT_CHECKED, *on_disk[j]);
+	    }
+	    on_disk[j]->checked = known.checked;
+	    to_update.push_back(on_disk[j]);
+	    ++i;
+	    ++j;
+	}
     }
+
+    // as with the DB check, records are only touched if the
+    // directory as a whole differs from what we knew. The manifest has
+    // files as they are stored, so the DB is read for the size and CRC
+    // of the data in compressed copies
+    if (changed) {
+	Directory known = to_update.empty() ? Directory() : _db->get(d);
+	
+	for (uint32_t k = 0; k < to_insert.size(); ++k) {
+	    _db->insert(*to_insert[k]);
+	}
+	for (uint32_t k = 0; k < to_update.size(); ++k) {
+	    file_cit it = known.files.find(to_update[k]->name);
+	    
+	    to_update[k]->checked = std::time(NULL);
+	    _db->update(it == known.files.cend() ? *to_update[k] :
+			to_record(*to_update[k], it->second));
+	}
+    }
+    
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+}
+
+
+void BackupManager::event(const event_type_e type, const File& f, const File& old)
+{
+    if (_events) {
+	_events->log(Event(type, f, old));
+    }
+}
+
+
+void BackupManager::open_manifest()
+{
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+
+    _manifest.close();
+    _manifest_out.clear();
+    _manifest_mount = _disks[0].mount();
+
+    if (!_manifest_dir.empty()) {
+	std::string path = manifest_path(_manifest_dir, _manifest_mount);
+	if (!_manifest.open(path)) {
+	    LOG(*_log, INFO) << "No usable manifest " << path << ", checking against the DB"
+			     << std::endl;
+	}
+    }
+    
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+}
+
+
+void BackupManager::close_manifest(const bool save)
+{
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+
+    if (save && !_manifest_dir.empty() && !_manifest_mount.empty()) {
+	std::string path = manifest_path(_manifest_dir, _manifest_mount);
+	if (!_manifest_out.write(path)) {
+	    LOG(*_log, ERROR) << "Failed to write manifest " << path << std::endl;
+	}
+    }
+
+    _manifest.close();
+    _manifest_out.clear();
+    _manifest_mount.clear();
     
-    *_log << DEBUG << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
 }
@@ -8,6 +8,13 @@
  *
  * 09/21/2014 - Initial open source release
  * 12/22/2015 - New design
+ * 10/19/2026 - Disk manifests
+ * 10/19/2026 - I/O throttling
+ * 10/19/2026 - Per device limits, idle I/O priority
+ * 10/19/2026 - Binary event log
+ * 10/19/2026 - Log rotation, hangup
+ * 10/19/2026 - Live config reload
+ * 10/19/2026 - DB and log setup shared with SyncManager
  */
 
 #ifndef __BACKUP_MANAGER__
@@ -16,11 +23,17 @@
 #include <vector>
 #include <string>
 #include <thread>
+#include <mutex>
 
 #include "schedulable.hpp"
+#include "scheduler.hpp"
+#include "config_parse.hpp"
 #include "logger.hpp"
 #include "db.hpp"
 #include "disk.hpp"
+#include "manifest.hpp"
+#include "throttle.hpp"
+#include "event_log.hpp"
 
 
 class BackupManager : public Schedulable {
@@ -32,18 +45,50 @@ public:
     void run();
     void wait();
     void shutdown();
+    void hangup();
+
+    static bool read_schedule(const ConfigParse&, mode_e&, std::string&, std::string&);
+    // also used by SyncManager
+    static BackupManagerDB* open_db(const ConfigParse&, Logger*);
+    static void configure_log(const ConfigParse&, Logger*);
+    static void read_thresholds(const ConfigParse&, double&, double&, double&);
 
 private:
+    void apply_config(const ConfigParse&);
     void worker();
     void setup_disks();
+    void update_disks();
     Directory next_dir();
     void check_dir(Directory&);
+    void check_dir_db(Directory&);
+    void check_dir_manifest(Directory&, const uint64_t, const uint64_t);
+    void event(const event_type_e, const File&, const File& = File());
+    void open_manifest();
+    void close_manifest(const bool);
     
     std::thread _main_thread;
+    std::string _cfg;
+    // the config as read at startup
+    ConfigParse *_config;
     std::vector<std::string> _disk_names;
     std::vector<Disk> _disks;
+    std::string _manifest_dir;
+    std::string _manifest_mount;
+    Manifest _manifest;
+    ManifestWriter _manifest_out;
     Logger *_log;
     BackupManagerDB *_db;
+    Throttle *_throttle;
+    ThrottleRegistry *_throttles;
+    // device throttles with limits from [Limits]
+    std::vector<Throttle*> _limited;
+    EventLog *_events;
+    bool _io_idle;
+
+    // a reloaded [Dirs] list, waiting for the worker
+    std::mutex _disks_lock;
+    std::vector<std::string> _new_disk_names;
+    bool _disks_changed;
 };
 
 #endif
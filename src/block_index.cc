@@ -0,0 +1,151 @@
+/* Backup Manager Block Index
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <zlib.h>
+#include <openssl/sha.h>
+
+#include "block_index.hpp"
+#include "common.hpp"
+
+
+BlockIndex::BlockIndex(const uint32_t block) : _block(block), _size(0) {}
+
+
+bool BlockIndex::load(const std::string& path, const struct stat& s)
+{
+    block_index_header_st h;
+    FILE *fp = fopen(path.c_str(), "r");
+
+    if (!fp) {
+	return (false);
+    }
+
+    bool ok = (fread(&h, sizeof(h), 1, fp) == 1 &&
+	       memcmp(h.magic, BLOCK_INDEX_MAGIC, 4) == 0 &&
+	       h.version == BLOCK_INDEX_VERSION && h.block == _block &&
+	       h.size == (uint64_t)s.st_size && h.ino == (uint64_t)s.st_ino &&
+	       h.mtime_sec == s.st_mtim.tv_sec && h.mtime_nsec == s.st_mtim.tv_nsec &&
+	       h.count == (h.size + _block - 1) / _block);
+    if (ok) {
+	_sums.resize(h.count);
+	ok = (h.count == 0 || fread(_sums.data(), sizeof(block_sum_st), h.count, fp) == h.count);
+    }
+    fclose(fp);
+
+    _size = ok ? h.size : 0;
+    if (!ok) {
+	_sums.clear();
+    }
+
+    return (ok);
+}
+
+
+// written to a temporary file and renamed, like a manifest
+bool BlockIndex::save(const std::string& path, const struct stat& s) const
+{
+    block_index_header_st h;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, BLOCK_INDEX_MAGIC, 4);
+    h.version = BLOCK_INDEX_VERSION;
+    h.block = _block;
+    h.count = _sums.size();
+    h.size = s.st_size;
+    h.ino = s.st_ino;
+    h.mtime_sec = s.st_mtim.tv_sec;
+    h.mtime_nsec = s.st_mtim.tv_nsec;
+
+    if (h.size != _size) {
+	return (false);
+    }
+
+    std::string tmp = path + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "w");
+    if (!fp) {
+	return (false);
+    }
+
+    bool ok = (fwrite(&h, sizeof(h), 1, fp) == 1);
+    if (ok && _sums.size()) {
+	ok = (fwrite(_sums.data(), sizeof(block_sum_st), _sums.size(), fp) == _sums.size());
+    }
+    ok = (fflush(fp) == 0) && ok;
+    ok = (fsync(fileno(fp)) == 0) && ok;
+    ok = (fclose(fp) == 0) && ok;
+
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+	remove(tmp.c_str());
+	return (false);
+    }
+
+    return (true);
+}
+
+
+void BlockIndex::resize(const uint64_t size)
+{
+    _size = size;
+    _sums.resize((size + _block - 1) / _block);
+}
+
+
+uint32_t BlockIndex::block() const
+{
+    return (_block);
+}
+
+
+bool BlockIndex::get(const uint64_t i, const uint32_t len, block_sum_st& sum) const
+{
+    if (i >= _sums.size() || std::min((uint64_t)_block, _size - i * _block) != len) {
+	return (false);
+    }
+
+    sum = _sums[i];
+    return (true);
+}
+
+
+void BlockIndex::set(const uint64_t i, const block_sum_st& sum)
+{
+    _sums[i] = sum;
+}
+
+
+block_sum_st BlockIndex::sum(const uint8_t *ptr, const size_t len)
+{
+    block_sum_st ret;
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+
+    ret.weak = adler32(adler32(0, NULL, 0), ptr, len);
+    SHA256(ptr, len, digest);
+    memcpy(ret.strong, digest, BLOCK_STRONG_LEN);
+
+    return (ret);
+}
+
+
+bool BlockIndex::same(const block_sum_st& a, const block_sum_st& b)
+{
+    return (a.weak == b.weak && memcmp(a.strong, b.strong, BLOCK_STRONG_LEN) == 0);
+}
+
+
+std::string block_index_path(const std::string& dir, const std::string& file)
+{
+    return (dir + "/" + escape_path(file) + ".bmi");
+}
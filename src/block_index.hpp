@@ -0,0 +1,94 @@
+/* Backup Manager Block Index
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#ifndef __BLOCK_INDEX__
+#define __BLOCK_INDEX__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+/* A block index holds the checksums of every fixed size block of one
+ * file, so a later copy over it can tell which blocks have changed
+ * without reading the file. On disk it is laid out as:
+ *
+ *     block_index_header_st
+ *     block_sum_st[count]
+ *
+ * All integers are stored in host byte order. The header records the
+ * file as it was when the index was taken, an index for a file that has
+ * changed since is not used.
+ */
+#define BLOCK_INDEX_MAGIC   "BMBI"
+#define BLOCK_INDEX_VERSION 1
+// bytes of the SHA-256 of a block that are kept
+#define BLOCK_STRONG_LEN    16
+
+struct block_index_header_st {
+    char     magic[4];
+    uint32_t version;
+    uint32_t block;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t size;
+    uint64_t ino;
+    int64_t  mtime_sec;
+    int64_t  mtime_nsec;
+};
+
+// the Adler-32 of a block, checked first, and its SHA-256
+struct block_sum_st {
+    uint32_t weak;
+    uint8_t  strong[BLOCK_STRONG_LEN];
+};
+
+static_assert(sizeof(block_index_header_st) == 56, "block index header must be 56 bytes");
+static_assert(sizeof(block_sum_st) == 20, "block sum must be 20 bytes");
+
+
+class BlockIndex {
+public:
+    BlockIndex(const uint32_t block);
+
+    // loads the index at path, true only if it was taken of a file
+    // that still looks like s
+    bool load(const std::string& path, const struct stat& s);
+    // writes the index for a file that now looks like s
+    bool save(const std::string& path, const struct stat& s) const;
+
+    // makes room for every block of a file of size bytes
+    void resize(const uint64_t size);
+    uint32_t block() const;
+    // the sums of block i, which is len bytes long. Fails if the index
+    // has no block i of that length
+    bool get(const uint64_t i, const uint32_t len, block_sum_st& sum) const;
+    // blocks can be set from several threads at once, as long as no
+    // two set the same one
+    void set(const uint64_t i, const block_sum_st& sum);
+
+    static block_sum_st sum(const uint8_t *ptr, const size_t len);
+    static bool same(const block_sum_st&, const block_sum_st&);
+
+private:
+    uint32_t _block;
+    uint64_t _size;
+    std::vector<block_sum_st> _sums;
+};
+
+
+// path of the index of file, kept in directory dir
+std::string block_index_path(const std::string& dir, const std::string& file);
+
+#endif
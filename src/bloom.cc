@@ -0,0 +1,106 @@
+/* Bloom Filter
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <functional>
+
+#include "bloom.hpp"
+
+
+BloomFilter::BloomFilter(const uint64_t expected, const double fp_rate, const uint64_t max_bytes)
+{
+    assert(fp_rate > 0.0 && fp_rate < 1.0);
+    assert(max_bytes >= sizeof(uint64_t));
+    
+    const double ln2 = std::log(2.0);
+    uint64_t n = std::max<uint64_t>(expected, 1);
+    
+    // optimal number of bits is -n * ln(p) / ln(2)^2, rounded up to whole words
+    _bits = (uint64_t)std::ceil(-(double)n * std::log(fp_rate) / (ln2 * ln2));
+    _bits = std::min(_bits, max_bytes * 8);
+    _bits = std::max<uint64_t>((_bits + 63) & ~63ULL, 64);
+
+    // and the optimal number of hash functions is (m / n) * ln(2)
+    _hashes = (uint32_t)std::round((double)_bits / n * ln2);
+    _hashes = std::min<uint32_t>(std::max<uint32_t>(_hashes, 1), 16);
+    
+    _words.reset(new std::atomic<uint64_t>[_bits / 64]);
+    clear();
+}
+
+
+void BloomFilter::clear()
+{
+    for (uint64_t i = 0; i < _bits / 64; ++i) {
+	_words[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+
+uint64_t BloomFilter::bits() const
+{
+    return (_bits);
+}
+
+
+uint32_t BloomFilter::hashes() const
+{
+    return (_hashes);
+}
+
+
+/* Two independent 64 bit hashes, combined by double hashing to get
+ * the k bit positions (Kirsch and Mitzenmacher).
+ */
+void BloomFilter::hash(const std::string& key, uint64_t& h1, uint64_t& h2) const
+{
+    h1 = std::hash<std::string>()(key);
+
+    // FNV-1a
+    h2 = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < key.size(); ++i) {
+	h2 ^= (uint8_t)key[i];
+	h2 *= 0x100000001b3ULL;
+    }
+    // an odd step visits distinct positions
+    h2 |= 1;
+}
+
+
+void BloomFilter::add(const std::string& key)
+{
+    uint64_t h1, h2;
+    hash(key, h1, h2);
+
+    for (uint32_t i = 0; i < _hashes; ++i) {
+	uint64_t bit = (h1 + i * h2) % _bits;
+	_words[bit / 64].fetch_or(1ULL << (bit % 64), std::memory_order_relaxed);
+    }
+}
+
+
+bool BloomFilter::maybe_contains(const std::string& key) const
+{
+    uint64_t h1, h2;
+    hash(key, h1, h2);
+
+    for (uint32_t i = 0; i < _hashes; ++i) {
+	uint64_t bit = (h1 + i * h2) % _bits;
+	if (!(_words[bit / 64].load(std::memory_order_relaxed) & (1ULL << (bit % 64)))) {
+	    return (false);
+	}
+    }
+    
+    return (true);
+}
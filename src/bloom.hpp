@@ -0,0 +1,49 @@
+/* Bloom Filter
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#ifndef __BLOOM__
+#define __BLOOM__
+
+#include <string>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+
+/* Probabilistic set membership. maybe_contains() never returns false for a
+ * key that was added, but may return true for one that was not. add() and
+ * maybe_contains() can be called concurrently.
+ */
+class BloomFilter {
+public:
+    // sized for expected keys at the given false positive rate, but never
+    // more than max_bytes of memory
+    BloomFilter(const uint64_t expected, const double fp_rate, const uint64_t max_bytes);
+    BloomFilter(const BloomFilter&) = delete;
+    BloomFilter &operator=(const BloomFilter&) = delete;
+    
+    void add(const std::string&);
+    bool maybe_contains(const std::string&) const;
+    void clear();
+    
+    uint64_t bits() const;
+    uint32_t hashes() const;
+
+private:
+    void hash(const std::string&, uint64_t&, uint64_t&) const;
+    
+    uint64_t _bits;
+    uint32_t _hashes;
+    std::unique_ptr<std::atomic<uint64_t>[]> _words;
+};
+
+#endif
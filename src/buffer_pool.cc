@@ -0,0 +1,183 @@
+/* Buffer Pool
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#include <cstdlib>
+#include <sys/mman.h>
+
+#include "buffer_pool.hpp"
+
+
+// buffers of each size a thread keeps for itself
+#define BUFFER_THREAD_KEEP 2
+// most memory the shared list holds
+#define BUFFER_POOL_MAX    (256ULL * 1024 * 1024)
+
+
+// the buffers one thread keeps, given to the shared list when it exits
+typedef struct buffer_cache_st {
+    std::vector<uint8_t*> free[BUFFER_CLASSES];
+
+    ~buffer_cache_st()
+    {
+	for (uint32_t c = 0; c < BUFFER_CLASSES; ++c) {
+	    for (size_t i = 0; i < free[c].size(); ++i) {
+		BufferPool::instance().push(c, free[c][i]);
+	    }
+	}
+    }
+} buffer_cache_st;
+
+
+static buffer_cache_st& thread_cache()
+{
+    static thread_local buffer_cache_st cache;
+    return (cache);
+}
+
+
+static size_t class_size(const uint32_t c)
+{
+    return ((size_t)BUFFER_ALIGN << c);
+}
+
+
+// BUFFER_CLASSES if size is too big to keep
+static uint32_t size_class(const size_t size)
+{
+    uint32_t c = 0;
+    
+    while (c < BUFFER_CLASSES && class_size(c) < size) {
+	++c;
+    }
+
+    return (c);
+}
+
+
+static uint8_t *allocate(const size_t size)
+{
+    void *ret = NULL;
+    bool huge = (size >= BUFFER_HUGE);
+    
+    if (posix_memalign(&ret, huge ? BUFFER_HUGE : BUFFER_ALIGN, size) != 0) {
+	return (NULL);
+    }
+    // only a hint, it's fine if transparent huge pages are off
+    if (huge) {
+	madvise(ret, size, MADV_HUGEPAGE);
+    }
+
+    return ((uint8_t *)ret);
+}
+
+
+BufferPool::BufferPool() : _cached(0) {}
+
+
+// never destroyed, threads can give their buffers back as late as exit
+BufferPool& BufferPool::instance()
+{
+    static BufferPool *pool = new BufferPool();
+    return (*pool);
+}
+
+
+uint8_t *BufferPool::get(const size_t size)
+{
+    uint32_t c = size_class(size);
+    uint8_t *ret;
+    
+    if (c == BUFFER_CLASSES) {
+	return (allocate((size + BUFFER_ALIGN - 1) & ~((size_t)BUFFER_ALIGN - 1)));
+    }
+
+    std::vector<uint8_t*>& local = thread_cache().free[c];
+    if (!local.empty()) {
+	ret = local.back();
+	local.pop_back();
+	return (ret);
+    }
+    
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	if (!_free[c].empty()) {
+	    ret = _free[c].back();
+	    _free[c].pop_back();
+	    _cached -= class_size(c);
+	    return (ret);
+	}
+    }
+
+    return (allocate(class_size(c)));
+}
+
+
+void BufferPool::put(uint8_t *buffer, const size_t size)
+{
+    uint32_t c = size_class(size);
+
+    if (!buffer) {
+	return;
+    }
+    if (c == BUFFER_CLASSES) {
+	free(buffer);
+	return;
+    }
+
+    std::vector<uint8_t*>& local = thread_cache().free[c];
+    if (local.size() < BUFFER_THREAD_KEEP) {
+	local.push_back(buffer);
+	return;
+    }
+    push(c, buffer);
+}
+
+
+uint64_t BufferPool::cached()
+{
+    std::lock_guard<std::mutex> l(_lock);
+    return (_cached);
+}
+
+
+void BufferPool::push(const uint32_t c, uint8_t *buffer)
+{
+    std::lock_guard<std::mutex> l(_lock);
+
+    if (_cached + class_size(c) > BUFFER_POOL_MAX) {
+	free(buffer);
+	return;
+    }
+    _free[c].push_back(buffer);
+    _cached += class_size(c);
+}
+
+
+Buffer::Buffer(const size_t size) : _data(BufferPool::instance().get(size)), _size(size) {}
+
+
+Buffer::~Buffer()
+{
+    BufferPool::instance().put(_data, _size);
+}
+
+
+uint8_t *Buffer::data() const
+{
+    return (_data);
+}
+
+
+size_t Buffer::size() const
+{
+    return (_size);
+}
@@ -0,0 +1,83 @@
+/* Buffer Pool
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#ifndef __BUFFER_POOL__
+#define __BUFFER_POOL__
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+
+// buffers are aligned to, and a multiple of, this many bytes, which is
+// enough for O_DIRECT
+#define BUFFER_ALIGN   4096
+// sizes are rounded up to a power of two times BUFFER_ALIGN, up to 64 MB.
+// Larger buffers aren't kept
+#define BUFFER_CLASSES 15
+// buffers this size and up are aligned for huge pages, and asked to be
+// backed by them
+#define BUFFER_HUGE    (2 * 1024 * 1024)
+
+
+struct buffer_cache_st;
+
+/* Buffers for reads, writes and checksums, kept for reuse rather than
+ * freed. Each thread keeps a couple of each size it has used, so most
+ * gets and puts don't take a lock. Buffers a thread has no room for, or
+ * still has when it exits, go to a list shared by every thread, up to a
+ * limit on the memory held there.
+ */
+class BufferPool {
+public:
+    static BufferPool& instance();
+    BufferPool(const BufferPool&) = delete;
+    BufferPool &operator=(const BufferPool&) = delete;
+
+    // a buffer of at least size bytes, NULL if there is no memory
+    uint8_t *get(const size_t size);
+    // gives back a buffer from get(), with the size it was asked for
+    void put(uint8_t *buffer, const size_t size);
+    // bytes held in the shared list
+    uint64_t cached();
+
+private:
+    friend struct buffer_cache_st;
+    
+    BufferPool();
+    void push(const uint32_t, uint8_t *);
+    
+    std::mutex _lock;
+    std::vector<uint8_t*> _free[BUFFER_CLASSES];
+    uint64_t _cached;
+};
+
+
+// a buffer from the pool for as long as it is in scope
+class Buffer {
+public:
+    Buffer(const size_t size);
+    Buffer(const Buffer&) = delete;
+    Buffer &operator=(const Buffer&) = delete;
+    ~Buffer();
+
+    // NULL if there was no memory
+    uint8_t *data() const;
+    size_t size() const;
+
+private:
+    uint8_t *_data;
+    size_t _size;
+};
+
+#endif
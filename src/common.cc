@@ -9,22 +9,44 @@
  * 04/26/2014 - Initial open source release
  * 09/01/2014 - Copy Routines
  * 01/08/2017 - static analysis fix
+ * 10/19/2026 - Throttled copy routines
+ * 10/19/2026 - copylinux and copyposix report failures, don't leak fds
+ * 10/19/2026 - copyclone and copyrange, copyz handles short splices
+ * 10/19/2026 - copyposix, copylinux and copyrange keep holes
+ * 10/19/2026 - copyposix can compute the CRC of what it copies
+ * 10/19/2026 - escape_path, from manifest_path
+ * 10/19/2026 - destinations truncated, short writes and failed closes reported
+ * 10/19/2026 - buffers from the BufferPool
+ * 10/19/2026 - read_block and write_block, from the copy engine
  *
  */
 
 
 #include <fstream>
+#include <functional>
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cctype>
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
 #include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <linux/fs.h>
+
 #include "common.hpp"
+#include "crc32.hpp"
+#include "buffer_pool.hpp"
+
 
+#define SENDFILE_CHUNK (1 << 20)
+// zeros written where a hole can't be punched
+#define ZERO_CHUNK (64 * 1024)
 
 
 ssize_t readall(const int& fd, uint8_t *buffer, const ssize_t& len)
@@ -32,8 +54,11 @@ ssize_t readall(const int& fd, uint8_t *buffer, const ssize_t& len)
     ssize_t bytes_read = 0;
     ssize_t total_read = 0;
     
-    while((len != total_read) && (bytes_read = read(fd, buffer, len)) != 0) {
-	if ((bytes_read == -1) && (errno != EINTR)) {
+    while((len != total_read) && (bytes_read = read(fd, buffer, len - total_read)) != 0) {
+	if (bytes_read == -1) {
+	    if (errno == EINTR) {
+		continue;
+	    }
 	    return (-1);
 	}
 	
@@ -45,63 +70,367 @@ ssize_t readall(const int& fd, uint8_t *buffer, const ssize_t& len)
 }
 
 
-bool copyz(const char *in, const char *out, const uint32_t chunk)
+bool read_block(const int fd, uint8_t *buffer, const size_t len, const off_t pos, Throttle *t)
 {
-    int p[2];
+    size_t done = 0;
 
-    if (pipe(p) != 0) {
-	return (false);
+    while (done < len) {
+	ssize_t bytes = pread(fd, buffer + done, len - done, pos + done);
+	if (bytes < 0 && errno == EINTR) {
+	    continue;
+	}
+	if (bytes <= 0) {
+	    return (false);
+	}
+	if (t) {
+	    t->consume(bytes);
+	}
+	done += bytes;
     }
 
-    int out_fd = open(out, O_RDWR | O_CREAT, 0777);
-    int in_fd = open(in, O_RDONLY);
+    return (true);
+}
+
+
+bool write_block(const int fd, const uint8_t *buffer, const size_t len, const off_t pos,
+		 Throttle *t)
+{
+    size_t done = 0;
+
+    while (done < len) {
+	ssize_t bytes = pwrite(fd, buffer + done, len - done, pos + done);
+	if (bytes < 0 && errno == EINTR) {
+	    continue;
+	}
+	if (bytes < 0) {
+	    return (false);
+	}
+	if (t) {
+	    t->consume(bytes);
+	}
+	done += bytes;
+    }
+
+    return (true);
+}
+
+
+std::string escape_path(const std::string& path)
+{
+    std::string ret;
     
-    if (in_fd < 0 || out_fd < 0) {
+    for (size_t i = 0; i < path.size(); ++i) {
+	if (path[i] == '/') {
+	    ret += "%2F";
+	} else if (path[i] == '%') {
+	    ret += "%25";
+	} else {
+	    ret += path[i];
+	}
+    }
+
+    return (ret);
+}
+
+
+bool parse_number(const std::string& s, int64_t& value, const int64_t min, const int64_t max)
+{
+    char *end;
+
+    // strtoll would skip leading spaces
+    if (s.empty() || isspace(s[0])) {
 	return (false);
     }
-    
-    while(splice(p[0], 0, out_fd, 0, splice(in_fd, 0, p[1], 0, chunk, 0), 0)>0);
+    errno = 0;
+    value = strtoll(s.c_str(), &end, 10);
 
-    close(out_fd);
-    close(in_fd);
+    return (*end == '\0' && errno == 0 && value >= min && value <= max);
+}
+
+
+static inline void charge(Throttle *t, const uint64_t bytes)
+{
+    if (t) {
+	t->consume(bytes);
+    }
+}
+
+
+// opens both files, or neither. out is only created or truncated once
+// in is open, so a missing source leaves it alone. Keeps the errno of
+// the failed open
+static bool open_files(const char *in, const char *out, int& in_fd, int& out_fd)
+{
+    if ((in_fd = open(in, O_RDONLY)) < 0) {
+	return (false);
+    }
+    if ((out_fd = open(out, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+	int err = errno;
+	
+	close(in_fd);
+	errno = err;
+	return (false);
+    }
 
     return (true);
 }
 
 
-bool copyposix(const char *in, const char *out, const uint32_t chunk)
+// closes both files. A copy that went through ok fails if out can't be
+// closed, as a write may only fail then. Keeps errno from the copy
+// otherwise
+static bool close_files(const int in_fd, const int out_fd, const bool ok)
 {
-    char buffer[chunk];
-    ssize_t ret;
-    ssize_t rc;
-    int out_fd = open(out, O_RDWR | O_CREAT, 0777);
-    int in_fd = open(in, O_RDONLY);
+    int err = errno;
+    bool ret = (close(out_fd) == 0);
+    
+    if (ret || !ok) {
+	errno = err;
+    }
+    close(in_fd);
+
+    return (ok && ret);
+}
+
 
-    if (in_fd < 0 || out_fd < 0) {
+bool next_extent(const int fd, const off_t pos, const off_t size, off_t& data, off_t& hole)
+{
+    if (pos >= size) {
 	return (false);
     }
     
-    while ((ret = read(in_fd, buffer, chunk)) > 0) {
-	do {
-	    rc = write(out_fd, buffer, ret);
-	} while ((rc < 0) && (errno == EINTR));
-	if (rc < 0) {
+    data = lseek(fd, pos, SEEK_DATA);
+    if (data < 0) {
+	// ENXIO means the rest of the file is a hole
+	if (errno == ENXIO) {
 	    return (false);
 	}
+	data = pos;
+    }
+    if (data >= size) {
+	return (false);
+    }
+    
+    hole = lseek(fd, data, SEEK_HOLE);
+    if (hole < 0 || hole > size) {
+	hole = size;
     }
 
-    close(out_fd);
-    close(in_fd);
+    return (true);
+}
+
+
+/* Makes [start, end) of fd read back as zeros. Only the part below the
+ * size fd had before the copy can hold anything, the rest is a hole
+ * already
+ */
+static bool make_hole(const int fd, const off_t start, off_t end, const off_t size)
+{
+    static const char zeros[ZERO_CHUNK] = {0};
+    off_t pos = start;
+    
+    end = std::min(end, size);
+    if (pos >= end) {
+	return (true);
+    }
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, pos, end - pos) == 0) {
+	return (true);
+    }
+
+    while (pos < end) {
+	ssize_t rc = pwrite(fd, zeros, std::min((off_t)ZERO_CHUNK, end - pos), pos);
+	if (rc < 0 && errno == EINTR) {
+	    continue;
+	}
+	if (rc < 0) {
+	    return (false);
+	}
+	pos += rc;
+    }
 
     return (true);
 }
 
 
+/* Copies in_fd to out_fd calling copy_extent for each run of data, so
+ * holes in the source are holes in the copy and are never read. out_fd
+ * ends up the size in_fd was when the copy started.
+ */
+static bool copy_sparse(const int in_fd, const int out_fd,
+			const std::function<bool(off_t, const off_t)>& copy_extent)
+{
+    struct stat in_s, out_s;
+    off_t pos = 0, data, hole;
+
+    if (fstat(in_fd, &in_s) != 0 || fstat(out_fd, &out_s) != 0) {
+	return (false);
+    }
+
+    while (next_extent(in_fd, pos, in_s.st_size, data, hole)) {
+	if (!make_hole(out_fd, pos, data, out_s.st_size) || !copy_extent(data, hole)) {
+	    return (false);
+	}
+	pos = hole;
+    }
+
+    return (make_hole(out_fd, pos, in_s.st_size, out_s.st_size) &&
+	    ftruncate(out_fd, in_s.st_size) == 0);
+}
+
+
+bool copyz(const char *in, const char *out, const uint32_t chunk)
+{
+    return (copyz(in, out, chunk, NULL, NULL));
+}
+
+
+bool copyz(const char *in, const char *out, const uint32_t chunk, Throttle *rd, Throttle *wr)
+{
+    int p[2];
+    int in_fd, out_fd;
+    ssize_t bytes;
+    ssize_t rc = 0;
+
+    if (pipe(p) != 0) {
+	return (false);
+    }
+    if (!open_files(in, out, in_fd, out_fd)) {
+	close(p[0]);
+	close(p[1]);
+	return (false);
+    }
+    
+    while ((bytes = splice(in_fd, 0, p[1], 0, chunk, 0)) > 0 || (bytes < 0 && errno == EINTR)) {
+	charge(rd, bytes > 0 ? bytes : 0);
+	// the pipe is drained before the next read, whatever splice
+	// managed to move each time
+	while (bytes > 0) {
+	    rc = splice(p[0], 0, out_fd, 0, bytes, 0);
+	    if (rc < 0 && errno == EINTR) {
+		continue;
+	    }
+	    if (rc <= 0) {
+		break;
+	    }
+	    charge(wr, rc);
+	    bytes -= rc;
+	}
+	if (bytes > 0) {
+	    break;
+	}
+    }
+
+    close(p[0]);
+    close(p[1]);
+
+    return (close_files(in_fd, out_fd, bytes == 0));
+}
+
+
+bool copyposix(const char *in, const char *out, const uint32_t chunk)
+{
+    return (copyposix(in, out, chunk, NULL, NULL));
+}
+
+
+bool copyposix(const char *in, const char *out, const uint32_t chunk, Throttle *rd, Throttle *wr)
+{
+    return (copyposix(in, out, chunk, rd, wr, NULL));
+}
+
+
+/* The CRC is taken from the buffers being copied, so it costs no extra
+ * I/O. Holes are added to it as runs of zeros
+ */
+bool copyposix(const char *in, const char *out, const uint32_t chunk, Throttle *rd, Throttle *wr,
+	       uint32_t *crc)
+{
+    int in_fd, out_fd;
+
+    if (!open_files(in, out, in_fd, out_fd)) {
+	return (false);
+    }
+
+    return (close_files(in_fd, out_fd, copyposix(in_fd, out_fd, chunk, rd, wr, crc)));
+}
+
+
+bool copyposix(const int in_fd, const int out_fd, const uint32_t chunk, Throttle *rd,
+	       Throttle *wr, uint32_t *crc)
+{
+    Buffer buffer(chunk);
+    char *buf = (char *)buffer.data();
+    CRC32 c(chunk);
+    off_t crc_pos = 0;
+    struct stat s;
+
+    if (!buf) {
+	errno = ENOMEM;
+	return (false);
+    }
+    if (crc) {
+	*crc = 0;
+    }
+    
+    bool ret = copy_sparse(in_fd, out_fd, [&](off_t pos, const off_t end) {
+	    while (pos < end) {
+		ssize_t bytes = pread(in_fd, buf, std::min((off_t)chunk, end - pos), pos);
+		ssize_t done = 0;
+		
+		if (bytes < 0 && errno == EINTR) {
+		    continue;
+		}
+		// 0 if the source was truncated under us
+		if (bytes <= 0) {
+		    return (false);
+		}
+		charge(rd, bytes);
+		if (crc) {
+		    *crc = c.update(c.zeros(*crc, pos - crc_pos), (uint8_t *)buf, bytes);
+		    crc_pos = pos + bytes;
+		}
+		
+		while (done < bytes) {
+		    ssize_t rc = pwrite(out_fd, buf + done, bytes - done, pos + done);
+		    if (rc < 0 && errno == EINTR) {
+			continue;
+		    }
+		    if (rc < 0) {
+			return (false);
+		    }
+		    charge(wr, rc);
+		    done += rc;
+		}
+		pos += bytes;
+	    }
+	    return (true);
+	});
+
+    // a hole at the end. The copy is the size the source was at the start
+    if (ret && crc && fstat(out_fd, &s) == 0) {
+	*crc = c.zeros(*crc, s.st_size - crc_pos);
+    }
+
+    return (ret);
+}
+
+
 bool copyansi(const char *in, const char *out, const uint32_t chunk)
 {
-   char buffer[chunk];
+    return (copyansi(in, out, chunk, NULL, NULL));
+}
+
+
+bool copyansi(const char *in, const char *out, const uint32_t chunk, Throttle *rd, Throttle *wr)
+{
+   Buffer buf(chunk);
+   char *buffer = (char *)buf.data();
    size_t ret;
+   bool ok = true;
 
+   if (!buffer) {
+       return (false);
+   }
    FILE *src = fopen(in, "r");
    if (!src) {
        return (false);
@@ -112,31 +441,145 @@ bool copyansi(const char *in, const char *out, const uint32_t chunk)
        return (false);
    }
 
-   while ((ret = fread(buffer, 1, chunk, src))) {
-       fwrite(buffer, 1, ret, dst);
+   while (ok && (ret = fread(buffer, 1, chunk, src))) {
+       size_t written = fwrite(buffer, 1, ret, dst);
+       
+       charge(rd, ret);
+       charge(wr, written);
+       ok = (written == ret);
    }
    
-   fclose(dst);
+   // a buffered write can fail as late as the close
+   ok = ok && !ferror(src);
+   ok = (fclose(dst) == 0) && ok;
    fclose(src);
    
-   return (true);
+   return (ok);
 }
 
 
 bool copylinux(const char *in, const char *out)
 {
-    int out_fd = open(out, O_RDWR | O_CREAT, 0777);
-    int in_fd = open(in, O_RDONLY);
-    
-    struct stat stat_;
-    fstat(in_fd, &stat_);
+    return (copylinux(in, out, NULL, NULL));
+}
 
-    sendfile(out_fd, in_fd, 0, stat_.st_size);
 
-    close(out_fd);
-    close(in_fd);
+/* sendfile is done a piece at a time so each piece can be charged
+ * to the throttles. It isn't supported between every pair of files
+ */
+bool copylinux(const char *in, const char *out, Throttle *rd, Throttle *wr)
+{
+    int in_fd, out_fd;
 
-    return (true);
+    if (!open_files(in, out, in_fd, out_fd)) {
+	return (false);
+    }
+
+    return (close_files(in_fd, out_fd, copylinux(in_fd, out_fd, rd, wr)));
+}
+
+
+bool copylinux(const int in_fd, const int out_fd, Throttle *rd, Throttle *wr)
+{
+    return (copy_sparse(in_fd, out_fd, [=](off_t pos, const off_t end) {
+	    // sendfile writes at the file position of out_fd
+	    if (lseek(out_fd, pos, SEEK_SET) < 0) {
+		return (false);
+	    }
+	    while (pos < end) {
+		ssize_t bytes = sendfile(out_fd, in_fd, &pos,
+					 std::min((off_t)SENDFILE_CHUNK, end - pos));
+		if (bytes < 0 && errno == EINTR) {
+		    continue;
+		}
+		if (bytes <= 0) {
+		    return (false);
+		}
+		charge(rd, bytes);
+		charge(wr, bytes);
+	    }
+	    return (true);
+	}));
+}
+
+
+bool copyclone(const char *in, const char *out)
+{
+    return (copyclone(in, out, NULL, NULL));
+}
+
+
+/* Shares the source's extents with the destination, nothing is read or
+ * written. Only works within one filesystem that supports reflinks
+ * (btrfs, XFS), otherwise fails with EXDEV, EOPNOTSUPP or EINVAL.
+ */
+bool copyclone(const char *in, const char *out, Throttle *rd, Throttle *wr)
+{
+    int in_fd, out_fd;
+
+    if (!open_files(in, out, in_fd, out_fd)) {
+	return (false);
+    }
+
+    return (close_files(in_fd, out_fd, copyclone(in_fd, out_fd, rd, wr)));
+}
+
+
+bool copyclone(const int in_fd, const int out_fd, Throttle *rd, Throttle *wr)
+{
+    bool ret = (ioctl(out_fd, FICLONE, in_fd) == 0);
+
+    if (ret) {
+	// a metadata update on each side
+	charge(rd, 0);
+	charge(wr, 0);
+    }
+    return (ret);
+}
+
+
+bool copyrange(const char *in, const char *out)
+{
+    return (copyrange(in, out, NULL, NULL));
+}
+
+
+/* copy_file_range lets the kernel, or the server for NFS 4.2 and SMB,
+ * do the copy. Like sendfile it goes a piece at a time for the
+ * throttles. Fails with EXDEV, EOPNOTSUPP or ENOSYS where the kernel
+ * can't copy between the two files.
+ */
+bool copyrange(const char *in, const char *out, Throttle *rd, Throttle *wr)
+{
+    int in_fd, out_fd;
+
+    if (!open_files(in, out, in_fd, out_fd)) {
+	return (false);
+    }
+
+    return (close_files(in_fd, out_fd, copyrange(in_fd, out_fd, rd, wr)));
+}
+
+
+bool copyrange(const int in_fd, const int out_fd, Throttle *rd, Throttle *wr)
+{
+    return (copy_sparse(in_fd, out_fd, [=](off_t pos, const off_t end) {
+	    off_t out_pos = pos;
+	    
+	    while (pos < end) {
+		ssize_t bytes = copy_file_range(in_fd, &pos, out_fd, &out_pos,
+						std::min((off_t)SENDFILE_CHUNK, end - pos), 0);
+		if (bytes < 0 && errno == EINTR) {
+		    continue;
+		}
+		if (bytes <= 0) {
+		    return (false);
+		}
+		charge(rd, bytes);
+		charge(wr, bytes);
+	    }
+	    return (true);
+	}));
 }
 
 
@@ -145,10 +588,35 @@ bool copystreambuff(const char *in, const char *out)
     std::ifstream src(in, std::ios::binary);
     std::ofstream dst(out, std::ios::binary);
 
-    dst << src.rdbuf();
+    // inserting an empty streambuf counts as a failure
+    if (src.is_open() && src.peek() != std::ifstream::traits_type::eof()) {
+	dst << src.rdbuf();
+    }
 
+    // close fails if what's still buffered can't be written
     dst.close();
-    src.close();
  
-    return (true);
+    return (src.is_open() && !src.bad() && !dst.fail());
+}
+
+
+// the streams can't report progress, so the throttled
+// version copies through a buffer
+bool copystreambuff(const char *in, const char *out, Throttle *rd, Throttle *wr)
+{
+    std::ifstream src(in, std::ios::binary);
+    std::ofstream dst(out, std::ios::binary);
+    Buffer buf(SENDFILE_CHUNK / 16);
+    char *buffer = (char *)buf.data();
+    std::streamsize bytes;
+
+    while (buffer && dst.good() && (bytes = src.rdbuf()->sgetn(buffer, buf.size())) > 0) {
+	charge(rd, bytes);
+	dst.write(buffer, bytes);
+	charge(wr, bytes);
+    }
+
+    dst.close();
+ 
+    return (buffer && src.is_open() && !src.bad() && !dst.fail());
 }
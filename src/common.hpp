@@ -8,6 +8,15 @@
  *
  * 04/26/2014 - Initial open source release
  * 09/01/2014 - Copy Routines
+ * 10/19/2026 - Throttled copy routines
+ * 10/19/2026 - Reflink and copy_file_range copies
+ * 10/19/2026 - Sparse copies
+ * 10/19/2026 - copyposix with CRC
+ * 10/19/2026 - next_extent
+ * 10/19/2026 - escape_path
+ * 10/19/2026 - read_block and write_block, from the copy engine
+ * 10/19/2026 - Copies between open files
+ * 10/19/2026 - parse_number
  *
  */
 
@@ -16,17 +25,67 @@
 
 
 #include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+#include "throttle.hpp"
 
 ssize_t readall(const int& fd, uint8_t *buffer, const ssize_t& len);
 
+// finds the next run of data in fd at or after pos as [data, hole),
+// going by SEEK_DATA and SEEK_HOLE. False once there is no more data
+// before size
+bool next_extent(const int fd, const off_t pos, const off_t size, off_t& data, off_t& hole);
+
+// path made usable as a file name, with '/' and '%' escaped
+std::string escape_path(const std::string& path);
+
+// parses all of s as a whole number from min to max, false if it isn't one
+bool parse_number(const std::string& s, int64_t& value, const int64_t min, const int64_t max);
+
+// pread and pwrite of all len bytes at pos, charging t for them. A read
+// that reaches the end of fd first fails
+bool read_block(const int fd, uint8_t *buffer, const size_t len, const off_t pos, Throttle *t);
+bool write_block(const int fd, const uint8_t *buffer, const size_t len, const off_t pos,
+		 Throttle *t);
+
+// the throttled versions charge bytes read from in to rd and bytes
+// written to out to wr. Either may be NULL. copyposix, copylinux and
+// copyrange skip holes in in and leave them as holes in out
 bool copyz(const char *in, const char *out, const uint32_t chunk);
+bool copyz(const char *in, const char *out, const uint32_t chunk, Throttle *rd, Throttle *wr);
 
 bool copyposix(const char *in, const char *out, const uint32_t chunk);
+bool copyposix(const char *in, const char *out, const uint32_t chunk, Throttle *rd, Throttle *wr);
+// also sets crc to the CRC32 of the data copied
+bool copyposix(const char *in, const char *out, const uint32_t chunk, Throttle *rd, Throttle *wr,
+	       uint32_t *crc);
 
 bool copyansi(const char *in, const char *out, const uint32_t chunk);
+bool copyansi(const char *in, const char *out, const uint32_t chunk, Throttle *rd, Throttle *wr);
 
 bool copylinux(const char *in, const char *out);
+bool copylinux(const char *in, const char *out, Throttle *rd, Throttle *wr);
+
+// in-kernel copies, which fail with errno set where the two files
+// don't support them
+bool copyclone(const char *in, const char *out);
+bool copyclone(const char *in, const char *out, Throttle *rd, Throttle *wr);
+
+bool copyrange(const char *in, const char *out);
+bool copyrange(const char *in, const char *out, Throttle *rd, Throttle *wr);
+
+/* The same copies between files already open, for a destination that
+ * must not be opened again by name. out_fd is written from offset 0 and
+ * left the size of in_fd. Neither is closed
+ */
+bool copyposix(const int in_fd, const int out_fd, const uint32_t chunk, Throttle *rd,
+	       Throttle *wr, uint32_t *crc);
+bool copylinux(const int in_fd, const int out_fd, Throttle *rd, Throttle *wr);
+bool copyclone(const int in_fd, const int out_fd, Throttle *rd, Throttle *wr);
+bool copyrange(const int in_fd, const int out_fd, Throttle *rd, Throttle *wr);
 
 bool copystreambuff(const char *in, const char *out);
+bool copystreambuff(const char *in, const char *out, Throttle *rd, Throttle *wr);
 
 #endif
@@ -0,0 +1,252 @@
+/* Backup Manager Compressed Files
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "compressed.hpp"
+#include "common.hpp"
+#include "buffer_pool.hpp"
+
+
+size_t compressed_bound(const size_t len)
+{
+    return (compressBound(len));
+}
+
+
+bool compress_frame(const uint8_t *in, const size_t len, const int level, uint8_t *out,
+		    compressed_frame_st& f, const CRC32& crc)
+{
+    uLongf length = compressBound(len);
+
+    if (compress2(out, &length, in, len, level) != Z_OK) {
+	return (false);
+    }
+    // not worth inflating
+    if (length >= len) {
+	memcpy(out, in, len);
+	length = len;
+    }
+
+    f.offset = 0;
+    f.length = length;
+    f.size = len;
+    f.crc = crc.update(0, in, len);
+    f.zcrc = (length == len) ? f.crc : crc.update(0, out, length);
+
+    return (true);
+}
+
+
+bool write_compressed_index(const int fd, const uint64_t offset,
+			    const std::vector<compressed_frame_st>& frames, const uint64_t size,
+			    const uint32_t crc, const CRC32& crc32, Throttle *t,
+			    uint64_t *stored, uint32_t *stored_crc)
+{
+    compressed_trailer_st trailer;
+    size_t len = frames.size() * sizeof(compressed_frame_st);
+
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.count = frames.size();
+    trailer.size = size;
+    trailer.frame = COMPRESSED_FRAME;
+    trailer.crc = crc;
+    trailer.version = COMPRESSED_VERSION;
+    memcpy(trailer.magic, COMPRESSED_MAGIC, 4);
+
+    if ((len && !write_block(fd, (const uint8_t *)frames.data(), len, offset, t)) ||
+	!write_block(fd, (const uint8_t *)&trailer, sizeof(trailer), offset + len, t)) {
+	return (false);
+    }
+
+    // the frames were summed as they were made, only the index is new
+    if (stored_crc) {
+	uint32_t sum = 0;
+
+	for (uint64_t i = 0; i < frames.size(); ++i) {
+	    sum = crc32.combine(sum, frames[i].zcrc, frames[i].length);
+	}
+	sum = crc32.update(sum, (const uint8_t *)frames.data(), len);
+	*stored_crc = crc32.update(sum, (const uint8_t *)&trailer, sizeof(trailer));
+    }
+    if (stored) {
+	*stored = offset + len + sizeof(trailer);
+    }
+
+    return (true);
+}
+
+
+CompressedFile::CompressedFile() : _fd(-1), _crc(COMPRESSED_FRAME)
+{
+    memset(&_trailer, 0, sizeof(_trailer));
+}
+
+
+CompressedFile::~CompressedFile()
+{
+    if (_fd >= 0) {
+	close(_fd);
+    }
+}
+
+
+bool CompressedFile::open(const std::string& path, Throttle *t)
+{
+    struct stat s;
+
+    if (_fd >= 0) {
+	close(_fd);
+    }
+    _frames.clear();
+    _fd = ::open(path.c_str(), O_RDONLY);
+    if (_fd < 0 || fstat(_fd, &s) != 0 || (uint64_t)s.st_size < sizeof(_trailer)) {
+	return (false);
+    }
+
+    uint64_t end = s.st_size - sizeof(_trailer);
+    if (!read_block(_fd, (uint8_t *)&_trailer, sizeof(_trailer), end, t)) {
+	return (false);
+    }
+    if (memcmp(_trailer.magic, COMPRESSED_MAGIC, 4) != 0 ||
+	_trailer.version != COMPRESSED_VERSION || _trailer.frame == 0 ||
+	_trailer.count != (_trailer.size + _trailer.frame - 1) / _trailer.frame ||
+	_trailer.count > end / sizeof(compressed_frame_st)) {
+	errno = EINVAL;
+	return (false);
+    }
+
+    size_t len = _trailer.count * sizeof(compressed_frame_st);
+    _frames.resize(_trailer.count);
+    end -= len;
+    if (len && !read_block(_fd, (uint8_t *)_frames.data(), len, end, t)) {
+	_frames.clear();
+	return (false);
+    }
+
+    // the frames follow one another up to the index, all full but the last
+    uint64_t offset = 0;
+    for (uint64_t i = 0; i < _frames.size(); ++i) {
+	const compressed_frame_st& f = _frames[i];
+
+	if (f.offset != offset || f.length > compressed_bound(f.size) ||
+	    f.size != std::min((uint64_t)_trailer.frame, _trailer.size - i * _trailer.frame)) {
+	    _frames.clear();
+	    errno = EINVAL;
+	    return (false);
+	}
+	offset += f.length;
+    }
+    if (offset != end) {
+	_frames.clear();
+	errno = EINVAL;
+	return (false);
+    }
+
+    return (true);
+}
+
+
+uint64_t CompressedFile::size() const
+{
+    return (_trailer.size);
+}
+
+
+uint32_t CompressedFile::crc() const
+{
+    return (_trailer.crc);
+}
+
+
+// inflates frame i into buffer, which has room for a whole frame
+bool CompressedFile::read_frame(const uint64_t i, uint8_t *buffer, Throttle *t)
+{
+    const compressed_frame_st& f = _frames[i];
+
+    if (f.length == f.size) {
+	return (read_block(_fd, buffer, f.length, f.offset, t) &&
+		_crc.update(0, buffer, f.size) == f.crc);
+    }
+
+    Buffer stored(f.length);
+    uLongf len = f.size;
+
+    return (stored.data() && read_block(_fd, stored.data(), f.length, f.offset, t) &&
+	    uncompress(buffer, &len, stored.data(), f.length) == Z_OK && len == f.size &&
+	    _crc.update(0, buffer, f.size) == f.crc);
+}
+
+
+ssize_t CompressedFile::read(const uint64_t pos, uint8_t *buffer, const size_t len, Throttle *t)
+{
+    if (_fd < 0) {
+	errno = EBADF;
+	return (-1);
+    }
+
+    Buffer frame(_trailer.frame);
+    uint64_t end = std::min(_trailer.size, pos + len);
+    uint64_t at = pos;
+
+    if (!frame.data()) {
+	errno = ENOMEM;
+	return (-1);
+    }
+
+    while (at < end) {
+	uint64_t i = at / _trailer.frame;
+	uint64_t start = i * _trailer.frame;
+	uint64_t stop = std::min(end, start + _frames[i].size);
+
+	if (!read_frame(i, frame.data(), t)) {
+	    errno = EIO;
+	    return (-1);
+	}
+	memcpy(buffer + (at - pos), frame.data() + (at - start), stop - at);
+	at = stop;
+    }
+
+    return (at > pos ? at - pos : 0);
+}
+
+
+bool CompressedFile::check(const uint32_t crc, Throttle *t)
+{
+    if (_fd < 0 || _trailer.crc != crc) {
+	return (false);
+    }
+
+    uint32_t sum = 0;
+    Buffer stored(compressed_bound(_trailer.frame));
+
+    if (!stored.data()) {
+	return (false);
+    }
+    for (uint64_t i = 0; i < _frames.size(); ++i) {
+	const compressed_frame_st& f = _frames[i];
+
+	if (!read_block(_fd, stored.data(), f.length, f.offset, t) ||
+	    _crc.update(0, stored.data(), f.length) != f.zcrc) {
+	    return (false);
+	}
+	sum = _crc.combine(sum, f.crc, f.size);
+    }
+
+    return (sum == crc);
+}
@@ -0,0 +1,113 @@
+/* Backup Manager Compressed Files
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#ifndef __COMPRESSED__
+#define __COMPRESSED__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <sys/types.h>
+
+#include "crc32.hpp"
+#include "throttle.hpp"
+
+
+/* A compressed copy of a file is its data cut into frames of a fixed
+ * size, each compressed on its own with zlib, then an index of the
+ * frames and a trailer:
+ *
+ *     frame[count]
+ *     compressed_frame_st[count]
+ *     compressed_trailer_st
+ *
+ * The trailer is found from the end of the file, and the index from
+ * it, so any part of the file can be read by inflating only the frames
+ * it is in. A frame that doesn't get smaller is stored as it is. All
+ * integers are stored in host byte order.
+ */
+#define COMPRESSED_MAGIC   "BMZF"
+#define COMPRESSED_VERSION 1
+// bytes of the file in each frame, the last may hold fewer
+#define COMPRESSED_FRAME   (1024 * 1024)
+
+struct compressed_frame_st {
+    // where the frame starts, and its length as stored. A length equal
+    // to size is a frame stored as it is
+    uint64_t offset;
+    uint32_t length;
+    uint32_t size;
+    // the CRC32 of the data it holds, and of the frame as stored
+    uint32_t crc;
+    uint32_t zcrc;
+};
+
+struct compressed_trailer_st {
+    uint64_t count;
+    uint64_t size;
+    uint32_t frame;
+    // the CRC32 of all of the data
+    uint32_t crc;
+    uint32_t version;
+    char     magic[4];
+};
+
+static_assert(sizeof(compressed_frame_st) == 24, "compressed frame must be 24 bytes");
+static_assert(sizeof(compressed_trailer_st) == 32, "compressed trailer must be 32 bytes");
+
+
+// the most a frame of len bytes can take once compressed
+size_t compressed_bound(const size_t len);
+// compresses len bytes of in to out, which has room for
+// compressed_bound(len) bytes, and fills in all of f but its offset
+bool compress_frame(const uint8_t *in, const size_t len, const int level, uint8_t *out,
+		    compressed_frame_st& f, const CRC32& crc);
+/* Writes the index of frames and the trailer at offset in fd, where
+ * the frames end, for size bytes of data with CRC crc. stored is set to
+ * the length of the whole file and stored_crc to its CRC32
+ */
+bool write_compressed_index(const int fd, const uint64_t offset,
+			    const std::vector<compressed_frame_st>& frames, const uint64_t size,
+			    const uint32_t crc, const CRC32& crc32, Throttle *t,
+			    uint64_t *stored, uint32_t *stored_crc);
+
+
+class CompressedFile {
+public:
+    CompressedFile();
+    ~CompressedFile();
+    CompressedFile(const CompressedFile&) = delete;
+    CompressedFile &operator=(const CompressedFile&) = delete;
+
+    // reads the trailer and index of the compressed file at path, and
+    // fails unless they describe the frames before them
+    bool open(const std::string& path, Throttle *t = NULL);
+    // the size and CRC32 of the data the file holds
+    uint64_t size() const;
+    uint32_t crc() const;
+    // reads up to len bytes of the data from pos, inflating only the
+    // frames they are in. Returns the bytes read, or -1
+    ssize_t read(const uint64_t pos, uint8_t *buffer, const size_t len, Throttle *t = NULL);
+    // reads every frame as stored and checks it against the index, and
+    // that the index is of data with CRC crc, without inflating any
+    bool check(const uint32_t crc, Throttle *t = NULL);
+
+private:
+    bool read_frame(const uint64_t i, uint8_t *buffer, Throttle *t);
+
+    int _fd;
+    CRC32 _crc;
+    compressed_trailer_st _trailer;
+    std::vector<compressed_frame_st> _frames;
+};
+
+#endif
@@ -13,13 +13,25 @@
  */
 
 #include <fstream>
-#include <sstream>
 
 #include "config_parse.hpp"
 
 
 using namespace std;
 
+
+static string trim(const string &s)
+{
+  size_t b = s.find_first_not_of(" \t\r");
+  size_t e = s.find_last_not_of(" \t\r");
+
+  if (b == string::npos) {
+    return (string());
+  }
+
+  return (string(s, b, e - b + 1));
+}
+
 ConfigParse::ConfigParse(const char *file)
 {
   parse(file);
@@ -90,6 +102,7 @@ void ConfigParse::parse(const char *file)
   
   while (getline(f, line)) {
     ++line_number;
+    line = trim(line);
     if (!line.size() || line[0] == ';') {
       continue;
     }
@@ -121,10 +134,8 @@ void ConfigParse::parse(const char *file)
       }
     } else {
       if (inserted.second) {
-	istringstream cleaner(line);
 	string name, value;
 	
-	cleaner >> line;
 	size_t pos = line.find('=');
 	if (pos == string::npos) {
 	  f.close();
@@ -132,8 +143,9 @@ void ConfigParse::parse(const char *file)
 	  return;
 	}
 	
-	name = string(line, 0, pos);
-	value = string(line, pos+1, line.size()-1);
+	// values may contain spaces (cron expressions, time windows)
+	name = trim(string(line, 0, pos));
+	value = trim(string(line, pos+1));
 	
 	inserted.first->second.insert(make_pair(name, value));
       }
@@ -0,0 +1,1172 @@
+/* Backup Manager Copy Engine
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ * 10/19/2026 - reflink and copy_file_range
+ * 10/19/2026 - CRC while copying, verify
+ * 10/19/2026 - parallel copies of large files
+ * 10/19/2026 - batched copies of small files
+ * 10/19/2026 - delta copies over existing destinations
+ * 10/19/2026 - copies made under a temporary name, staged for commit()
+ * 10/19/2026 - buffers from the BufferPool
+ * 10/19/2026 - compressed copies
+ *
+ */
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <set>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "copy_engine.hpp"
+#include "common.hpp"
+#include "crc32.hpp"
+#include "buffer_pool.hpp"
+
+
+// buffer size for read/write copies
+#define COPY_CHUNK (64 * 1024)
+// small files a thread takes from a batch at a time
+#define COPY_BATCH 64
+// the piece of a file each thread copies at a time in a parallel copy
+#define COPY_RANGE_SIZE (64 * 1024 * 1024)
+// most copy_file_range is asked for at once, so the throttles are
+// charged as it goes
+#define COPY_RANGE_STEP (1024 * 1024)
+// the unit a delta copy compares and rewrites. Ranges are a whole
+// number of blocks
+#define DELTA_BLOCK (128 * 1024)
+// commits of up to this many files sync each one, larger ones sync
+// the filesystems they are on
+#define COMMIT_EACH 16
+
+
+/* Creates an empty file beside out for a copy to be made in, named
+ * .name.XXXXXX as rsync does. Returns it open, or -1
+ */
+static int make_temp(const std::string& out, std::string& tmp)
+{
+    size_t slash = out.rfind('/');
+    size_t name = (slash == std::string::npos) ? 0 : slash + 1;
+
+    // leave room for the dot and suffix in a name that is already long
+    tmp = out.substr(0, name) + "." + out.substr(name, 240) + ".XXXXXX";
+    
+    return (mkstemp(&tmp[0]));
+}
+
+
+// closes and removes a temporary file made by make_temp, if there is one
+static void discard_temp(const int fd, const std::string& tmp)
+{
+    if (fd >= 0) {
+	close(fd);
+    }
+    if (!tmp.empty()) {
+	unlink(tmp.c_str());
+    }
+}
+
+
+static bool sync_path(const std::string& path, const bool data_only)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+	return (false);
+    }
+    
+    bool ret = ((data_only ? fdatasync(fd) : fsync(fd)) == 0);
+    close(fd);
+
+    return (ret);
+}
+
+
+const char* copy_method_str(const copy_method_e m)
+{
+    switch (m) {
+    case COPY_CLONE:
+	return ("reflink");
+    case COPY_PARALLEL:
+	return ("parallel");
+    case COPY_RANGE:
+	return ("copy_file_range");
+    case COPY_SENDFILE:
+	return ("sendfile");
+    case COPY_READ_WRITE:
+	return ("read/write");
+    case COPY_DELTA:
+	return ("delta");
+    case COPY_COMPRESS:
+	return ("compressed");
+    default:
+	return ("unknown");
+    }
+}
+
+
+CopyEngine::CopyEngine(Logger *log) :
+    _log(log),
+    _crc(COPY_CHUNK),
+    _verify(false),
+    _pool(NULL),
+    _parallel_min(0),
+    _delta_min(0),
+    _durable(false),
+    _compress(0)
+{
+    for (uint32_t i = 0; i < COPY_METHODS; ++i) {
+	_copied[i] = 0;
+    }
+}
+
+
+void CopyEngine::set_verify(const bool verify)
+{
+    _verify = verify;
+}
+
+
+void CopyEngine::set_parallel(ThreadPool *pool, const uint64_t min_size)
+{
+    _pool = pool;
+    _parallel_min = min_size;
+}
+
+
+void CopyEngine::set_delta(const std::string& index_dir, const uint64_t min_size)
+{
+    std::lock_guard<std::mutex> l(_lock);
+    _index_dir = index_dir;
+    _delta_min = min_size;
+}
+
+
+CopyEngine::~CopyEngine()
+{
+    for (uint32_t i = 0; i < _staged.size(); ++i) {
+	unlink(_staged[i].tmp.c_str());
+    }
+}
+
+
+void CopyEngine::set_durable(const bool durable)
+{
+    _durable = durable;
+}
+
+
+void CopyEngine::set_compress(const int level)
+{
+    _compress = level;
+}
+
+
+uint64_t CopyEngine::copied(const copy_method_e m) const
+{
+    return (_copied[m]);
+}
+
+
+bool CopyEngine::copy(const std::string& in, const std::string& out, Throttle *rd, Throttle *wr,
+		      uint32_t *crc, copy_stored_st *stored)
+{
+    struct stat src, dst_dir, dst;
+    size_t slash = out.rfind('/');
+    std::string dir = (slash == std::string::npos) ? "." : out.substr(0, slash + 1);
+    
+    if (stat(in.c_str(), &src) != 0 || !S_ISREG(src.st_mode)) {
+	LOG(*_log, ERROR) << "Cannot copy " << in << ", not a regular file" << std::endl;
+	return (false);
+    }
+    if (stat(dir.c_str(), &dst_dir) != 0) {
+	LOG(*_log, ERROR) << "Cannot copy to " << out << ", no such directory" << std::endl;
+	return (false);
+    }
+
+    dev_pair devs(src.st_dev, dst_dir.st_dev);
+    uint64_t delta_min = _delta_min;
+    int level = _compress;
+    BlockIndex sums(DELTA_BLOCK);
+    std::string index;
+    bool delta = false;
+    
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	index = _index_dir.empty() ? "" : block_index_path(_index_dir, out);
+    }
+
+    if (stored) {
+	stored->size = 0;
+	stored->crc = 0;
+    }
+
+    // a reflink costs less than a delta, where there could be one
+    if (!level && delta_min && (uint64_t)src.st_size >= delta_min &&
+	lstat(out.c_str(), &dst) == 0 && S_ISREG(dst.st_mode) &&
+	(devs.first != devs.second || broken(devs, COPY_CLONE))) {
+	errno = 0;
+	delta = copy_delta(in.c_str(), out.c_str(), src, index, sums, rd, wr, crc);
+	if (!delta) {
+	    LOG(*_log, WARNING) << "Delta copy of " << in << " to " << out << " failed: "
+				<< strerror(errno) << ", copying it whole" << std::endl;
+	}
+    }
+    
+    uint32_t m = delta ? COPY_DELTA : (level ? COPY_COMPRESS : COPY_CLONE);
+    std::string tmp;
+    int fd = -1;
+    bool copied = delta;
+
+    // the copy is made under another name, so out is only ever the old
+    // file or all of the new one. The file stays open for every attempt,
+    // it is never opened again by a name that could be replaced
+    if (!delta) {
+	fd = make_temp(out, tmp);
+	if (fd < 0) {
+	    LOG(*_log, ERROR) << "Cannot create a file beside " << out << ": "
+			      << strerror(errno) << std::endl;
+	    return (false);
+	}
+    }
+    const std::string& path = delta ? out : tmp;
+    
+    for (; m < COPY_DELTA; ++m) {
+	// sendfile costs more to set up than reading and writing a small
+	// file. Clones and copy_file_range are single calls
+	if (broken(devs, (copy_method_e)m) ||
+	    (m == COPY_PARALLEL && (!_pool || (uint64_t)src.st_size < _parallel_min ||
+				    src.st_size <= COPY_RANGE_SIZE)) ||
+	    (m == COPY_SENDFILE && src.st_size < COPY_SMALL_FILE) ||
+	    (crc && (m == COPY_RANGE || m == COPY_SENDFILE))) {
+	    continue;
+	}
+	
+	errno = 0;
+	if (copy_with((copy_method_e)m, in.c_str(), fd, src.st_size, rd, wr, crc, devs)) {
+	    copied = true;
+	    break;
+	}
+
+	// not supported here, as opposed to this one file failing. A
+	// parallel copy falls back to pread/pwrite itself
+	if (m != COPY_READ_WRITE && m != COPY_PARALLEL &&
+	    (errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP ||
+	     errno == EXDEV || errno == ENOTTY)) {
+	    set_broken(devs, (copy_method_e)m);
+	}
+	if (ftruncate(fd, 0) != 0) {
+	    break;
+	}
+    }
+
+    // there's nothing to fall back to that would be compressed
+    if (m == COPY_COMPRESS) {
+	errno = 0;
+	if (!(copied = copy_compressed(in.c_str(), fd, level, rd, wr, crc, stored))) {
+	    LOG(*_log, ERROR) << "Failed to compress " << in << " to " << out << ": "
+			      << strerror(errno) << std::endl;
+	}
+    } else if (!copied) {
+	LOG(*_log, ERROR) << "Failed to copy " << in << " to " << out << std::endl;
+    }
+    if (!copied) {
+	discard_temp(fd, tmp);
+	return (false);
+    }
+    ++_copied[m];
+
+    // an index left from before describes a file that is gone
+    if (!delta && !index.empty() && delta_min && (uint64_t)src.st_size >= delta_min) {
+	unlink(index.c_str());
+    }
+
+    struct timespec times[2] = {src.st_atim, src.st_mtim};
+    if (delta ? (chmod(out.c_str(), src.st_mode & 07777) != 0 ||
+		 utimensat(AT_FDCWD, out.c_str(), times, 0) != 0) :
+	(fchmod(fd, src.st_mode & 07777) != 0 || futimens(fd, times) != 0)) {
+	LOG(*_log, WARNING) << "Could not set mode and times of " << out << std::endl;
+    }
+    // a write may only fail as the file is closed
+    if (!delta && close(fd) != 0) {
+	LOG(*_log, ERROR) << "Failed to copy " << in << " to " << out << ": "
+			  << strerror(errno) << std::endl;
+	unlink(tmp.c_str());
+	return (false);
+    }
+
+    // a reflink shares the source's blocks, there's nothing else to read
+    if (crc && m != COPY_CLONE && !verify(in, out, path, *crc, wr, m == COPY_COMPRESS)) {
+	return (false);
+    }
+
+    if (!delta) {
+	return (place(tmp, out));
+    }
+
+    // a delta is written in place, so it can't wait for commit(). With
+    // durable copies on it is got to disk here, before it is recorded.
+    // Its index is taken of the copy as it is now, times and all, and
+    // mustn't get to disk before the copy does
+    bool synced = (_durable || !index.empty()) && sync_path(out, true);
+    if (_durable && !synced) {
+	LOG(*_log, ERROR) << "Failed to sync " << out << ": " << strerror(errno) << std::endl;
+	return (false);
+    }
+    if (!index.empty() && (!synced || stat(out.c_str(), &dst) != 0 || !sums.save(index, dst))) {
+	LOG(*_log, WARNING) << "Could not save the block index of " << out << std::endl;
+    }
+    
+    return (true);
+}
+
+
+// with durable copies tmp waits for commit(), otherwise it replaces out
+// straight away
+bool CopyEngine::place(const std::string& tmp, const std::string& out)
+{
+    if (_durable) {
+	std::lock_guard<std::mutex> l(_lock);
+	staged_st s = {tmp, out};
+	_staged.push_back(s);
+	return (true);
+    }
+
+    if (rename(tmp.c_str(), out.c_str()) != 0) {
+	LOG(*_log, ERROR) << "Cannot replace " << out << ": " << strerror(errno) << std::endl;
+	unlink(tmp.c_str());
+	return (false);
+    }
+
+    return (true);
+}
+
+
+/* Gets every staged copy to disk, then renames each over its
+ * destination, then syncs each directory once so the renames last. A
+ * crash at any point leaves each destination as it was before or as
+ * the finished copy. Syncing a whole filesystem costs about the same
+ * as syncing one file, so past a few files each filesystem is synced
+ * once instead.
+ */
+std::vector<std::string> CopyEngine::commit()
+{
+    std::vector<staged_st> staged;
+    std::vector<std::string> failed;
+    std::vector<bool> ok;
+    std::set<std::string> dirs;
+    std::map<dev_t, bool> filesystems;
+    std::vector<dev_t> devs;
+    struct stat s;
+
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	staged.swap(_staged);
+    }
+    ok.resize(staged.size(), true);
+    devs.resize(staged.size(), 0);
+
+    for (uint32_t i = 0; i < staged.size(); ++i) {
+	if (staged.size() <= COMMIT_EACH) {
+	    ok[i] = sync_path(staged[i].tmp, true);
+	} else if (stat(staged[i].tmp.c_str(), &s) == 0) {
+	    devs[i] = s.st_dev;
+	    if (filesystems.find(s.st_dev) == filesystems.end()) {
+		int fd = open(staged[i].tmp.c_str(), O_RDONLY);
+		
+		filesystems[s.st_dev] = (fd >= 0 && syncfs(fd) == 0);
+		if (fd >= 0) {
+		    close(fd);
+		}
+	    }
+	    ok[i] = filesystems[s.st_dev];
+	} else {
+	    ok[i] = false;
+	}
+    }
+
+    for (uint32_t i = 0; i < staged.size(); ++i) {
+	size_t slash = staged[i].out.rfind('/');
+	
+	if (ok[i] && rename(staged[i].tmp.c_str(), staged[i].out.c_str()) == 0) {
+	    dirs.insert(slash == std::string::npos ? "." : staged[i].out.substr(0, slash + 1));
+	    continue;
+	}
+	LOG(*_log, ERROR) << "Cannot commit the copy to " << staged[i].out << ": "
+			  << strerror(errno) << std::endl;
+	ok[i] = false;
+	unlink(staged[i].tmp.c_str());
+	failed.push_back(staged[i].out);
+    }
+
+    // a rename that may not last fails the copy, so it is made again
+    for (std::set<std::string>::const_iterator it = dirs.cbegin(); it != dirs.cend(); ++it) {
+	if (sync_path(*it, false)) {
+	    continue;
+	}
+	LOG(*_log, ERROR) << "Cannot sync " << *it << ": " << strerror(errno) << std::endl;
+	for (uint32_t i = 0; i < staged.size(); ++i) {
+	    if (ok[i] && staged[i].out.compare(0, it->size(), *it) == 0 &&
+		staged[i].out.find('/', it->size()) == std::string::npos) {
+		failed.push_back(staged[i].out);
+	    }
+	}
+    }
+    
+    return (failed);
+}
+
+
+// with verify set, reads the copy of in to out back from path and
+// removes it if it doesn't match. A compressed copy's frames are only
+// checked against its index
+bool CopyEngine::verify(const std::string& in, const std::string& out, const std::string& path,
+			const uint32_t crc, Throttle *wr, const bool compressed)
+{
+    if (!_verify) {
+	return (true);
+    }
+
+    bool ok;
+    if (compressed) {
+	CompressedFile f;
+
+	ok = f.open(path, wr) && f.check(crc, wr);
+    } else {
+	ssize_t check = _crc.crc32(path, wr, true);
+
+	ok = (check >= 0 && (uint32_t)check == crc);
+    }
+    if (!ok) {
+	LOG(*_log, ERROR) << "Copy of " << in << " to " << out
+			  << " does not match the source" << std::endl;
+	unlink(path.c_str());
+	return (false);
+    }
+
+    return (true);
+}
+
+
+/* Sorting by inode is the best guess at disk order we have without
+ * asking the filesystem for extents. The stat taken to sort is the one
+ * the copy uses.
+ */
+void CopyEngine::copy_batch(std::vector<copy_item_st>& items, Throttle *rd, Throttle *wr)
+{
+    std::shared_ptr<batch_job_st> job(new batch_job_st);
+    ThreadPool *pool = _pool;
+    struct stat s;
+
+    for (uint32_t i = 0; i < items.size(); ++i) {
+	items[i].ok = false;
+	items[i].crc = 0;
+	items[i].stored.size = 0;
+	items[i].stored.crc = 0;
+	if (stat(items[i].in.c_str(), &s) != 0) {
+	    LOG(*_log, ERROR) << "Cannot copy " << items[i].in << ": " << strerror(errno)
+			      << std::endl;
+	    continue;
+	}
+	job->order.push_back(std::make_pair(i, s));
+    }
+    std::sort(job->order.begin(), job->order.end(),
+	      [](const std::pair<uint32_t, struct stat>& a,
+		 const std::pair<uint32_t, struct stat>& b) {
+		  return (a.second.st_ino < b.second.st_ino);
+	      });
+
+    job->items = &items;
+    job->chunks = (job->order.size() + COPY_BATCH - 1) / COPY_BATCH;
+    job->rd = rd;
+    job->wr = wr;
+    job->next = 0;
+    job->done = 0;
+
+    if (job->chunks == 0) {
+	return;
+    }
+    
+    uint32_t helpers = pool ? std::min(pool->size(), job->chunks - 1) : 0;
+    for (uint32_t i = 0; i < helpers; ++i) {
+	pool->submit([this, job]{ copy_chunks(job); }, 1);
+    }
+    copy_chunks(job);
+
+    std::unique_lock<std::mutex> l(job->lock);
+    job->cv.wait(l, [job]{ return (job->done == job->chunks); });
+}
+
+
+// takes chunks from the batch until there are none left
+void CopyEngine::copy_chunks(std::shared_ptr<batch_job_st> job)
+{
+    // a byte more than a small file, to see a file that has grown
+    Buffer buffer(COPY_SMALL_FILE + 1);
+    uint32_t i;
+    
+    while ((i = job->next++) < job->chunks) {
+	uint32_t end = std::min((uint32_t)job->order.size(), (i + 1) * COPY_BATCH);
+	
+	for (uint32_t k = i * COPY_BATCH; k < end; ++k) {
+	    copy_item_st& item = (*job->items)[job->order[k].first];
+	    item.ok = (buffer.data() && copy_small(item, job->order[k].second,
+						   (char *)buffer.data(), job->rd, job->wr));
+	}
+	
+	if (++job->done == job->chunks) {
+	    std::lock_guard<std::mutex> l(job->lock);
+	    job->cv.notify_all();
+	}
+    }
+}
+
+
+/* open, read, mkstemp, write, fchmod, futimens, two closes and the
+ * rename, which with durable copies waits for commit(). Anything that
+ * isn't a small regular file, or turns out not to be, goes to copy()
+ */
+bool CopyEngine::copy_small(copy_item_st& item, const struct stat& s, char *buffer,
+			    Throttle *rd, Throttle *wr)
+{
+    ssize_t len = 0;
+    ssize_t bytes = 0;
+    
+    if (!S_ISREG(s.st_mode) || s.st_size >= COPY_SMALL_FILE) {
+	return (copy(item.in, item.out, rd, wr, &item.crc, &item.stored));
+    }
+
+    int in_fd = open(item.in.c_str(), O_RDONLY);
+    if (in_fd < 0) {
+	LOG(*_log, ERROR) << "Cannot copy " << item.in << ": " << strerror(errno) << std::endl;
+	return (false);
+    }
+    while (len <= COPY_SMALL_FILE &&
+	   ((bytes = read(in_fd, buffer + len, COPY_SMALL_FILE + 1 - len)) > 0 ||
+	    (bytes < 0 && errno == EINTR))) {
+	len += (bytes > 0) ? bytes : 0;
+    }
+    close(in_fd);
+    
+    if (len > COPY_SMALL_FILE) {
+	return (copy(item.in, item.out, rd, wr, &item.crc, &item.stored));
+    }
+    if (bytes < 0) {
+	LOG(*_log, ERROR) << "Cannot read " << item.in << ": " << strerror(errno) << std::endl;
+	return (false);
+    }
+    if (rd) {
+	rd->consume(len);
+    }
+    item.crc = _crc.update(0, (uint8_t *)buffer, len);
+
+    std::string tmp;
+    int out_fd = make_temp(item.out, tmp);
+    int level = _compress;
+    
+    if (out_fd < 0) {
+	LOG(*_log, ERROR) << "Cannot create a file beside " << item.out << ": "
+			  << strerror(errno) << std::endl;
+	return (false);
+    }
+
+    struct timespec times[2] = {s.st_atim, s.st_mtim};
+    bool ok = (level ? compress_small(out_fd, (uint8_t *)buffer, len, level, wr, item.stored) :
+	       write_block(out_fd, (uint8_t *)buffer, len, 0, wr));
+    if (ok && (fchmod(out_fd, s.st_mode & 07777) != 0 || futimens(out_fd, times) != 0)) {
+	LOG(*_log, WARNING) << "Could not set mode and times of " << item.out << std::endl;
+    }
+    if (close(out_fd) != 0) {
+	ok = false;
+    }
+    if (!ok) {
+	LOG(*_log, ERROR) << "Failed to copy " << item.in << " to " << item.out << std::endl;
+	unlink(tmp.c_str());
+	return (false);
+    }
+    ++_copied[level ? COPY_COMPRESS : COPY_READ_WRITE];
+    
+    return (verify(item.in, item.out, tmp, item.crc, wr, level != 0) && place(tmp, item.out));
+}
+
+
+// writes len bytes to fd as a compressed file of one frame, or of none
+// if len is 0
+bool CopyEngine::compress_small(const int fd, const uint8_t *data, const size_t len,
+				const int level, Throttle *wr, copy_stored_st& stored)
+{
+    std::vector<compressed_frame_st> frames;
+    Buffer out(compressed_bound(len));
+    compressed_frame_st f;
+
+    if (!out.data()) {
+	errno = ENOMEM;
+	return (false);
+    }
+    if (len) {
+	if (!compress_frame(data, len, level, out.data(), f, _crc) ||
+	    !write_block(fd, out.data(), f.length, 0, wr)) {
+	    return (false);
+	}
+	frames.push_back(f);
+    }
+
+    return (write_compressed_index(fd, len ? f.length : 0, frames, len, len ? f.crc : 0, _crc,
+				   wr, &stored.size, &stored.crc));
+}
+
+
+bool CopyEngine::copy_with(const copy_method_e m, const char *in, const int out_fd,
+			   const uint64_t size, Throttle *rd, Throttle *wr, uint32_t *crc,
+			   const dev_pair& devs)
+{
+    struct stat s;
+    bool ret = false;
+    int in_fd = -1;
+
+    // a parallel copy opens in for itself
+    if (m != COPY_PARALLEL && (in_fd = open(in, O_RDONLY)) < 0) {
+	return (false);
+    }
+    
+    switch (m) {
+    case COPY_CLONE:
+	ret = copyclone(in_fd, out_fd, rd, wr);
+	if (ret && crc) {
+	    ssize_t sum = _crc.crc32(in, rd);
+	    
+	    ret = (sum >= 0);
+	    *crc = sum;
+	}
+	break;
+    case COPY_PARALLEL:
+	ret = copy_parallel(in, out_fd, devs, rd, wr, crc);
+	break;
+    case COPY_RANGE:
+	ret = copyrange(in_fd, out_fd, rd, wr);
+	break;
+    case COPY_SENDFILE:
+	ret = copylinux(in_fd, out_fd, rd, wr);
+	break;
+    case COPY_READ_WRITE:
+	ret = copyposix(in_fd, out_fd, COPY_CHUNK, rd, wr, crc);
+	break;
+    default:
+	break;
+    }
+
+    // keep the errno of the copy, it says whether the method works here
+    if (in_fd >= 0) {
+	int err = errno;
+
+	close(in_fd);
+	errno = err;
+    }
+
+    // a short copy is a failed one
+    return (ret && fstat(out_fd, &s) == 0 && (uint64_t)s.st_size == size);
+}
+
+
+/* Splits the file into ranges that this thread and the pool's copy
+ * side by side. The destination is allocated up front so the ranges
+ * don't fragment it, unless the source is sparse. With a CRC, each range
+ * has its own and they're combined at the end.
+ */
+bool CopyEngine::copy_parallel(const char *in, const int out_fd, const dev_pair& devs,
+			       Throttle *rd, Throttle *wr, uint32_t *crc)
+{
+    std::shared_ptr<range_job_st> job(new range_job_st);
+    struct stat s;
+    
+    // the job closes its own descriptor for out
+    job->in_fd = open(in, O_RDONLY);
+    job->out_fd = dup(out_fd);
+    if (job->in_fd < 0 || job->out_fd < 0 || fstat(job->in_fd, &s) != 0) {
+	int err = errno;
+	
+	if (job->in_fd >= 0) {
+	    close(job->in_fd);
+	}
+	if (job->out_fd >= 0) {
+	    close(job->out_fd);
+	}
+	errno = err;
+	return (false);
+    }
+
+    if ((uint64_t)s.st_blocks * 512 < (uint64_t)s.st_size ||
+	fallocate(job->out_fd, 0, 0, s.st_size) != 0) {
+	if (ftruncate(job->out_fd, s.st_size) != 0) {
+	    errno = 0;
+	}
+    }
+    
+    job->size = s.st_size;
+    job->ranges = (s.st_size + COPY_RANGE_SIZE - 1) / COPY_RANGE_SIZE;
+    job->rd = rd;
+    job->wr = wr;
+    job->want_crc = (crc != NULL);
+    job->devs = devs;
+    job->crcs.resize(job->ranges, 0);
+    job->next = 0;
+    job->done = 0;
+    job->failed = false;
+    // copy_file_range can't give us a CRC
+    job->use_range = !crc && !broken(devs, COPY_RANGE);
+    job->err = 0;
+    job->old = NULL;
+    job->sums = NULL;
+
+    return (run_ranges(job, crc));
+}
+
+
+/* Rewrites the blocks of out that differ from in, in place. An index
+ * that still describes out saves reading it. The index is removed before
+ * out is touched, so a copy that fails part way doesn't leave one that
+ * is wrong. sums gets the index of the new out.
+ */
+bool CopyEngine::copy_delta(const char *in, const char *out, const struct stat& src,
+			    const std::string& index, BlockIndex& sums, Throttle *rd,
+			    Throttle *wr, uint32_t *crc)
+{
+    std::shared_ptr<range_job_st> job(new range_job_st);
+    BlockIndex old(DELTA_BLOCK);
+    struct stat s;
+    
+    job->in_fd = open(in, O_RDONLY);
+    job->out_fd = open(out, O_RDWR | O_NOFOLLOW);
+    if (job->in_fd < 0 || job->out_fd < 0 || fstat(job->out_fd, &s) != 0) {
+	int err = errno;
+	
+	if (job->in_fd >= 0) {
+	    close(job->in_fd);
+	}
+	if (job->out_fd >= 0) {
+	    close(job->out_fd);
+	}
+	errno = err;
+	return (false);
+    }
+
+    bool known = !index.empty() && old.load(index, s);
+    if (!index.empty()) {
+	unlink(index.c_str());
+    }
+    sums.resize(src.st_size);
+
+    // blocks past the old end that are holes in in stay holes
+    if (ftruncate(job->out_fd, src.st_size) != 0) {
+	int err = errno;
+	
+	close(job->in_fd);
+	close(job->out_fd);
+	errno = err;
+	return (false);
+    }
+    
+    job->size = src.st_size;
+    job->ranges = (src.st_size + COPY_RANGE_SIZE - 1) / COPY_RANGE_SIZE;
+    job->rd = rd;
+    job->wr = wr;
+    job->want_crc = (crc != NULL);
+    job->crcs.resize(job->ranges, 0);
+    job->next = 0;
+    job->done = 0;
+    job->failed = false;
+    job->use_range = false;
+    job->err = 0;
+    job->old = known ? &old : NULL;
+    job->sums = &sums;
+    job->old_size = s.st_size;
+    job->written = 0;
+
+    if (!run_ranges(job, crc)) {
+	return (false);
+    }
+    
+    LOG(*_log, DEBUG) << "Delta copy of " << in << " rewrote " << job->written << " of "
+		      << job->size << " bytes" << (known ? "" : ", without an index")
+		      << std::endl;
+    return (true);
+}
+
+
+/* Works through the job's ranges with the pool's help, if there is a
+ * pool, then closes both files. With crc, the CRCs of the ranges are
+ * combined into it.
+ */
+bool CopyEngine::run_ranges(std::shared_ptr<range_job_st> job, uint32_t *crc)
+{
+    ThreadPool *pool = _pool;
+    
+    // helpers that start after the ranges are gone return straight away
+    uint32_t helpers = pool ? std::min(pool->size(), job->ranges - 1) : 0;
+    for (uint32_t i = 0; i < helpers; ++i) {
+	pool->submit([this, job]{ copy_ranges(job); }, 1);
+    }
+    copy_ranges(job);
+    
+    {
+	std::unique_lock<std::mutex> l(job->lock);
+	job->cv.wait(l, [job]{ return (job->done == job->ranges); });
+    }
+
+    close(job->in_fd);
+    if (close(job->out_fd) != 0 && !job->failed) {
+	job->failed = true;
+	job->err = errno;
+    }
+    if (job->failed) {
+	errno = job->err;
+	return (false);
+    }
+
+    if (crc) {
+	*crc = job->crcs[0];
+	for (uint32_t i = 1; i < job->ranges; ++i) {
+	    off_t len = std::min((off_t)COPY_RANGE_SIZE, job->size - (off_t)i * COPY_RANGE_SIZE);
+	    *crc = _crc.combine(*crc, job->crcs[i], len);
+	}
+    }
+    
+    return (true);
+}
+
+
+// takes ranges from the job until there are none left
+void CopyEngine::copy_ranges(std::shared_ptr<range_job_st> job)
+{
+    uint32_t i;
+    
+    while ((i = job->next++) < job->ranges) {
+	// once one range fails the rest are only counted off
+	if (!job->failed && !(job->sums ? delta_range(*job, i) : copy_range(*job, i))) {
+	    std::lock_guard<std::mutex> l(job->lock);
+	    if (!job->failed) {
+		job->err = errno;
+		job->failed = true;
+	    }
+	}
+	
+	if (++job->done == job->ranges) {
+	    std::lock_guard<std::mutex> l(job->lock);
+	    job->cv.notify_all();
+	}
+    }
+}
+
+
+/* Copies one range, skipping holes. A failed copy_file_range that is
+ * down to the two filesystems switches the whole job to pread/pwrite.
+ */
+bool CopyEngine::copy_range(range_job_st& job, const uint32_t i)
+{
+    Buffer buf(COPY_CHUNK);
+    char *buffer = (char *)buf.data();
+    off_t start = (off_t)i * COPY_RANGE_SIZE;
+    off_t end = std::min(job.size, start + (off_t)COPY_RANGE_SIZE);
+    off_t pos = start;
+    off_t data, hole;
+    uint32_t crc = 0;
+    
+    if (!buffer) {
+	errno = ENOMEM;
+	return (false);
+    }
+    while (next_extent(job.in_fd, pos, end, data, hole)) {
+	crc = _crc.zeros(crc, data - pos);
+	pos = data;
+	
+	while (job.use_range && pos < hole) {
+	    off_t out_pos = pos;
+	    ssize_t bytes = copy_file_range(job.in_fd, &pos, job.out_fd, &out_pos,
+					    std::min((off_t)COPY_RANGE_STEP, hole - pos), 0);
+	    if (bytes < 0 && errno == EINTR) {
+		continue;
+	    }
+	    if (bytes < 0 && (errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP ||
+			      errno == EXDEV)) {
+		if (job.use_range.exchange(false)) {
+		    set_broken(job.devs, COPY_RANGE);
+		}
+		break;
+	    }
+	    if (bytes <= 0) {
+		return (false);
+	    }
+	    if (job.rd) {
+		job.rd->consume(bytes);
+	    }
+	    if (job.wr) {
+		job.wr->consume(bytes);
+	    }
+	}
+	
+	while (pos < hole) {
+	    ssize_t bytes = pread(job.in_fd, buffer, std::min((off_t)COPY_CHUNK, hole - pos), pos);
+	    ssize_t done = 0;
+	    
+	    if (bytes < 0 && errno == EINTR) {
+		continue;
+	    }
+	    // 0 if the source was truncated under us
+	    if (bytes <= 0) {
+		return (false);
+	    }
+	    if (job.rd) {
+		job.rd->consume(bytes);
+	    }
+	    if (job.want_crc) {
+		crc = _crc.update(crc, (uint8_t *)buffer, bytes);
+	    }
+	    
+	    while (done < bytes) {
+		ssize_t rc = pwrite(job.out_fd, buffer + done, bytes - done, pos + done);
+		if (rc < 0 && errno == EINTR) {
+		    continue;
+		}
+		if (rc < 0) {
+		    return (false);
+		}
+		if (job.wr) {
+		    job.wr->consume(rc);
+		}
+		done += rc;
+	    }
+	    pos += bytes;
+	}
+    }
+
+    job.crcs[i] = _crc.zeros(crc, end - pos);
+    return (true);
+}
+
+
+/* Compares one range of the source with the destination a block at a
+ * time, going by the old index where there is one and by reading the
+ * destination where there isn't, and writes the blocks that differ.
+ * Every block's sums go in the new index.
+ */
+bool CopyEngine::delta_range(range_job_st& job, const uint32_t i)
+{
+    Buffer buf(DELTA_BLOCK), cur(DELTA_BLOCK);
+    uint8_t *buffer = buf.data();
+    uint8_t *current = cur.data();
+    off_t start = (off_t)i * COPY_RANGE_SIZE;
+    off_t end = std::min(job.size, start + (off_t)COPY_RANGE_SIZE);
+    uint32_t crc = 0;
+    
+    if (!buffer || !current) {
+	errno = ENOMEM;
+	return (false);
+    }
+    
+    for (off_t pos = start; pos < end; pos += DELTA_BLOCK) {
+	size_t len = std::min((off_t)DELTA_BLOCK, end - pos);
+	uint64_t b = pos / DELTA_BLOCK;
+	off_t data, hole;
+	block_sum_st sum, was;
+	bool same;
+	// a block that is all hole isn't read
+	bool empty = !next_extent(job.in_fd, pos, pos + len, data, hole);
+	
+	if (empty) {
+	    memset(buffer, 0, len);
+	} else if (!read_block(job.in_fd, buffer, len, pos, job.rd)) {
+	    return (false);
+	}
+	if (job.want_crc) {
+	    crc = _crc.update(crc, buffer, len);
+	}
+	sum = BlockIndex::sum(buffer, len);
+	job.sums->set(b, sum);
+
+	if (pos >= job.old_size) {
+	    same = empty;
+	} else if (job.old) {
+	    same = job.old->get(b, len, was) && BlockIndex::same(sum, was);
+	} else {
+	    same = (pos + (off_t)len <= job.old_size &&
+		    read_block(job.out_fd, current, len, pos, job.wr) &&
+		    memcmp(buffer, current, len) == 0);
+	}
+	
+	if (same) {
+	    continue;
+	}
+	// a block that is a hole in the source is punched out of the copy,
+	// and only written as zeros where that isn't supported
+	if (!(empty && fallocate(job.out_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+				 pos, len) == 0) &&
+	    !write_block(job.out_fd, buffer, len, pos, job.wr)) {
+	    return (false);
+	}
+	job.written += len;
+    }
+
+    job.crcs[i] = crc;
+    return (true);
+}
+
+
+/* Compresses in to out a frame at a time, this thread and the pool's
+ * side by side. Each frame is given its place in out as soon as the
+ * one before it has one, so only that waits on the order of the frames,
+ * the reads, compression and writes don't.
+ */
+bool CopyEngine::copy_compressed(const char *in, const int out_fd, const int level,
+				 Throttle *rd, Throttle *wr, uint32_t *crc,
+				 copy_stored_st *stored)
+{
+    std::shared_ptr<compress_job_st> job(new compress_job_st);
+    ThreadPool *pool = _pool;
+    struct stat s;
+    
+    // the job closes its own descriptor for out
+    job->in_fd = open(in, O_RDONLY);
+    job->out_fd = dup(out_fd);
+    if (job->in_fd < 0 || job->out_fd < 0 || fstat(job->in_fd, &s) != 0) {
+	int err = errno;
+	
+	if (job->in_fd >= 0) {
+	    close(job->in_fd);
+	}
+	if (job->out_fd >= 0) {
+	    close(job->out_fd);
+	}
+	errno = err;
+	return (false);
+    }
+
+    job->size = s.st_size;
+    job->frames = (s.st_size + COMPRESSED_FRAME - 1) / COMPRESSED_FRAME;
+    job->level = level;
+    job->rd = rd;
+    job->wr = wr;
+    job->index.resize(job->frames);
+    job->next = 0;
+    job->done = 0;
+    job->failed = false;
+    job->err = 0;
+    job->placed = 0;
+    job->offset = 0;
+
+    // helpers that start after the frames are gone return straight away
+    uint32_t helpers = (pool && job->frames) ? std::min(pool->size(), job->frames - 1) : 0;
+    for (uint32_t i = 0; i < helpers; ++i) {
+	pool->submit([this, job]{ compress_frames(job); }, 1);
+    }
+    compress_frames(job);
+    
+    {
+	std::unique_lock<std::mutex> l(job->lock);
+	job->cv.wait(l, [job]{ return (job->done == job->frames); });
+    }
+
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < job->frames; ++i) {
+	sum = _crc.combine(sum, job->index[i].crc, job->index[i].size);
+    }
+    if (!job->failed &&
+	!write_compressed_index(job->out_fd, job->offset, job->index, job->size, sum, _crc, wr,
+				stored ? &stored->size : NULL, stored ? &stored->crc : NULL)) {
+	job->failed = true;
+	job->err = errno;
+    }
+
+    close(job->in_fd);
+    if (close(job->out_fd) != 0 && !job->failed) {
+	job->failed = true;
+	job->err = errno;
+    }
+    if (job->failed) {
+	errno = job->err;
+	return (false);
+    }
+
+    if (crc) {
+	*crc = sum;
+    }
+    LOG(*_log, DEBUG) << "Compressed " << in << " from " << job->size << " to "
+		      << job->offset << " bytes" << std::endl;
+    return (true);
+}
+
+
+// takes frames from the job until there are none left
+void CopyEngine::compress_frames(std::shared_ptr<compress_job_st> job)
+{
+    Buffer in(COMPRESSED_FRAME);
+    Buffer out(compressed_bound(COMPRESSED_FRAME));
+    uint32_t i;
+
+    while ((i = job->next++) < job->frames) {
+	compressed_frame_st& f = job->index[i];
+	off_t pos = (off_t)i * COMPRESSED_FRAME;
+	size_t len = std::min((off_t)COMPRESSED_FRAME, job->size - pos);
+
+	// once one frame fails the rest are only counted off, but each
+	// still takes its turn. Buffers and zlib only fail for memory
+	errno = ENOMEM;
+	bool ok = (!job->failed && in.data() && out.data() &&
+		   read_block(job->in_fd, in.data(), len, pos, job->rd) &&
+		   compress_frame(in.data(), len, job->level, out.data(), f, _crc));
+	{
+	    std::unique_lock<std::mutex> l(job->lock);
+	    job->cv.wait(l, [job, i]{ return (job->placed == i); });
+	    f.offset = job->offset;
+	    job->offset += ok ? f.length : 0;
+	    ++job->placed;
+	    job->cv.notify_all();
+	}
+	
+	if (ok && !write_block(job->out_fd, out.data(), f.length, f.offset, job->wr)) {
+	    ok = false;
+	}
+	if (!ok && !job->failed) {
+	    std::lock_guard<std::mutex> l(job->lock);
+	    if (!job->failed) {
+		job->err = errno;
+		job->failed = true;
+	    }
+	}
+	
+	if (++job->done == job->frames) {
+	    std::lock_guard<std::mutex> l(job->lock);
+	    job->cv.notify_all();
+	}
+    }
+}
+
+
+bool CopyEngine::broken(const dev_pair& devs, const copy_method_e m)
+{
+    std::lock_guard<std::mutex> l(_lock);
+    auto it = _broken.find(devs);
+
+    return (it != _broken.end() && it->second.test(m));
+}
+
+
+void CopyEngine::set_broken(const dev_pair& devs, const copy_method_e m)
+{
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	_broken[devs].set(m);
+    }
+
+    LOG(*_log, INFO) << copy_method_str(m) << " is not supported from device " << devs.first
+		     << " to " << devs.second << ", falling back" << std::endl;
+}
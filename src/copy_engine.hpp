@@ -0,0 +1,276 @@
+/* Backup Manager Copy Engine
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ * 10/19/2026 - reflink and copy_file_range
+ * 10/19/2026 - CRC while copying, verify
+ * 10/19/2026 - parallel copies of large files
+ * 10/19/2026 - batched copies of small files
+ * 10/19/2026 - delta copies over existing destinations
+ * 10/19/2026 - copies made under a temporary name, staged for commit()
+ * 10/19/2026 - compressed copies
+ *
+ */
+
+#ifndef __COPY_ENGINE__
+#define __COPY_ENGINE__
+
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <bitset>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "logger.hpp"
+#include "throttle.hpp"
+#include "thread_pool.hpp"
+#include "crc32.hpp"
+#include "block_index.hpp"
+#include "compressed.hpp"
+
+
+// files smaller than this are small, and are read and written in one go
+#define COPY_SMALL_FILE (64 * 1024)
+
+
+// the ways a file can be copied, fastest first
+typedef enum copy_method_e {
+    COPY_CLONE = 0,
+    COPY_PARALLEL,
+    COPY_RANGE,
+    COPY_SENDFILE,
+    COPY_READ_WRITE,
+    // not a fallback, only tried on an existing destination
+    COPY_DELTA,
+    // not a fallback, every copy is compressed when it is on
+    COPY_COMPRESS,
+    COPY_METHODS
+} copy_method_e;
+
+const char* copy_method_str(const copy_method_e);
+
+
+// how a copy is kept on disk, when it isn't the source byte for byte.
+// A size of 0 is a plain copy
+typedef struct copy_stored_st {
+    uint64_t size;
+    uint32_t crc;
+} copy_stored_st;
+
+
+// one file in a batch, ok, crc and stored are set by the copy
+typedef struct copy_item_st {
+    std::string in;
+    std::string out;
+    uint32_t crc;
+    bool ok;
+    copy_stored_st stored;
+} copy_item_st;
+
+
+/* Copies files with the fastest primitive that works between the two
+ * filesystems involved, falling back to the next one when it doesn't.
+ * A primitive that isn't supported between two devices is not tried
+ * between them again. The destination is replaced and gets the mode
+ * and times of the source. Safe to use from several threads.
+ *
+ * Each copy is made in a temporary file beside the destination and
+ * renamed over it, so the destination is never seen half written. With
+ * durable copies on, the renames wait for commit(), which gets a whole
+ * batch of copies to disk with a few syncs rather than one per file.
+ * Delta copies are the exception: they are written in place, so a
+ * crash during one can leave the destination partly updated. With
+ * durable copies on, each is synced before copy() returns.
+ *
+ * When a CRC is wanted the data has to pass through our buffers, so
+ * only reflinks and read/write copies are used. A reflink's CRC costs
+ * one read of the source, a read/write copy's costs nothing extra.
+ *
+ * Given a thread pool, files of at least a set size are copied as fixed
+ * size ranges at once, with copy_file_range or pread/pwrite, so a large
+ * file can use the bandwidth of every disk in a stripe. The thread that
+ * asked for the copy works through the ranges along with the pool, so
+ * the copy finishes even if the pool is busy, and can be asked for from
+ * one of the pool's own tasks.
+ *
+ * Batches of small files are copied in the order of the sources'
+ * inodes, split across the pool the same way. Each small file is read
+ * and written whole through a buffer kept for the batch, with as few
+ * calls as possible. Reflinks aren't tried for them, as they save little.
+ *
+ * With delta copies on, a large file copied over an older copy of
+ * itself is compared a block at a time, and only the blocks that differ
+ * are written, in place, with blocks that are holes in the source
+ * punched out of the copy. The checksums of each block are kept in an
+ * index beside the copy, so next time the copy doesn't have to be read
+ * to be compared. Blocks are compared at the same offset in both files,
+ * data that has moved within the file is copied again.
+ *
+ * With compression on, every copy is made in the format CompressedFile
+ * reads instead, its frames compressed by this thread and the pool side
+ * by side. Verifying a compressed copy checks the frames as stored
+ * against their index, without inflating them. Delta copies aren't
+ * made of compressed files.
+ */
+class CopyEngine {
+public:
+    CopyEngine(Logger*);
+    // copies still staged are thrown away
+    ~CopyEngine();
+    CopyEngine(const CopyEngine&) = delete;
+    CopyEngine &operator=(const CopyEngine&) = delete;
+
+    // the throttles are charged for bytes read from in and written to
+    // out. With crc, it is set to the CRC32 of the data copied, and with
+    // stored, to how the copy is kept if it is compressed
+    bool copy(const std::string& in, const std::string& out,
+	      Throttle *rd = NULL, Throttle *wr = NULL, uint32_t *crc = NULL,
+	      copy_stored_st *stored = NULL);
+    // copies every item, always with its CRC. Files that aren't small
+    // go through copy()
+    void copy_batch(std::vector<copy_item_st>& items, Throttle *rd = NULL, Throttle *wr = NULL);
+    // read each copy back from disk, and fail it if it doesn't match
+    // the CRC of the source. Only for copies asked for a CRC
+    void set_verify(const bool);
+    // copy files of at least min_size a range at a time on pool. NULL
+    // turns it off
+    void set_parallel(ThreadPool *pool, const uint64_t min_size);
+    // copy files of at least min_size over an existing destination as
+    // a delta, keeping block indexes in index_dir. A min_size of 0 turns
+    // it off, an empty index_dir compares against the destination itself
+    void set_delta(const std::string& index_dir, const uint64_t min_size);
+    // leave copies staged until commit(), rather than renaming each
+    // into place when it's done
+    void set_durable(const bool);
+    // make every copy compressed, at a zlib level from 1 to 9. 0 turns
+    // it off
+    void set_compress(const int level);
+    // syncs and renames every copy staged so far, by any thread, and
+    // returns the destinations that couldn't be committed. Their copies
+    // are removed
+    std::vector<std::string> commit();
+    // how many files were copied with m
+    uint64_t copied(const copy_method_e m) const;
+
+private:
+    typedef std::pair<dev_t, dev_t> dev_pair;
+
+    // a finished copy waiting to be renamed over its destination
+    typedef struct staged_st {
+	std::string tmp;
+	std::string out;
+    } staged_st;
+
+    // one parallel copy, shared by every thread working on it
+    typedef struct range_job_st {
+	int in_fd;
+	int out_fd;
+	off_t size;
+	uint32_t ranges;
+	Throttle *rd;
+	Throttle *wr;
+	bool want_crc;
+	dev_pair devs;
+	// for a delta, what is known of out before, and the sums of in
+	const BlockIndex *old;
+	BlockIndex *sums;
+	off_t old_size;
+	std::atomic<uint64_t> written;
+	std::vector<uint32_t> crcs;
+	// the next range to be taken, and how many are finished
+	std::atomic<uint32_t> next;
+	std::atomic<uint32_t> done;
+	std::atomic<bool> failed;
+	std::atomic<bool> use_range;
+	int err;
+	std::mutex lock;
+	std::condition_variable cv;
+    } range_job_st;
+    
+    // one batch of small files, shared by every thread working on it
+    typedef struct batch_job_st {
+	std::vector<copy_item_st> *items;
+	// index into items and the stat of the source, in inode order
+	std::vector<std::pair<uint32_t, struct stat> > order;
+	uint32_t chunks;
+	Throttle *rd;
+	Throttle *wr;
+	// the next chunk to be taken, and how many are finished
+	std::atomic<uint32_t> next;
+	std::atomic<uint32_t> done;
+	std::mutex lock;
+	std::condition_variable cv;
+    } batch_job_st;
+
+    // one compressed copy, shared by every thread working on it
+    typedef struct compress_job_st {
+	int in_fd;
+	int out_fd;
+	off_t size;
+	uint32_t frames;
+	int level;
+	Throttle *rd;
+	Throttle *wr;
+	std::vector<compressed_frame_st> index;
+	// the next frame to be taken, and how many are finished
+	std::atomic<uint32_t> next;
+	std::atomic<uint32_t> done;
+	std::atomic<bool> failed;
+	int err;
+	// frames given a place in out so far, and where the next goes
+	uint32_t placed;
+	uint64_t offset;
+	std::mutex lock;
+	std::condition_variable cv;
+    } compress_job_st;
+    
+    bool copy_with(const copy_method_e, const char *, const int, const uint64_t,
+		   Throttle *, Throttle *, uint32_t *, const dev_pair&);
+    void copy_chunks(std::shared_ptr<batch_job_st>);
+    bool copy_small(copy_item_st&, const struct stat&, char *, Throttle *, Throttle *);
+    bool compress_small(const int, const uint8_t *, const size_t, const int, Throttle *,
+			copy_stored_st&);
+    bool verify(const std::string&, const std::string&, const std::string&, const uint32_t,
+		Throttle *, const bool);
+    bool place(const std::string&, const std::string&);
+    bool copy_parallel(const char *, const int, const dev_pair&, Throttle *, Throttle *,
+		       uint32_t *);
+    bool copy_delta(const char *, const char *, const struct stat&, const std::string&,
+		    BlockIndex&, Throttle *, Throttle *, uint32_t *);
+    bool run_ranges(std::shared_ptr<range_job_st>, uint32_t *);
+    void copy_ranges(std::shared_ptr<range_job_st>);
+    bool copy_range(range_job_st&, const uint32_t);
+    bool delta_range(range_job_st&, const uint32_t);
+    bool copy_compressed(const char *, const int, const int, Throttle *, Throttle *,
+			 uint32_t *, copy_stored_st *);
+    void compress_frames(std::shared_ptr<compress_job_st>);
+    bool broken(const dev_pair&, const copy_method_e);
+    void set_broken(const dev_pair&, const copy_method_e);
+    
+    Logger *_log;
+    CRC32 _crc;
+    std::mutex _lock;
+    // methods found not to work from one device to another
+    std::map<dev_pair, std::bitset<COPY_METHODS> > _broken;
+    std::atomic<uint64_t> _copied[COPY_METHODS];
+    std::atomic<bool> _verify;
+    std::atomic<ThreadPool*> _pool;
+    std::atomic<uint64_t> _parallel_min;
+    std::string _index_dir;
+    std::atomic<uint64_t> _delta_min;
+    std::atomic<bool> _durable;
+    std::atomic<int> _compress;
+    std::vector<staged_st> _staged;
+};
+
+#endif
@@ -11,15 +11,28 @@
  *              cases and close fd when done
  * 04/25/2014 - Change some data types, add assert
  * 04/27/2014 - handle error return codes from readall()
+ * 10/19/2026 - optional Throttle
+ * 10/19/2026 - holes are skipped and their CRC computed from their length
+ * 10/19/2026 - update() and direct reads
+ * 10/19/2026 - combine()
+ * 10/19/2026 - buffers from the BufferPool
  *
  */
 
 #include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <algorithm>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
 #include "crc32.hpp"
-#include "common.hpp"
+#include "buffer_pool.hpp"
+
+
+// buffer, offset and length alignment for O_DIRECT
+#define DIRECT_ALIGN 4096
 
 
 CRC32::CRC32(const uint32_t chunk_size)
@@ -75,31 +88,175 @@ CRC32::CRC32(const uint32_t chunk_size)
 }
 
 
-ssize_t CRC32::crc32(const std::string& filename) const
+/* Only the data in the file is read. Each hole is folded into the CRC
+ * with zeros(), as if it had been read as the zeros it holds. Direct
+ * reads always ask for a whole, aligned buffer and use only what is in
+ * the extent being read.
+ */
+ssize_t CRC32::crc32(const std::string& filename, Throttle *throttle, bool direct) const
 {
     int fd;
-    int bytes_read;
+    ssize_t bytes_read;
     uint32_t crc = 0UL;
-    uint8_t buffer[_chunk];
+    size_t len = (_chunk + DIRECT_ALIGN - 1) & ~(DIRECT_ALIGN - 1);
+    Buffer buf(len);
+    uint8_t *buffer = buf.data();
+    struct stat s;
+    off_t pos = 0;
+    bool ok = true;
     
-    if ((fd = open(filename.c_str(), O_RDONLY)) < 0) {
+    fd = open(filename.c_str(), O_RDONLY | (direct ? O_DIRECT : 0));
+    // not every filesystem does direct I/O
+    if (fd < 0 && direct && errno == EINVAL) {
+	direct = false;
+	fd = open(filename.c_str(), O_RDONLY);
+    }
+    if (fd < 0) {
+	return (-1);
+    }
+    if (fstat(fd, &s) != 0 || !buffer) {
+	close(fd);
 	return (-1);
     }
     
-    
-    bytes_read = readall(fd, buffer, _chunk);
-    while (bytes_read > 0) {
-	crc = _crc32(crc, buffer, bytes_read);
+    while (ok && pos < s.st_size) {
+	off_t data = lseek(fd, pos, SEEK_DATA);
+	off_t hole;
 	
-	bytes_read = readall(fd, buffer, _chunk);
-	if (bytes_read < 0) {
-	    close(fd);
-	    return (-1);
+	// ENXIO means the rest of the file is a hole
+	if (data < 0) {
+	    data = (errno == ENXIO) ? s.st_size : pos;
+	}
+	hole = (data < s.st_size) ? lseek(fd, data, SEEK_HOLE) : s.st_size;
+	if (hole < 0) {
+	    hole = s.st_size;
+	}
+	
+	crc = zeros(crc, data - pos);
+	pos = data;
+	
+	while (pos < hole) {
+	    bytes_read = pread(fd, buffer, direct ? len : std::min((off_t)_chunk, hole - pos), pos);
+	    if (bytes_read < 0 && errno == EINTR) {
+		continue;
+	    }
+	    // an extent that isn't aligned for direct I/O
+	    if (bytes_read < 0 && direct && errno == EINVAL) {
+		direct = false;
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+		continue;
+	    }
+	    // 0 if the file was truncated under us
+	    if (bytes_read <= 0) {
+		ok = (bytes_read == 0);
+		pos = s.st_size;
+		break;
+	    }
+	    bytes_read = std::min((off_t)bytes_read, hole - pos);
+	    if (throttle) {
+		throttle->consume(bytes_read);
+	    }
+	    crc = _crc32(crc, buffer, bytes_read);
+	    pos += bytes_read;
 	}
     }
 
     close(fd);
-    return (crc);
+    return (ok ? crc : -1);
+}
+
+
+uint32_t CRC32::update(const uint32_t crc, const uint8_t *ptr, const size_t len) const
+{
+    return (_crc32(crc, ptr, len));
+}
+
+
+// multiplies vec by the 32x32 bit matrix mat, over GF(2)
+static uint32_t gf2_times(const uint32_t *mat, uint32_t vec)
+{
+    uint32_t sum = 0;
+    
+    while (vec) {
+	if (vec & 1) {
+	    sum ^= *mat;
+	}
+	vec >>= 1;
+	++mat;
+    }
+    
+    return (sum);
+}
+
+
+static void gf2_square(uint32_t *square, const uint32_t *mat)
+{
+    for (uint32_t n = 0; n < 32; ++n) {
+	square[n] = gf2_times(mat, mat[n]);
+    }
+}
+
+
+/* Feeding a zero bit through the CRC register is a linear map, so a run
+ * of len zero bytes is that map raised to the power 8 * len, which takes
+ * log2(len) squarings of the matrix rather than len table lookups. Same
+ * approach as zlib's crc32_combine. Works on the register, without the
+ * inversions at either end
+ */
+static uint32_t shift(uint32_t reg, uint64_t len)
+{
+    uint32_t even[32];
+    uint32_t odd[32];
+    uint32_t row = 1;
+
+    if (len == 0) {
+	return (reg);
+    }
+
+    // one zero bit: shift right, and xor in the polynomial if a one
+    // fell off the end
+    odd[0] = 0xedb88320UL;
+    for (uint32_t n = 1; n < 32; ++n) {
+	odd[n] = row;
+	row <<= 1;
+    }
+    // two, then four zero bits
+    gf2_square(even, odd);
+    gf2_square(odd, even);
+
+    // from here each square is a whole number of bytes, the first one
+    // being a single byte
+    do {
+	gf2_square(even, odd);
+	if (len & 1) {
+	    reg = gf2_times(even, reg);
+	}
+	len >>= 1;
+	if (len == 0) {
+	    break;
+	}
+	
+	gf2_square(odd, even);
+	if (len & 1) {
+	    reg = gf2_times(odd, reg);
+	}
+	len >>= 1;
+    } while (len);
+
+    return (reg);
+}
+
+
+uint32_t CRC32::zeros(const uint32_t crc, uint64_t len) const
+{
+    return (shift(crc ^ 0xffffffffUL, len) ^ 0xffffffffUL);
+}
+
+
+// the inversions at either end cancel out between the two CRCs
+uint32_t CRC32::combine(const uint32_t first, const uint32_t second, uint64_t len) const
+{
+    return (shift(first, len) ^ second);
 }
 
 
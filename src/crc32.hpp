@@ -9,6 +9,9 @@
  * 04/22/2014 - Initial open source release
  * 04/23/2014 - Change return type of crc32()
  * 04/25/2014 - change len to const size_t
+ * 10/19/2026 - optional Throttle
+ * 10/19/2026 - skip holes, zeros()
+ * 10/19/2026 - update(), direct reads, combine()
  *
  */
 
@@ -18,12 +21,26 @@
 #include <array>
 #include <string>
 
+#include "throttle.hpp"
+
 class CRC32 {
 
 public:
     CRC32(const uint32_t chunk_size);
 
-    ssize_t crc32(const std::string& filename) const;
+    // every chunk read is charged to throttle, if one is given. Holes
+    // in sparse files aren't read. A direct read bypasses the page
+    // cache where the filesystem allows it
+    ssize_t crc32(const std::string& filename, Throttle *throttle = NULL,
+		  bool direct = false) const;
+    // the CRC of the data seen so far, crc, followed by len more bytes
+    uint32_t update(const uint32_t crc, const uint8_t *ptr, const size_t len) const;
+    // the CRC of some data followed by len zero bytes, from the CRC
+    // of the data alone
+    uint32_t zeros(const uint32_t crc, uint64_t len) const;
+    // the CRC of two pieces of data one after the other, from the CRC
+    // of each and the length of the second
+    uint32_t combine(const uint32_t first, const uint32_t second, uint64_t len) const;
     
 private:
     uint32_t _crc32(uint32_t crc, const uint8_t *ptr, const size_t len) const;
@@ -8,108 +8,199 @@
  *
  * 10/05/2014 - Initial open source release
  * 11/26/2015 - Improvements to queries
+ * 10/19/2026 - Pooled, per-thread connections
+ * 10/19/2026 - Pluggable storage backends
+ * 10/19/2026 - Directory ID and directory contents caches
+ * 10/19/2026 - Bloom filter in front of file lookups
+ * 10/19/2026 - caches cleared by set_db, listings invalidated after writes
  *
  */
 
 #include <cassert>
+#include <algorithm>
 
 #include "db.hpp"
+#ifndef NO_MYSQL
+#include "db_mysql.hpp"
+#endif
 
 
+#ifndef NO_MYSQL
 BackupManagerDB::BackupManagerDB(const std::string& ip, const std::string& user, 
-				 const std::string& password, Logger* l) : _log(l)
+				 const std::string& password, Logger* l,
+				 const uint32_t pool_size) : _log(l),
+							     _dir_ids(65536),
+							     _dirs(64),
+							     _dirs_gen(0),
+							     _bloom(NULL),
+							     _bloom_fp(0),
+							     _bloom_bytes(0)
 {
-    std::string new_ip = "tcp://" + ip + ":3306";
-    try {
-	_driver = get_driver_instance();
-	_conn = _driver->connect(new_ip.c_str(), user.c_str(), password.c_str());
-	_stmt = _conn->createStatement();
-    }  catch (sql::SQLException& e) {
-	(*_log) << ERROR << "DB Exception: " << e.what() << std::endl;
-    }
+    _backend = new MySQLBackend(ip, user, password, l, pool_size);
+}
+#endif
+
 
-    _db_name = "backup_maanger";
-    _dir_table = "Directories";
-    _file_table = "Files";
+BackupManagerDB::BackupManagerDB(DBBackend *backend, Logger *l) : _log(l),
+								  _backend(backend),
+								  _dir_ids(65536),
+								  _dirs(64),
+								  _dirs_gen(0),
+								  _bloom(NULL),
+								  _bloom_fp(0),
+								  _bloom_bytes(0)
+{
+    assert(_backend);
 }
 
 
 BackupManagerDB::~BackupManagerDB()
 {
-    _driver->threadEnd();
-    delete _stmt;
-    delete _conn;
+    delete _bloom;
+    delete _backend;
+}
+
+
+/* Must be called by any thread other than the one that created this object
+ * before it exits.
+ */
+void BackupManagerDB::thread_end()
+{
+    _backend->thread_end();
 }
 
 
+/* Sets how many directory IDs and how many directory listings are
+ * cached. A size of 0 disables that cache.
+ */
+void BackupManagerDB::set_cache_size(const size_t ids, const size_t dirs)
+{
+    _dir_ids.set_capacity(ids);
+    _dirs.set_capacity(dirs);
+}
+
+
+static std::string bloom_key(const std::string& path, const std::string& name)
+{
+    return (path + '\0' + name);
+}
+
+
+/* Loads every file record into a Bloom filter so that exists() can answer
+ * "no" without a query. Only valid if this is the only writer to the DB,
+ * a file inserted by anyone else would be reported as missing.
+ */
+void BackupManagerDB::enable_bloom(const double fp_rate, const uint64_t max_bytes)
+{
+    uint64_t count = _backend->file_count();
+    
+    _bloom_fp = fp_rate;
+    _bloom_bytes = max_bytes;
+    delete _bloom;
+    // leave room for the files that will be added while running
+    _bloom = new BloomFilter(std::max<uint64_t>(count * 2, 1 << 20), fp_rate, max_bytes);
+    _backend->scan_files([this](const std::string& path, const std::string& name) {
+	    _bloom->add(bloom_key(path, name));
+	});
+
+    LOG(*_log, INFO) << "Loaded " << count << " files into a " << _bloom->bits() / 8
+		     << " byte Bloom filter with " << _bloom->hashes() << " hashes" << std::endl;
+}
+
+
+/* Nothing cached describes the new DB. A Bloom filter is loaded again
+ * from it by init_tables()
+ */
 void BackupManagerDB::set_db(const std::string& db, const std::string& dir, const std::string& file)
 {
-    _db_name = db;
-    _dir_table = dir;
-    _file_table = file;
+    _backend->set_db(db, dir, file);
+    _dir_ids.clear();
+    {
+	std::lock_guard<std::mutex> l(_dirs_lock);
+	++_dirs_gen;
+	_dirs.clear();
+    }
+    delete _bloom;
+    _bloom = NULL;
 }
 
+
 void BackupManagerDB::init_tables()
 {
-    try{
-	_stmt->execute("CREATE DATABASE IF NOT EXISTS " + _db_name);
-	_stmt->execute("USE " + _db_name);
-	
-	_stmt->execute("CREATE TABLE IF NOT EXISTS " + _dir_table + " "
-		       "(DirID INT AUTO_INCREMENT,"
-		       "Path VARCHAR(4096),"
-		       "Name VARCHAR(255),"
-		       "PRIMARY KEY(DirID)) ENGINE=InnoDB");
-	
-	_stmt->execute("CREATE TABLE IF NOT EXISTS " + _file_table + " "
-		       "(FileID INT AUTO_INCREMENT,"
-		       "Dir INT,"
-		       "Path VARCHAR(4096),"
-		       "FileName VARCHAR(255),"
-		       "FileModified BIGINT,"
-		       "FileSize BIGINT,"
-		       "CRC32 BIGINT,"
-		       "LastChecked BIGINT,"
-		       "PRIMARY KEY(FileID),"
-		       "FOREIGN KEY(Dir) REFERENCES " + _dir_table + "(DirID)"
-		       "ON DELETE CASCADE) ENGINE=InnoDB");
-	
-	_conn->commit();
-    } catch (sql::SQLException& e) {
-	(*_log) << ERROR << "Exception: " << e.what() << std::endl;
+    _backend->init_tables();
+    if (_bloom_fp > 0 && !_bloom) {
+	enable_bloom(_bloom_fp, _bloom_bytes);
     }
 }
 
 
 void BackupManagerDB::drop_tables()
 {
-    _stmt->execute("DROP TABLE IF EXISTS " + _file_table + ";");
-    _stmt->execute("DROP TABLE IF EXISTS " + _dir_table + ";");
-    _conn->commit();		   
+    _backend->drop_tables();
+    _dir_ids.clear();
+    {
+	std::lock_guard<std::mutex> l(_dirs_lock);
+	++_dirs_gen;
+	_dirs.clear();
+    }
+    if (_bloom) {
+	_bloom->clear();
+    }
 }
 
 
 void BackupManagerDB::drop_db()
 {
-    _stmt->execute("DROP DATABASE IF EXISTS " + _db_name + ";");
-    _conn->commit();
+    _backend->drop_db();
+    _dir_ids.clear();
+    {
+	std::lock_guard<std::mutex> l(_dirs_lock);
+	++_dirs_gen;
+	_dirs.clear();
+    }
+    if (_bloom) {
+	_bloom->clear();
+    }
+}
+
+
+bool BackupManagerDB::lookup_dir_id(const std::string& path, uint32_t& id)
+{
+    size_t key = _hash(path);
+    dir_id_entry e;
+    
+    if (_dir_ids.get(key, e) && e.first == path) {
+	id = e.second;
+	return (true);
+    }
+
+    if (_backend->dir_id(path, id)) {
+	_dir_ids.put(key, std::make_pair(path, id));
+	return (true);
+    }
+    
+    return (false);
+}
+
+
+// drops the cached listing for a directory whose files have been
+// written. Called once the write can be seen by other connections
+void BackupManagerDB::invalidate(const std::string& path)
+{
+    std::lock_guard<std::mutex> l(_dirs_lock);
+    ++_dirs_gen;
+    _dirs.erase(_hash(path));
 }
 
 
 uint32_t BackupManagerDB::get_dir_id(const std::string& path)
 {
-    uint32_t id;
+    uint32_t id = 0;
+    
+    if (!lookup_dir_id(path, id)) {
+	LOG(*_log, ERROR) << "No DB entry for directory " << path << std::endl;
+    }
     
-    try {
-	_res = _stmt->executeQuery("SELECT DirID FROM " + _dir_table + " WHERE "
-				   "Path = \"" + path + "\";");
-	_res->next();
-	id = _res->getInt(1);
-    }  catch (sql::SQLException& e) {
-	(*_log) << ERROR << "DB Exception: " << e.what() << std::endl;
-    }	
-
-    delete _res;
     return (id);
 }
 
@@ -117,36 +208,29 @@ uint32_t BackupManagerDB::get_dir_id(const std::string& path)
 Directory BackupManagerDB::get(const Directory& dir)
 {
     Directory ret;
+    uint32_t id;
+    uint64_t gen;
+    size_t key = _hash(dir.path);
     
-    try {
-	_res = _stmt->executeQuery("SELECT DirID FROM " + _dir_table + " WHERE "
-				   "Path = \"" + dir.path + "\";");
+    if (_dirs.get(key, ret) && ret.path == dir.path) {
+	ret.name = dir.name;
+	return (ret);
+    }
+    {
+	std::lock_guard<std::mutex> l(_dirs_lock);
+	gen = _dirs_gen;
+    }
+
+    ret = Directory();
+    if (lookup_dir_id(dir.path, id)) {
+	ret.path = dir.path;
+	ret.name = dir.name;
+	_backend->get_files(id, ret.files);
 	
-	if (_res->next()) {
-	    uint32_t id = _res->getInt(1);
-	    ret.path = dir.path;
-	    ret.name = dir.name;
-	    
-	    delete _res;
-	    _res = _stmt->executeQuery("SELECT * FROM " + _file_table + " WHERE Dir = "
-				       + std::to_string(id) + ";");
-	    
-	    while(_res->next()) {
-		File f;
-		f.path = _res->getString(3);
-		f.name = _res->getString(4);
-		f.modified = _res->getInt(5);
-		f.size = _res->getInt(6);
-		f.crc = _res->getInt(7);
-		f.checked = _res->getInt(8);
-		
-		ret.files.insert(std::make_pair(f.name, f));
-	    }
-	    
-	    delete _res;
+	std::lock_guard<std::mutex> l(_dirs_lock);
+	if (gen == _dirs_gen) {
+	    _dirs.put(key, ret);
 	}
-    }  catch (sql::SQLException& e) {
-	(*_log) << ERROR << "DB Exception: " << e.what() << std::endl;
     }
     
     return (ret);
@@ -155,91 +239,54 @@ Directory BackupManagerDB::get(const Directory& dir)
 
 bool BackupManagerDB::exists(const Directory& dir)
 {
-    try {
-	_res = _stmt->executeQuery("SELECT DirID FROM " + _dir_table + " WHERE "
-				   "Path = \"" + dir.path + "\";");
-	if (_res->next()) {
-	    delete _res;
-	    return (true);
-	}
-    }  catch (sql::SQLException& e) {
-	(*_log) << ERROR << "DB Exception: " << e.what() << std::endl;
-    }
+    uint32_t id;
     
-    delete _res;
-    return (false);
+    return (lookup_dir_id(dir.path, id));
 }
 
 
 bool BackupManagerDB::exists(const File& file)
 {
-    try {
-	_res = _stmt->executeQuery("SELECT FileID FROM " + _file_table + " WHERE "
-				   "Path = \"" + file.path + "\" AND FileName = \""
-				   + file.name + "\";");
-	if (_res->next()) {
-	    delete _res;
-	    return (true);
-	}
-	
-    }  catch (sql::SQLException& e) {
-	(*_log) << ERROR << "DB Exception: " << e.what() << std::endl;
+    if (_bloom && !_bloom->maybe_contains(bloom_key(file.path, file.name))) {
+	return (false);
     }
     
-    delete _res;
-    return (false);
+    return (_backend->file_exists(file));
 }
 
+
 void BackupManagerDB::insert(const Directory& dir)
 {
-    try {
-	if (!exists(dir)) {
-	    _stmt->execute("INSERT INTO " + _dir_table + " (Path, Name) VALUES (\"" +
-			   dir.path + "\", \"" + dir.name + "\");");
-	    _conn->commit();
-	}
-	
-	for (file_cit i = dir.files.cbegin(); i != dir.files.cend(); ++i) {
-	    insert(i->second);
-	}
-	_conn->commit();
-    }  catch (sql::SQLException& e) {
-	(*_log) << ERROR << "DB Exception: " << e.what() << std::endl;
+    _backend->begin();
+    
+    if (!exists(dir)) {
+	_backend->insert_dir(dir);
     }
+    
+    for (file_cit i = dir.files.cbegin(); i != dir.files.cend(); ++i) {
+	insert(i->second);
+    }
+    
+    _backend->commit();
+    invalidate(dir.path);
 }
     
 
 void BackupManagerDB::insert(const File& file)
 {
-    try {
-	if (!exists(file)) {
-	    uint32_t id = get_dir_id(file.path);
-	    _stmt->execute("INSERT INTO " + _file_table + " (Dir, Path, FileName, FileSize, "
-			   "FileModified, CRC32, LastChecked)"
-			   " VALUES (" + std::to_string(id) + ", \"" + file.path + "\", \""
-			   + file.name + "\", " + std::to_string(file.size) + ", " +
-			   std::to_string(file.modified) + ", " + std::to_string(file.crc) +
-			   ", " + std::to_string(file.checked) + ");"); 
+    if (!exists(file)) {
+	_backend->insert_file(file, get_dir_id(file.path));
+	invalidate(file.path);
+	if (_bloom) {
+	    _bloom->add(bloom_key(file.path, file.name));
 	}
-    }  catch (sql::SQLException& e) {
-	(*_log) << ERROR << "DB Exception: " << e.what() << std::endl;
     }
 }
 
 
 void BackupManagerDB::update(const File& file)
 {
-    try {
-	assert(exists(file));
-	_stmt->execute("UPDATE " + _file_table + " SET "
-		       " FileSize=" + std::to_string(file.size) + ", "
-		       "FileModified=" + std::to_string(file.modified) + ", "
-		       "CRC32=" + std::to_string(file.crc) + ", "
-		       "LastChecked=" + std::to_string(file.checked) + " "
-		       "WHERE Path=" + "\"" + file.path + "\"" + " AND FileName=" + "\"" +
-		       file.name + "\";");
-    }  catch (sql::SQLException& e) {
-	(*_log) << ERROR << "DB Exception: " << e.what() << std::endl;
-    }
+    assert(exists(file));
+    _backend->update_file(file);
+    invalidate(file.path);
 }
-
@@ -8,6 +8,11 @@
  *
  * 10/05/2014 - Initial open source release
  * 11/26/2015 - Improvements to queries
+ * 10/19/2026 - Pooled, per-thread connections
+ * 10/19/2026 - Pluggable storage backends
+ * 10/19/2026 - Directory ID and directory contents caches
+ * 10/19/2026 - Bloom filter in front of file lookups
+ * 10/19/2026 - caches cleared by set_db, listings invalidated after writes
  *
  */
 
@@ -15,20 +20,26 @@
 #define __BACKUPMANAGER_DB__
 
 #include <string>
-
-// MySQL CPP Connector Library Includes
-#include <cppconn/driver.h>
-#include <cppconn/exception.h>
-#include <cppconn/statement.h>
+#include <mutex>
 
 #include "logger.hpp"
 #include "file.hpp"
+#include "db_backend.hpp"
+#include "lru_cache.hpp"
+#include "bloom.hpp"
 
 
 class BackupManagerDB {
 
 public:
-    BackupManagerDB(const std::string&, const std::string&, const std::string&, Logger*);
+#ifndef NO_MYSQL
+    BackupManagerDB(const std::string&, const std::string&, const std::string&, Logger*,
+		    const uint32_t pool_size=4);
+#endif
+    // takes ownership of the backend
+    BackupManagerDB(DBBackend*, Logger*);
+    BackupManagerDB(const BackupManagerDB&) = delete;
+    BackupManagerDB &operator=(const BackupManagerDB&) = delete;
     ~BackupManagerDB();
     
     Directory get(const Directory&);
@@ -41,20 +52,35 @@ public:
     void set_db(const std::string&, const std::string&, const std::string&);
     void init_tables();
     void update(const File&);
+    void thread_end();
+    void set_cache_size(const size_t, const size_t);
+    void enable_bloom(const double, const uint64_t);
      
 private:
     uint32_t get_dir_id(const std::string&);
+    bool lookup_dir_id(const std::string&, uint32_t&);
+    void invalidate(const std::string&);
     
     Logger *_log;
-    sql::Driver *_driver;
-    sql::Connection *_conn;
-    sql::Statement *_stmt;
-    sql::ResultSet *_res;
-
-    std::string _db_name;
-    std::string _dir_table;
-    std::string _file_table;
-    
+    DBBackend *_backend;
+
+    // both caches are keyed by the hash of the directory path. Entries
+    // keep the full path so a hash collision is treated as a miss
+    typedef std::pair<std::string, uint32_t> dir_id_entry;
+    LRUCache<size_t, dir_id_entry> _dir_ids;
+    LRUCache<size_t, Directory> _dirs;
+    std::hash<std::string> _hash;
+    // bumped by every write, so a listing read while one was going on
+    // isn't cached
+    std::mutex _dirs_lock;
+    uint64_t _dirs_gen;
+
+    // every file in the DB has been added to the filter, so a
+    // negative answer from it is definite
+    BloomFilter *_bloom;
+    // how the filter was set up, so it can be loaded again for a new DB
+    double _bloom_fp;
+    uint64_t _bloom_bytes;
 };
 
 #endif
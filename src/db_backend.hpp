@@ -0,0 +1,59 @@
+/* Backup Manager DB Storage Backend Interface
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ * 10/19/2026 - Whole table scans of the file records
+ *
+ */
+
+#ifndef __BACKUPMANAGER_DB_BACKEND__
+#define __BACKUPMANAGER_DB_BACKEND__
+
+#include <string>
+#include <unordered_map>
+#include <functional>
+
+#include "file.hpp"
+
+
+/* The primitive operations a metadata store has to provide. BackupManagerDB
+ * builds its public interface on top of these. Implementations must be safe
+ * to call from multiple threads at once; errors are logged, not thrown.
+ */
+class DBBackend {
+public:
+    virtual ~DBBackend() {}
+
+    virtual void set_db(const std::string&, const std::string&, const std::string&) = 0;
+    virtual void init_tables() = 0;
+    virtual void drop_tables() = 0;
+    virtual void drop_db() = 0;
+
+    // returns false if the directory is not in the DB
+    virtual bool dir_id(const std::string& path, uint32_t& id) = 0;
+    virtual void insert_dir(const Directory&) = 0;
+    virtual void get_files(const uint32_t id, std::unordered_map<std::string, File>&) = 0;
+    
+    virtual bool file_exists(const File&) = 0;
+    virtual void insert_file(const File&, const uint32_t dir_id) = 0;
+    virtual void update_file(const File&) = 0;
+
+    // visit the (path, name) of every file record
+    typedef std::function<void(const std::string&, const std::string&)> file_visitor;
+    virtual uint64_t file_count() = 0;
+    virtual void scan_files(const file_visitor&) = 0;
+
+    // group writes made by the calling thread
+    virtual void begin() = 0;
+    virtual void commit() = 0;
+
+    // release any per-thread resources held for the calling thread
+    virtual void thread_end() = 0;
+};
+
+#endif
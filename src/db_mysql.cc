@@ -0,0 +1,358 @@
+/* Backup Manager MySQL Storage Backend
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/05/2014 - Initial open source release (as part of db.cc)
+ * 11/26/2015 - Improvements to queries
+ * 10/19/2026 - Pooled, per-thread connections
+ * 10/19/2026 - Split out of BackupManagerDB
+ * 10/19/2026 - Whole table scans of the file records
+ * 10/19/2026 - Stored size and CRC of compressed copies
+ *
+ */
+
+#include "db_mysql.hpp"
+
+
+MySQLBackend::MySQLBackend(const std::string& ip, const std::string& user, 
+			   const std::string& password, Logger* l,
+			   const uint32_t pool_size) : _log(l),
+						       _driver(NULL),
+						       _pool(NULL),
+						       _schema_ready(false)
+{
+    std::string new_ip = "tcp://" + ip + ":3306";
+    try {
+	_driver = get_driver_instance();
+	_pool = new DBConnectionPool(_driver, new_ip, user, password, pool_size);
+	// connect the creating thread up front so a bad
+	// host or bad credentials are reported immediately
+	conn();
+    }  catch (sql::SQLException& e) {
+	LOG(*_log, ERROR) << "DB Exception: " << e.what() << std::endl;
+    }
+
+    _db_name = "backup_maanger";
+    _dir_table = "Directories";
+    _file_table = "Files";
+}
+
+
+MySQLBackend::~MySQLBackend()
+{
+    {
+	std::lock_guard<std::mutex> l(_conn_lock);
+	for (auto it = _conns.begin(); it != _conns.end(); ++it) {
+	    _pool->release(it->second);
+	}
+	_conns.clear();
+    }
+
+    delete _pool;
+    if (_driver) {
+	_driver->threadEnd();
+    }
+}
+
+
+/* Returns the connection owned by the calling thread, checking one out
+ * of the pool on first use. Connections are not shared between threads,
+ * so once this returns no further locking is needed to use it.
+ */
+db_conn_st* MySQLBackend::conn()
+{
+    std::thread::id id = std::this_thread::get_id();
+    db_conn_st *ret = NULL;
+    
+    {
+	std::lock_guard<std::mutex> l(_conn_lock);
+	auto it = _conns.find(id);
+	if (it != _conns.end()) {
+	    ret = it->second;
+	}
+    }
+    
+    if (!ret) {
+	_driver->threadInit();
+	ret = _pool->acquire();
+	
+	std::lock_guard<std::mutex> l(_conn_lock);
+	_conns.insert(std::make_pair(id, ret));
+    }
+
+    if (_schema_ready && ret->schema != _db_name) {
+	ret->stmt->execute("USE " + _db_name);
+	ret->schema = _db_name;
+    }
+    
+    return (ret);
+}
+
+
+/* Must be called by any thread other than the one that created this object
+ * before it exits. Returns the thread's connection to the pool.
+ */
+void MySQLBackend::thread_end()
+{
+    db_conn_st *c = NULL;
+    
+    {
+	std::lock_guard<std::mutex> l(_conn_lock);
+	auto it = _conns.find(std::this_thread::get_id());
+	if (it != _conns.end()) {
+	    c = it->second;
+	    _conns.erase(it);
+	}
+    }
+
+    if (c) {
+	_pool->release(c);
+	_driver->threadEnd();
+    }
+}
+
+
+void MySQLBackend::set_db(const std::string& db, const std::string& dir, const std::string& file)
+{
+    _db_name = db;
+    _dir_table = dir;
+    _file_table = file;
+}
+
+
+void MySQLBackend::init_tables()
+{
+    try{
+	sql::Statement *stmt = conn()->stmt;
+	
+	stmt->execute("CREATE DATABASE IF NOT EXISTS " + _db_name);
+	_schema_ready = true;
+	// switches this thread's connection to the new database
+	stmt = conn()->stmt;
+	
+	stmt->execute("CREATE TABLE IF NOT EXISTS " + _dir_table + " "
+		      "(DirID INT AUTO_INCREMENT,"
+		      "Path VARCHAR(4096),"
+		      "Name VARCHAR(255),"
+		      "PRIMARY KEY(DirID)) ENGINE=InnoDB");
+	
+	stmt->execute("CREATE TABLE IF NOT EXISTS " + _file_table + " "
+		      "(FileID INT AUTO_INCREMENT,"
+		      "Dir INT,"
+		      "Path VARCHAR(4096),"
+		      "FileName VARCHAR(255),"
+		      "FileModified BIGINT,"
+		      "FileSize BIGINT,"
+		      "CRC32 BIGINT,"
+		      "LastChecked BIGINT,"
+		      "StoredSize BIGINT DEFAULT 0,"
+		      "StoredCRC32 BIGINT DEFAULT 0,"
+		      "PRIMARY KEY(FileID),"
+		      "FOREIGN KEY(Dir) REFERENCES " + _dir_table + "(DirID)"
+		      "ON DELETE CASCADE) ENGINE=InnoDB");
+
+	// tables made before copies could be compressed get the new columns
+	sql::ResultSet *res = stmt->executeQuery("SHOW COLUMNS FROM " + _file_table +
+						 " LIKE 'StoredSize'");
+	bool found = res->next();
+	delete res;
+	if (!found) {
+	    stmt->execute("ALTER TABLE " + _file_table + " ADD COLUMN StoredSize BIGINT DEFAULT 0, "
+			  "ADD COLUMN StoredCRC32 BIGINT DEFAULT 0");
+	}
+	
+	conn()->conn->commit();
+    } catch (sql::SQLException& e) {
+	LOG(*_log, ERROR) << "Exception: " << e.what() << std::endl;
+    }
+}
+
+
+void MySQLBackend::drop_tables()
+{
+    db_conn_st *c = conn();
+    
+    c->stmt->execute("DROP TABLE IF EXISTS " + _file_table + ";");
+    c->stmt->execute("DROP TABLE IF EXISTS " + _dir_table + ";");
+    c->conn->commit();		   
+}
+
+
+void MySQLBackend::drop_db()
+{
+    db_conn_st *c = conn();
+    
+    c->stmt->execute("DROP DATABASE IF EXISTS " + _db_name + ";");
+    c->conn->commit();
+}
+
+
+bool MySQLBackend::dir_id(const std::string& path, uint32_t& id)
+{
+    bool ret = false;
+    sql::ResultSet *res = NULL;
+    
+    try {
+	res = conn()->stmt->executeQuery("SELECT DirID FROM " + _dir_table + " WHERE "
+					 "Path = \"" + path + "\";");
+	if (res->next()) {
+	    id = res->getInt(1);
+	    ret = true;
+	}
+    }  catch (sql::SQLException& e) {
+	LOG(*_log, ERROR) << "DB Exception: " << e.what() << std::endl;
+    }	
+
+    delete res;
+    return (ret);
+}
+
+
+void MySQLBackend::insert_dir(const Directory& dir)
+{
+    try {
+	conn()->stmt->execute("INSERT INTO " + _dir_table + " (Path, Name) VALUES (\"" +
+			      dir.path + "\", \"" + dir.name + "\");");
+    }  catch (sql::SQLException& e) {
+	LOG(*_log, ERROR) << "DB Exception: " << e.what() << std::endl;
+    }
+}
+
+
+void MySQLBackend::get_files(const uint32_t id, std::unordered_map<std::string, File>& files)
+{
+    sql::ResultSet *res = NULL;
+    
+    try {
+	res = conn()->stmt->executeQuery("SELECT * FROM " + _file_table + " WHERE Dir = "
+					 + std::to_string(id) + ";");
+	
+	while(res->next()) {
+	    File f;
+	    f.path = res->getString(3);
+	    f.name = res->getString(4);
+	    f.modified = res->getInt(5);
+	    f.size = res->getInt(6);
+	    f.crc = res->getInt(7);
+	    f.checked = res->getInt(8);
+	    f.stored = res->getUInt64(9);
+	    f.stored_crc = res->getUInt64(10);
+	    
+	    files.insert(std::make_pair(f.name, f));
+	}
+    }  catch (sql::SQLException& e) {
+	LOG(*_log, ERROR) << "DB Exception: " << e.what() << std::endl;
+    }
+    
+    delete res;
+}
+
+
+bool MySQLBackend::file_exists(const File& file)
+{
+    bool ret = false;
+    sql::ResultSet *res = NULL;
+    
+    try {
+	res = conn()->stmt->executeQuery("SELECT FileID FROM " + _file_table + " WHERE "
+					 "Path = \"" + file.path + "\" AND FileName = \""
+					 + file.name + "\";");
+	ret = res->next();
+    }  catch (sql::SQLException& e) {
+	LOG(*_log, ERROR) << "DB Exception: " << e.what() << std::endl;
+    }
+    
+    delete res;
+    return (ret);
+}
+
+
+void MySQLBackend::insert_file(const File& file, const uint32_t id)
+{
+    try {
+	conn()->stmt->execute("INSERT INTO " + _file_table + " (Dir, Path, FileName, FileSize, "
+			      "FileModified, CRC32, LastChecked, StoredSize, StoredCRC32)"
+			      " VALUES (" + std::to_string(id) + ", \"" + file.path + "\", \""
+			      + file.name + "\", " + std::to_string(file.size) + ", " +
+			      std::to_string(file.modified) + ", " + std::to_string(file.crc) +
+			      ", " + std::to_string(file.checked) + ", " +
+			      std::to_string(file.stored) + ", " +
+			      std::to_string(file.stored_crc) + ");"); 
+    }  catch (sql::SQLException& e) {
+	LOG(*_log, ERROR) << "DB Exception: " << e.what() << std::endl;
+    }
+}
+
+
+void MySQLBackend::update_file(const File& file)
+{
+    try {
+	conn()->stmt->execute("UPDATE " + _file_table + " SET "
+			      " FileSize=" + std::to_string(file.size) + ", "
+			      "FileModified=" + std::to_string(file.modified) + ", "
+			      "CRC32=" + std::to_string(file.crc) + ", "
+			      "LastChecked=" + std::to_string(file.checked) + ", "
+			      "StoredSize=" + std::to_string(file.stored) + ", "
+			      "StoredCRC32=" + std::to_string(file.stored_crc) + " "
+			      "WHERE Path=" + "\"" + file.path + "\"" + " AND FileName=" + "\"" +
+			      file.name + "\";");
+    }  catch (sql::SQLException& e) {
+	LOG(*_log, ERROR) << "DB Exception: " << e.what() << std::endl;
+    }
+}
+
+
+uint64_t MySQLBackend::file_count()
+{
+    uint64_t ret = 0;
+    sql::ResultSet *res = NULL;
+    
+    try {
+	res = conn()->stmt->executeQuery("SELECT COUNT(*) FROM " + _file_table + ";");
+	if (res->next()) {
+	    ret = res->getUInt64(1);
+	}
+    }  catch (sql::SQLException& e) {
+	LOG(*_log, ERROR) << "DB Exception: " << e.what() << std::endl;
+    }
+    
+    delete res;
+    return (ret);
+}
+
+
+void MySQLBackend::scan_files(const file_visitor& visit)
+{
+    sql::ResultSet *res = NULL;
+    
+    try {
+	res = conn()->stmt->executeQuery("SELECT Path, FileName FROM " + _file_table + ";");
+	while (res->next()) {
+	    visit(res->getString(1), res->getString(2));
+	}
+    }  catch (sql::SQLException& e) {
+	LOG(*_log, ERROR) << "DB Exception: " << e.what() << std::endl;
+    }
+    
+    delete res;
+}
+
+
+void MySQLBackend::begin()
+{
+    // connections run in autocommit mode
+}
+
+
+void MySQLBackend::commit()
+{
+    try {
+	conn()->conn->commit();
+    }  catch (sql::SQLException& e) {
+	LOG(*_log, ERROR) << "DB Exception: " << e.what() << std::endl;
+    }
+}
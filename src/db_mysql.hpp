@@ -0,0 +1,73 @@
+/* Backup Manager MySQL Storage Backend
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/05/2014 - Initial open source release (as part of db.cc)
+ * 11/26/2015 - Improvements to queries
+ * 10/19/2026 - Pooled, per-thread connections
+ * 10/19/2026 - Split out of BackupManagerDB
+ * 10/19/2026 - Whole table scans of the file records
+ *
+ */
+
+#ifndef __BACKUPMANAGER_DB_MYSQL__
+#define __BACKUPMANAGER_DB_MYSQL__
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+
+#include "db_backend.hpp"
+#include "db_pool.hpp"
+#include "logger.hpp"
+
+
+class MySQLBackend : public DBBackend {
+public:
+    MySQLBackend(const std::string&, const std::string&, const std::string&, Logger*,
+		 const uint32_t pool_size=4);
+    MySQLBackend(const MySQLBackend&) = delete;
+    MySQLBackend &operator=(const MySQLBackend&) = delete;
+    ~MySQLBackend();
+
+    void set_db(const std::string&, const std::string&, const std::string&);
+    void init_tables();
+    void drop_tables();
+    void drop_db();
+    bool dir_id(const std::string&, uint32_t&);
+    void insert_dir(const Directory&);
+    void get_files(const uint32_t, std::unordered_map<std::string, File>&);
+    bool file_exists(const File&);
+    void insert_file(const File&, const uint32_t);
+    void update_file(const File&);
+    uint64_t file_count();
+    void scan_files(const file_visitor&);
+    void begin();
+    void commit();
+    void thread_end();
+    
+private:
+    db_conn_st* conn();
+    
+    Logger *_log;
+    sql::Driver *_driver;
+    DBConnectionPool *_pool;
+
+    // each thread is handed its own connection from the pool
+    // the first time it touches the DB
+    std::mutex _conn_lock;
+    std::unordered_map<std::thread::id, db_conn_st*> _conns;
+    std::atomic<bool> _schema_ready;
+
+    std::string _db_name;
+    std::string _dir_table;
+    std::string _file_table;
+};
+
+#endif
@@ -0,0 +1,90 @@
+/* Backup Manager DB Connection Pool
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#include <cassert>
+
+#include "db_pool.hpp"
+
+
+DBConnectionPool::DBConnectionPool(sql::Driver *driver, const std::string& url,
+				   const std::string& user, const std::string& pass,
+				   const uint32_t size) : _driver(driver),
+							  _url(url),
+							  _user(user),
+							  _pass(pass),
+							  _open(0),
+							  _size(size)
+{
+    assert(_size > 0);
+}
+
+
+DBConnectionPool::~DBConnectionPool()
+{
+    std::lock_guard<std::mutex> l(_lock);
+    
+    for (uint32_t i = 0; i < _free.size(); ++i) {
+	delete _free[i]->stmt;
+	delete _free[i]->conn;
+	delete _free[i];
+    }
+    _free.clear();
+}
+
+
+/* Returns an idle connection, opening a new one if the pool has not
+ * reached its size limit yet. If all connections are checked out, the caller
+ * blocks until one is released. Throws sql::SQLException if a new connection
+ * cannot be established.
+ */
+db_conn_st* DBConnectionPool::acquire()
+{
+    std::unique_lock<std::mutex> l(_lock);
+
+    _available.wait(l, [this]{ return (!_free.empty() || _open < _size); });
+
+    if (!_free.empty()) {
+	db_conn_st *ret = _free.back();
+	_free.pop_back();
+	return (ret);
+    }
+
+    // reserve the slot, then connect without holding the lock
+    ++_open;
+    l.unlock();
+
+    db_conn_st *ret = new db_conn_st;
+    try {
+	ret->conn = _driver->connect(_url.c_str(), _user.c_str(), _pass.c_str());
+	ret->stmt = ret->conn->createStatement();
+    } catch (sql::SQLException& e) {
+	delete ret;
+	l.lock();
+	--_open;
+	_available.notify_one();
+	throw;
+    }
+
+    return (ret);
+}
+
+
+void DBConnectionPool::release(db_conn_st *c)
+{
+    if (!c) {
+	return;
+    }
+    
+    std::lock_guard<std::mutex> l(_lock);
+    _free.push_back(c);
+    _available.notify_one();
+}
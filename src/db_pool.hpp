@@ -0,0 +1,60 @@
+/* Backup Manager DB Connection Pool
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#ifndef __BACKUPMANAGER_DB_POOL__
+#define __BACKUPMANAGER_DB_POOL__
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+// MySQL CPP Connector Library Includes
+#include <cppconn/driver.h>
+#include <cppconn/exception.h>
+#include <cppconn/statement.h>
+
+
+// a connection and the statement object that is used with it.
+// a db_conn_st is only ever used by one thread at a time
+struct db_conn_st {
+    sql::Connection *conn;
+    sql::Statement  *stmt;
+    std::string      schema;
+};
+
+
+class DBConnectionPool {
+public:
+    DBConnectionPool(sql::Driver*, const std::string&, const std::string&, const std::string&,
+		     const uint32_t);
+    DBConnectionPool(const DBConnectionPool&) = delete;
+    DBConnectionPool &operator=(const DBConnectionPool&) = delete;
+    ~DBConnectionPool();
+
+    db_conn_st* acquire();
+    void release(db_conn_st*);
+    
+private:
+    sql::Driver *_driver;
+    std::string _url;
+    std::string _user;
+    std::string _pass;
+    
+    std::mutex _lock;
+    std::condition_variable _available;
+    std::vector<db_conn_st*> _free;
+    uint32_t _open;
+    uint32_t _size;
+};
+
+#endif
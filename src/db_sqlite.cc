@@ -0,0 +1,445 @@
+/* Backup Manager SQLite Storage Backend
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ * 10/19/2026 - Whole table scans of the file records
+ * 10/19/2026 - Stored size and CRC of compressed copies
+ *
+ */
+
+#include <cstdio>
+
+#include "db_sqlite.hpp"
+
+
+SQLiteBackend::SQLiteBackend(const std::string& path, Logger *l) : _log(l),
+								   _path(path),
+								   _dir_table("Directories"),
+								   _file_table("Files")
+{
+    // open the creating thread's handle now so that a bad path is
+    // reported immediately
+    conn();
+}
+
+
+SQLiteBackend::~SQLiteBackend()
+{
+    std::lock_guard<std::mutex> l(_conn_lock);
+    
+    for (auto it = _conns.begin(); it != _conns.end(); ++it) {
+	close(it->second);
+    }
+    _conns.clear();
+}
+
+
+sqlite_conn_st* SQLiteBackend::conn()
+{
+    std::thread::id id = std::this_thread::get_id();
+    
+    {
+	std::lock_guard<std::mutex> l(_conn_lock);
+	auto it = _conns.find(id);
+	if (it != _conns.end()) {
+	    return (it->second);
+	}
+    }
+
+    sqlite_conn_st *c = new sqlite_conn_st;
+    c->txn_depth = 0;
+    
+    // each handle is only ever used by one thread, so
+    // SQLite's own locking can be turned off
+    if (sqlite3_open_v2(_path.c_str(), &c->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
+			SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+	error(c);
+    }
+    
+    sqlite3_busy_timeout(c->db, 10000);
+    exec(c, "PRAGMA journal_mode=WAL;");
+    exec(c, "PRAGMA synchronous=NORMAL;");
+    exec(c, "PRAGMA foreign_keys=ON;");
+    
+    std::lock_guard<std::mutex> l(_conn_lock);
+    _conns.insert(std::make_pair(id, c));
+    return (c);
+}
+
+
+void SQLiteBackend::close(sqlite_conn_st *c)
+{
+    for (auto it = c->stmts.begin(); it != c->stmts.end(); ++it) {
+	sqlite3_finalize(it->second);
+    }
+    sqlite3_close(c->db);
+    delete c;
+}
+
+
+void SQLiteBackend::thread_end()
+{
+    sqlite_conn_st *c = NULL;
+    
+    {
+	std::lock_guard<std::mutex> l(_conn_lock);
+	auto it = _conns.find(std::this_thread::get_id());
+	if (it != _conns.end()) {
+	    c = it->second;
+	    _conns.erase(it);
+	}
+    }
+
+    if (c) {
+	close(c);
+    }
+}
+
+
+void SQLiteBackend::error(sqlite_conn_st *c)
+{
+    LOG(*_log, ERROR) << "DB Exception: " << sqlite3_errmsg(c->db) << std::endl;
+}
+
+
+bool SQLiteBackend::exec(sqlite_conn_st *c, const std::string& sql)
+{
+    char *err = NULL;
+    
+    if (sqlite3_exec(c->db, sql.c_str(), NULL, NULL, &err) != SQLITE_OK) {
+	LOG(*_log, ERROR) << "DB Exception: " << (err ? err : "unknown error") << std::endl;
+	sqlite3_free(err);
+	return (false);
+    }
+    
+    return (true);
+}
+
+
+/* Statements are compiled once per handle and reused. The returned
+ * statement has been reset and has no bindings.
+ */
+sqlite3_stmt* SQLiteBackend::prepare(sqlite_conn_st *c, const std::string& sql)
+{
+    auto it = c->stmts.find(sql);
+    
+    if (it != c->stmts.end()) {
+	sqlite3_reset(it->second);
+	sqlite3_clear_bindings(it->second);
+	return (it->second);
+    }
+
+    sqlite3_stmt *s = NULL;
+    if (sqlite3_prepare_v2(c->db, sql.c_str(), -1, &s, NULL) != SQLITE_OK) {
+	error(c);
+	return (NULL);
+    }
+    
+    c->stmts.insert(std::make_pair(sql, s));
+    return (s);
+}
+
+
+void SQLiteBackend::set_db(const std::string& db, const std::string& dir, const std::string& file)
+{
+    // the database is the file given to the constructor
+    (void)db;
+    _dir_table = dir;
+    _file_table = file;
+}
+
+
+void SQLiteBackend::init_tables()
+{
+    sqlite_conn_st *c = conn();
+    
+    exec(c, "CREATE TABLE IF NOT EXISTS " + _dir_table + " "
+	 "(DirID INTEGER PRIMARY KEY AUTOINCREMENT,"
+	 "Path TEXT,"
+	 "Name TEXT);");
+    
+    exec(c, "CREATE TABLE IF NOT EXISTS " + _file_table + " "
+	 "(FileID INTEGER PRIMARY KEY AUTOINCREMENT,"
+	 "Dir INTEGER REFERENCES " + _dir_table + "(DirID) ON DELETE CASCADE,"
+	 "Path TEXT,"
+	 "FileName TEXT,"
+	 "FileModified INTEGER,"
+	 "FileSize INTEGER,"
+	 "CRC32 INTEGER,"
+	 "LastChecked INTEGER,"
+	 "StoredSize INTEGER DEFAULT 0,"
+	 "StoredCRC32 INTEGER DEFAULT 0);");
+
+    // tables made before copies could be compressed get the new columns
+    sqlite3_stmt *s = NULL;
+    if (sqlite3_prepare_v2(c->db, ("SELECT StoredSize FROM " + _file_table + ";").c_str(), -1,
+			   &s, NULL) == SQLITE_OK) {
+	sqlite3_finalize(s);
+    } else {
+	exec(c, "ALTER TABLE " + _file_table + " ADD COLUMN StoredSize INTEGER DEFAULT 0;");
+	exec(c, "ALTER TABLE " + _file_table + " ADD COLUMN StoredCRC32 INTEGER DEFAULT 0;");
+    }
+
+    exec(c, "CREATE INDEX IF NOT EXISTS " + _dir_table + "_Path ON " + _dir_table + "(Path);");
+    exec(c, "CREATE INDEX IF NOT EXISTS " + _file_table + "_Dir ON " + _file_table + "(Dir);");
+    exec(c, "CREATE INDEX IF NOT EXISTS " + _file_table + "_PathName ON " + _file_table +
+	 "(Path, FileName);");
+}
+
+
+void SQLiteBackend::drop_tables()
+{
+    sqlite_conn_st *c = conn();
+    
+    exec(c, "DROP TABLE IF EXISTS " + _file_table + ";");
+    exec(c, "DROP TABLE IF EXISTS " + _dir_table + ";");
+}
+
+
+/* Removes the database file. No other thread may be using
+ * the backend when this is called.
+ */
+void SQLiteBackend::drop_db()
+{
+    {
+	std::lock_guard<std::mutex> l(_conn_lock);
+	for (auto it = _conns.begin(); it != _conns.end(); ++it) {
+	    close(it->second);
+	}
+	_conns.clear();
+    }
+    
+    remove(_path.c_str());
+    remove((_path + "-wal").c_str());
+    remove((_path + "-shm").c_str());
+}
+
+
+bool SQLiteBackend::dir_id(const std::string& path, uint32_t& id)
+{
+    sqlite_conn_st *c = conn();
+    sqlite3_stmt *s = prepare(c, "SELECT DirID FROM " + _dir_table + " WHERE Path = ?1;");
+    bool ret = false;
+    
+    if (!s) {
+	return (false);
+    }
+    
+    sqlite3_bind_text(s, 1, path.c_str(), path.size(), SQLITE_STATIC);
+    int rc = sqlite3_step(s);
+    if (rc == SQLITE_ROW) {
+	id = sqlite3_column_int64(s, 0);
+	ret = true;
+    } else if (rc != SQLITE_DONE) {
+	error(c);
+    }
+    
+    sqlite3_reset(s);
+    return (ret);
+}
+
+
+void SQLiteBackend::insert_dir(const Directory& dir)
+{
+    sqlite_conn_st *c = conn();
+    sqlite3_stmt *s = prepare(c, "INSERT INTO " + _dir_table + " (Path, Name) VALUES (?1, ?2);");
+
+    if (!s) {
+	return;
+    }
+    
+    sqlite3_bind_text(s, 1, dir.path.c_str(), dir.path.size(), SQLITE_STATIC);
+    sqlite3_bind_text(s, 2, dir.name.c_str(), dir.name.size(), SQLITE_STATIC);
+    if (sqlite3_step(s) != SQLITE_DONE) {
+	error(c);
+    }
+    
+    sqlite3_reset(s);
+}
+
+
+void SQLiteBackend::get_files(const uint32_t id, std::unordered_map<std::string, File>& files)
+{
+    sqlite_conn_st *c = conn();
+    sqlite3_stmt *s = prepare(c, "SELECT Path, FileName, FileModified, FileSize, CRC32, "
+			      "LastChecked, StoredSize, StoredCRC32 FROM " + _file_table +
+			      " WHERE Dir = ?1;");
+    int rc;
+    
+    if (!s) {
+	return;
+    }
+
+    sqlite3_bind_int64(s, 1, id);
+    while ((rc = sqlite3_step(s)) == SQLITE_ROW) {
+	File f;
+	f.path = (const char *)sqlite3_column_text(s, 0);
+	f.name = (const char *)sqlite3_column_text(s, 1);
+	f.modified = sqlite3_column_int64(s, 2);
+	f.size = sqlite3_column_int64(s, 3);
+	f.crc = sqlite3_column_int64(s, 4);
+	f.checked = sqlite3_column_int64(s, 5);
+	f.stored = sqlite3_column_int64(s, 6);
+	f.stored_crc = sqlite3_column_int64(s, 7);
+	
+	files.insert(std::make_pair(f.name, f));
+    }
+    
+    if (rc != SQLITE_DONE) {
+	error(c);
+    }
+    
+    sqlite3_reset(s);
+}
+
+
+bool SQLiteBackend::file_exists(const File& file)
+{
+    sqlite_conn_st *c = conn();
+    sqlite3_stmt *s = prepare(c, "SELECT FileID FROM " + _file_table + " WHERE "
+			      "Path = ?1 AND FileName = ?2;");
+    bool ret = false;
+    
+    if (!s) {
+	return (false);
+    }
+    
+    sqlite3_bind_text(s, 1, file.path.c_str(), file.path.size(), SQLITE_STATIC);
+    sqlite3_bind_text(s, 2, file.name.c_str(), file.name.size(), SQLITE_STATIC);
+    int rc = sqlite3_step(s);
+    if (rc == SQLITE_ROW) {
+	ret = true;
+    } else if (rc != SQLITE_DONE) {
+	error(c);
+    }
+    
+    sqlite3_reset(s);
+    return (ret);
+}
+
+
+void SQLiteBackend::insert_file(const File& file, const uint32_t id)
+{
+    sqlite_conn_st *c = conn();
+    sqlite3_stmt *s = prepare(c, "INSERT INTO " + _file_table + " (Dir, Path, FileName, "
+			      "FileSize, FileModified, CRC32, LastChecked, StoredSize, "
+			      "StoredCRC32) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9);");
+
+    if (!s) {
+	return;
+    }
+    
+    sqlite3_bind_int64(s, 1, id);
+    sqlite3_bind_text(s, 2, file.path.c_str(), file.path.size(), SQLITE_STATIC);
+    sqlite3_bind_text(s, 3, file.name.c_str(), file.name.size(), SQLITE_STATIC);
+    sqlite3_bind_int64(s, 4, file.size);
+    sqlite3_bind_int64(s, 5, file.modified);
+    sqlite3_bind_int64(s, 6, file.crc);
+    sqlite3_bind_int64(s, 7, file.checked);
+    sqlite3_bind_int64(s, 8, file.stored);
+    sqlite3_bind_int64(s, 9, file.stored_crc);
+    if (sqlite3_step(s) != SQLITE_DONE) {
+	error(c);
+    }
+    
+    sqlite3_reset(s);
+}
+
+
+void SQLiteBackend::update_file(const File& file)
+{
+    sqlite_conn_st *c = conn();
+    sqlite3_stmt *s = prepare(c, "UPDATE " + _file_table + " SET FileSize = ?1, "
+			      "FileModified = ?2, CRC32 = ?3, LastChecked = ?4, "
+			      "StoredSize = ?5, StoredCRC32 = ?6 "
+			      "WHERE Path = ?7 AND FileName = ?8;");
+
+    if (!s) {
+	return;
+    }
+    
+    sqlite3_bind_int64(s, 1, file.size);
+    sqlite3_bind_int64(s, 2, file.modified);
+    sqlite3_bind_int64(s, 3, file.crc);
+    sqlite3_bind_int64(s, 4, file.checked);
+    sqlite3_bind_int64(s, 5, file.stored);
+    sqlite3_bind_int64(s, 6, file.stored_crc);
+    sqlite3_bind_text(s, 7, file.path.c_str(), file.path.size(), SQLITE_STATIC);
+    sqlite3_bind_text(s, 8, file.name.c_str(), file.name.size(), SQLITE_STATIC);
+    if (sqlite3_step(s) != SQLITE_DONE) {
+	error(c);
+    }
+    
+    sqlite3_reset(s);
+}
+
+
+uint64_t SQLiteBackend::file_count()
+{
+    sqlite_conn_st *c = conn();
+    sqlite3_stmt *s = prepare(c, "SELECT COUNT(*) FROM " + _file_table + ";");
+    uint64_t ret = 0;
+    
+    if (!s) {
+	return (0);
+    }
+
+    if (sqlite3_step(s) == SQLITE_ROW) {
+	ret = sqlite3_column_int64(s, 0);
+    } else {
+	error(c);
+    }
+    
+    sqlite3_reset(s);
+    return (ret);
+}
+
+
+void SQLiteBackend::scan_files(const file_visitor& visit)
+{
+    sqlite_conn_st *c = conn();
+    sqlite3_stmt *s = prepare(c, "SELECT Path, FileName FROM " + _file_table + ";");
+    int rc;
+    
+    if (!s) {
+	return;
+    }
+
+    while ((rc = sqlite3_step(s)) == SQLITE_ROW) {
+	visit((const char *)sqlite3_column_text(s, 0), (const char *)sqlite3_column_text(s, 1));
+    }
+    
+    if (rc != SQLITE_DONE) {
+	error(c);
+    }
+    
+    sqlite3_reset(s);
+}
+
+
+/* Transactions nest; only the outermost begin/commit pair
+ * reaches SQLite.
+ */
+void SQLiteBackend::begin()
+{
+    sqlite_conn_st *c = conn();
+
+    if (c->txn_depth++ == 0) {
+	exec(c, "BEGIN IMMEDIATE;");
+    }
+}
+
+
+void SQLiteBackend::commit()
+{
+    sqlite_conn_st *c = conn();
+
+    if (c->txn_depth && --c->txn_depth == 0) {
+	exec(c, "COMMIT;");
+    }
+}
@@ -0,0 +1,80 @@
+/* Backup Manager SQLite Storage Backend
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ * 10/19/2026 - Whole table scans of the file records
+ *
+ */
+
+#ifndef __BACKUPMANAGER_DB_SQLITE__
+#define __BACKUPMANAGER_DB_SQLITE__
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <unordered_map>
+
+#include <sqlite3.h>
+
+#include "db_backend.hpp"
+#include "logger.hpp"
+
+
+// a per-thread database handle and its cache of prepared statements
+struct sqlite_conn_st {
+    sqlite3 *db;
+    uint32_t txn_depth;
+    std::unordered_map<std::string, sqlite3_stmt*> stmts;
+};
+
+
+/* Embedded, in-process metadata store. The database lives in a single file
+ * and is opened in WAL mode so readers never block the writer. Like the MySQL
+ * backend, each thread uses its own handle.
+ */
+class SQLiteBackend : public DBBackend {
+public:
+    SQLiteBackend(const std::string&, Logger*);
+    SQLiteBackend(const SQLiteBackend&) = delete;
+    SQLiteBackend &operator=(const SQLiteBackend&) = delete;
+    ~SQLiteBackend();
+
+    void set_db(const std::string&, const std::string&, const std::string&);
+    void init_tables();
+    void drop_tables();
+    void drop_db();
+    bool dir_id(const std::string&, uint32_t&);
+    void insert_dir(const Directory&);
+    void get_files(const uint32_t, std::unordered_map<std::string, File>&);
+    bool file_exists(const File&);
+    void insert_file(const File&, const uint32_t);
+    void update_file(const File&);
+    uint64_t file_count();
+    void scan_files(const file_visitor&);
+    void begin();
+    void commit();
+    void thread_end();
+    
+private:
+    sqlite_conn_st* conn();
+    void close(sqlite_conn_st*);
+    sqlite3_stmt* prepare(sqlite_conn_st*, const std::string&);
+    bool exec(sqlite_conn_st*, const std::string&);
+    void error(sqlite_conn_st*);
+    
+    Logger *_log;
+    std::string _path;
+    
+    std::mutex _conn_lock;
+    std::unordered_map<std::thread::id, sqlite_conn_st*> _conns;
+
+    std::string _dir_table;
+    std::string _file_table;
+};
+
+#endif
@@ -10,6 +10,9 @@
  * 09/27/2014 - Directory support added
  * 09/28/2014 - populate directory name
  * 11/26/2015 - bugfix: files have consistent paths now
+ * 10/19/2026 - mount accessor
+ * 10/19/2026 - optional Throttle for file reads
+ * 10/19/2026 - traversal without CRCs
  *
  */
 
@@ -25,11 +28,21 @@
 
 
 
-Disk::Disk(const std::string& mount, Logger *log) : _mount(mount), _log(log) 
+Disk::Disk(const std::string& mount, Logger *log, Throttle *throttle, const bool crc) :
+    _mount(mount),
+    _log(log),
+    _throttle(throttle),
+    _crc(crc)
 {
     _to_process.push_back(mount);
 }
 
+const std::string& Disk::mount() const
+{
+    return (_mount);
+}
+
+
 Directory Disk::next_directory()
 {
     DIR *dir;
@@ -47,15 +60,16 @@ Directory Disk::next_directory()
 	path = _to_process.back();
 	dir = opendir(path.c_str());
 	_to_process.pop_back();
-	(*_log) << DEBUG << "Processing " << path << std::endl;
+	LOG(*_log, DEBUG) << "Processing " << path << std::endl;
 	
 	if (!dir) {
-	    (*_log) << ERROR << "Cannot open " << path << std::endl;
+	    LOG(*_log, ERROR) << "Cannot open " << path << std::endl;
 	} else {
 	    
 	    while ((entry = readdir(dir)) != NULL) {
 		if (entry->d_type == DT_REG) {
-		    files.insert(std::make_pair(entry->d_name, File(path, entry->d_name)));
+		    files.insert(std::make_pair(entry->d_name,
+						File(path, entry->d_name, _throttle, _crc)));
 		} else if ((entry->d_type == DT_DIR) && 
 			   (strcmp(entry->d_name, ".") != 0) &&
 			   (strcmp(entry->d_name, "..") != 0)) {
@@ -8,6 +8,9 @@
  *
  * 09/26/2014 - Initial open source release
  * 09/27/2014 - Directory support added
+ * 10/19/2026 - mount accessor
+ * 10/19/2026 - optional Throttle for file reads
+ * 10/19/2026 - traversal without CRCs
  *
  */
 
@@ -24,16 +27,21 @@
 
 #include "file.hpp"
 #include "logger.hpp"
+#include "throttle.hpp"
 
 
 class Disk {
 public:
-    Disk(const std::string&, Logger*);
+    // crc false leaves the CRC of every file 0
+    Disk(const std::string&, Logger*, Throttle* = NULL, const bool crc = true);
     Directory next_directory();
+    const std::string& mount() const;
 
 private:
     std::string _mount;
     Logger* _log;
+    Throttle* _throttle;
+    bool _crc;
     std::vector<std::string> _to_process;
 };
 
@@ -0,0 +1,293 @@
+/* Backup Manager Event Log
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "event_log.hpp"
+
+
+// records are buffered until there is this much to write
+#define EVENT_BUFFER_SIZE (256 * 1024)
+
+
+Event::Event() : type(EVENT_CHECKED), time(0) {}
+
+
+Event::Event(const event_type_e t, const File& f) : type(t), time(std::time(NULL)), file(f) {}
+
+
+Event::Event(const event_type_e t, const File& f, const File& o) : type(t),
+								   time(std::time(NULL)),
+								   file(f),
+								   old(o) {}
+
+
+const char* event_type_str(const event_type_e type)
+{
+    switch (type) {
+    case EVENT_MISMATCH:
+	return ("mismatch");
+    case EVENT_MISSING:
+	return ("missing");
+    case EVENT_NEW:
+	return ("new");
+    case EVENT_CHECKED:
+	return ("checked");
+    default:
+	return ("unknown");
+    }
+}
+
+
+event_type_e event_type_from_str(const std::string& s)
+{
+    for (uint8_t t = EVENT_MISMATCH; t <= EVENT_CHECKED; ++t) {
+	if (s.compare(event_type_str((event_type_e)t)) == 0) {
+	    return ((event_type_e)t);
+	}
+    }
+    
+    return ((event_type_e)0);
+}
+
+
+/* The length of the log at path up to the end of its last whole
+ * record, or -1 if it isn't an event log. size is its length on disk.
+ */
+static off_t complete_length(const std::string& path, const off_t size)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    event_header_st h;
+    event_record_st r;
+    off_t end = sizeof(h);
+
+    if (!fp) {
+	return (-1);
+    }
+    if (fread(&h, sizeof(h), 1, fp) != 1 ||
+	memcmp(h.magic, EVENT_MAGIC, sizeof(h.magic)) != 0 ||
+	h.version != EVENT_VERSION) {
+	fclose(fp);
+	return (-1);
+    }
+
+    // only the fixed part of each record is read, the rest is skipped
+    while (fread(&r, sizeof(r), 1, fp) == 1 &&
+	   r.len == sizeof(r) + r.path_len + r.name_len &&
+	   end + (off_t)r.len <= size &&
+	   fseeko(fp, end + r.len, SEEK_SET) == 0) {
+	end += r.len;
+    }
+    fclose(fp);
+
+    return (end);
+}
+
+
+EventLog::EventLog() : _fp(NULL) {}
+
+
+EventLog::~EventLog()
+{
+    close();
+}
+
+
+bool EventLog::open(const std::string& path)
+{
+    std::lock_guard<std::mutex> l(_lock);
+    struct stat s;
+    
+    if (_fp) {
+	return (false);
+    }
+
+    // a new file gets a header, one too short to have one starts over
+    bool exists = (stat(path.c_str(), &s) == 0);
+    bool is_new = (!exists || s.st_size < (off_t)sizeof(event_header_st));
+
+    // an existing log is appended to after its last whole record, so a
+    // record torn by a crash doesn't hide every one written after it
+    if (!is_new) {
+	off_t end = complete_length(path, s.st_size);
+
+	if (end < 0 || (end < s.st_size && truncate(path.c_str(), end) != 0)) {
+	    return (false);
+	}
+    } else if (exists && s.st_size > 0 && truncate(path.c_str(), 0) != 0) {
+	return (false);
+    }
+
+    if (!(_fp = fopen(path.c_str(), "ab"))) {
+	return (false);
+    }
+
+    if (is_new) {
+	event_header_st h;
+	memcpy(h.magic, EVENT_MAGIC, sizeof(h.magic));
+	h.version = EVENT_VERSION;
+	if (fwrite(&h, sizeof(h), 1, _fp) != 1 || fflush(_fp) != 0) {
+	    fclose(_fp);
+	    _fp = NULL;
+	    return (false);
+	}
+    }
+
+    _buf.reserve(EVENT_BUFFER_SIZE);
+    return (true);
+}
+
+
+void EventLog::close()
+{
+    std::lock_guard<std::mutex> l(_lock);
+    
+    if (_fp) {
+	flush_locked();
+	fclose(_fp);
+	_fp = NULL;
+    }
+}
+
+
+bool EventLog::is_open() const
+{
+    return (_fp != NULL);
+}
+
+
+void EventLog::log(const Event& e)
+{
+    std::lock_guard<std::mutex> l(_lock);
+    event_record_st r;
+
+    if (!_fp) {
+	return;
+    }
+
+    memset(&r, 0, sizeof(r));
+    r.type = e.type;
+    r.path_len = e.file.path.size();
+    r.name_len = std::min<size_t>(e.file.name.size(), UINT16_MAX);
+    r.len = sizeof(r) + r.path_len + r.name_len;
+    r.time = e.time;
+    r.size = e.file.size;
+    r.modified = e.file.modified;
+    r.crc = e.file.crc;
+    r.old_size = e.old.size;
+    r.old_modified = e.old.modified;
+    r.old_crc = e.old.crc;
+
+    const char *p = (const char *)&r;
+    _buf.insert(_buf.end(), p, p + sizeof(r));
+    _buf.insert(_buf.end(), e.file.path.data(), e.file.path.data() + r.path_len);
+    _buf.insert(_buf.end(), e.file.name.data(), e.file.name.data() + r.name_len);
+
+    if (_buf.size() >= EVENT_BUFFER_SIZE) {
+	flush_locked();
+    }
+}
+
+
+bool EventLog::flush()
+{
+    std::lock_guard<std::mutex> l(_lock);
+    return (flush_locked());
+}
+
+
+bool EventLog::flush_locked()
+{
+    if (!_fp) {
+	return (false);
+    }
+
+    bool ok = _buf.empty() || (fwrite(_buf.data(), 1, _buf.size(), _fp) == _buf.size());
+    _buf.clear();
+    
+    return (fflush(_fp) == 0 && ok);
+}
+
+
+EventReader::EventReader() : _fp(NULL) {}
+
+
+EventReader::~EventReader()
+{
+    close();
+}
+
+
+bool EventReader::open(const std::string& path)
+{
+    event_header_st h;
+    
+    close();
+    if (!(_fp = fopen(path.c_str(), "rb"))) {
+	return (false);
+    }
+    
+    if (fread(&h, sizeof(h), 1, _fp) != 1 ||
+	memcmp(h.magic, EVENT_MAGIC, sizeof(h.magic)) != 0 ||
+	h.version != EVENT_VERSION) {
+	close();
+	return (false);
+    }
+
+    return (true);
+}
+
+
+void EventReader::close()
+{
+    if (_fp) {
+	fclose(_fp);
+	_fp = NULL;
+    }
+}
+
+
+bool EventReader::next(Event& e)
+{
+    event_record_st r;
+
+    if (!_fp || fread(&r, sizeof(r), 1, _fp) != 1) {
+	return (false);
+    }
+    
+    if (r.len != sizeof(r) + r.path_len + r.name_len) {
+	return (false);
+    }
+
+    e.file.path.resize(r.path_len);
+    e.file.name.resize(r.name_len);
+    if ((r.path_len && fread(&e.file.path[0], r.path_len, 1, _fp) != 1) ||
+	(r.name_len && fread(&e.file.name[0], r.name_len, 1, _fp) != 1)) {
+	return (false);
+    }
+
+    e.type = (event_type_e)r.type;
+    e.time = r.time;
+    e.file.size = r.size;
+    e.file.modified = r.modified;
+    e.file.crc = r.crc;
+    e.old.path = e.file.path;
+    e.old.name = e.file.name;
+    e.old.size = r.old_size;
+    e.old.modified = r.old_modified;
+    e.old.crc = r.old_crc;
+    
+    return (true);
+}
@@ -0,0 +1,132 @@
+/* Backup Manager Event Log
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#ifndef __EVENT_LOG__
+#define __EVENT_LOG__
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdio>
+#include <cstdint>
+
+#include "file.hpp"
+
+
+/* An append-only log of what each scan found, one record per file.
+ * On disk it is laid out as:
+ *
+ *     event_header_st
+ *     (event_record_st, path, name)*
+ *
+ * Each record starts with its total length, so a reader can skip
+ * records it doesn't want without looking at them. All integers are
+ * stored in host byte order. A record cut short by a crash is dropped
+ * when the log is next opened for writing, and ignored by readers.
+ */
+#define EVENT_MAGIC   "BMEV"
+#define EVENT_VERSION 1
+
+typedef enum event_type_e : uint8_t {
+    EVENT_MISMATCH = 1,   // file differs from the known record
+    EVENT_MISSING,        // known file is no longer on disk
+    EVENT_NEW,            // file seen for the first time
+    EVENT_CHECKED         // file matches the known record
+} event_type_e;
+
+struct event_header_st {
+    char     magic[4];
+    uint32_t version;
+};
+
+struct event_record_st {
+    uint32_t len;
+    uint8_t  type;
+    uint8_t  reserved;
+    uint16_t name_len;
+    uint32_t path_len;
+    uint32_t crc;
+    uint64_t time;
+    uint64_t size;
+    uint64_t modified;
+    // what was known before, for EVENT_MISMATCH
+    uint64_t old_size;
+    uint64_t old_modified;
+    uint32_t old_crc;
+    uint32_t reserved2;
+};
+
+static_assert(sizeof(event_header_st) == 8, "event header must be 8 bytes");
+static_assert(sizeof(event_record_st) == 64, "event record must be 64 bytes");
+
+
+struct Event {
+    event_type_e type;
+    uint64_t     time;
+    File         file;
+    // the previously known state, only set for EVENT_MISMATCH
+    File         old;
+
+    Event();
+    Event(const event_type_e, const File&);
+    Event(const event_type_e, const File&, const File&);
+};
+
+const char* event_type_str(const event_type_e);
+// EVENT_* for a name from event_type_str, 0 if there isn't one
+event_type_e event_type_from_str(const std::string&);
+
+
+/* Buffers records and appends them to the log a buffer at a time. Safe
+ * to use from several threads.
+ */
+class EventLog {
+public:
+    EventLog();
+    EventLog(const EventLog&) = delete;
+    EventLog &operator=(const EventLog&) = delete;
+    ~EventLog();
+
+    bool open(const std::string&);
+    void close();
+    bool is_open() const;
+    void log(const Event&);
+    // writes out everything buffered
+    bool flush();
+
+private:
+    bool flush_locked();
+    
+    std::mutex _lock;
+    FILE *_fp;
+    std::vector<char> _buf;
+};
+
+
+// reads back an event log written by EventLog
+class EventReader {
+public:
+    EventReader();
+    EventReader(const EventReader&) = delete;
+    EventReader &operator=(const EventReader&) = delete;
+    ~EventReader();
+    
+    bool open(const std::string&);
+    void close();
+    // false at the end of the log
+    bool next(Event&);
+    
+private:
+    FILE *_fp;
+};
+
+#endif
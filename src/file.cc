@@ -13,6 +13,9 @@
  * 11/26/2015 - various improvements
  * 11/27/2015 - directory comparison
  * 12/27/2015 - add != comparison for Directory
+ * 10/19/2026 - throttled CRC
+ * 10/19/2026 - optionally skip the CRC
+ * 10/19/2026 - size and CRC of the file as stored
  */
 
 #include <sys/stat.h>
@@ -22,7 +25,8 @@
 
 
 
-File::File() : path(""), name(""), size(0), modified(0), crc(0), checked(0) {}
+File::File() : path(""), name(""), size(0), modified(0), crc(0), checked(0), stored(0),
+	       stored_crc(0) {}
 
 
 File::File(const std::string& p, const std::string& n, const uint64_t& s, const uint64_t& m, 
@@ -31,18 +35,24 @@ File::File(const std::string& p, const std::string& n, const uint64_t& s, const
 				size(s), 
 				modified(m), 
 				crc(c),
-                                checked(0){}
+				checked(0),
+				stored(0),
+				stored_crc(0) {}
 
 
-File::File(const std::string& p, const std::string& n)
+File::File(const std::string& p, const std::string& n, Throttle *throttle, const bool crc)
 {
     path = p;
     name = n;
     
     std::string full_path = p + "/" + n;
     
-    CRC32 c(4096);
-    crc = c.crc32(full_path);
+    if (crc) {
+	CRC32 c(4096);
+	this->crc = c.crc32(full_path, throttle);
+    } else {
+	this->crc = 0;
+    }
     
     struct stat s;
     stat(full_path.c_str(), &s);
@@ -51,6 +61,8 @@ File::File(const std::string& p, const std::string& n)
     modified = s.st_mtime;
 
     checked = 0;
+    stored = 0;
+    stored_crc = 0;
 }
 
 
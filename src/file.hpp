@@ -13,6 +13,9 @@
  * 11/26/2015 - various improvements
  * 11/27/2015 - directory comparison
  * 12/27/2015 - add != comparison for Directory
+ * 10/19/2026 - throttled CRC
+ * 10/19/2026 - optionally skip the CRC
+ * 10/19/2026 - size and CRC of the file as stored
  */
 
 #ifndef __FILE_OBJ__
@@ -22,6 +25,8 @@
 #include <unordered_map>
 #include <ostream>
 
+#include "throttle.hpp"
+
 
 struct File {
     std::string path;
@@ -30,10 +35,15 @@ struct File {
     uint64_t    modified;
     uint32_t    crc;
     uint64_t    checked;
+    // the length and CRC of a copy that is kept compressed, 0 for a
+    // file that is stored as it is
+    uint64_t    stored;
+    uint32_t    stored_crc;
 
     File();
     File(const std::string&, const std::string&, const uint64_t&, const uint64_t&, const uint32_t&);
-    File(const std::string&, const std::string&);
+    // stats the file, and computes its CRC unless crc is false
+    File(const std::string&, const std::string&, Throttle* = NULL, const bool crc = true);
     bool operator==(const File&) const;
     bool operator!=(const File&) const;
     bool identical(const File&) const;
@@ -2,42 +2,219 @@
  * Logger Library
  *
  *
- * Copyright (C) 2013-2014  Bryant Moscon - bmoscon@gmail.com
+ * Copyright (C) 2013-2026  Bryant Moscon - bmoscon@gmail.com
  * 
  * Please see the LICENSE file for the terms and conditions 
  * associated with this software.
  *
  *
  * 04/27/2014 - Initial open source release
+ * 10/19/2026 - Asynchronous backend: per-thread ring buffers drained
+ *              and written in batches by a background thread
+ * 10/19/2026 - Size and time based rotation, compression, reopen
  *
  */
 
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
 #include "logger.hpp"
 
 
-Logger::Logger(const char *f) : _file(f, std::ios::out | std::ios::app), 
-				_log(_file),
-				_level(INFO),
-				_line_level(DEBUG)
+// bytes of log lines each thread can have waiting to be written
+#define LOGGER_RING_SIZE (256 * 1024)
+// how long a line can wait before the writer picks it up
+#define LOGGER_FLUSH_MS std::chrono::milliseconds(50)
+// read size when compressing rotated segments
+#define LOGGER_COMPRESS_CHUNK (64 * 1024)
+
+
+typedef struct record_st {
+    uint64_t seq;
+    int64_t  time;
+    uint32_t len;
+    uint32_t level;
+} record_st;
+
+
+/* Single producer, single consumer queue of variable length records.
+ * The owning thread pushes, the writer thread pops. head and tail only
+ * ever grow, the slot is the position modulo the (power of 2) capacity.
+ */
+class Logger::Ring {
+public:
+    Ring(const uint64_t capacity) : _buf(new char[capacity]), _size(capacity), _head(0), _tail(0),
+				    _retired(false)
+    {
+	assert((capacity & (capacity - 1)) == 0);
+    }
+    
+    ~Ring()
+    {
+	delete [] _buf;
+    }
+
+    // false if there isn't room for it yet
+    bool push(const record_st& r, const char *msg)
+    {
+	record_st hdr = r;
+	hdr.len = std::min<uint64_t>(hdr.len, _size - sizeof(hdr));
+	
+	uint64_t head = _head.load(std::memory_order_relaxed);
+	uint64_t tail = _tail.load(std::memory_order_acquire);
+	
+	if (_size - (head - tail) < sizeof(hdr) + hdr.len) {
+	    return (false);
+	}
+
+	copy_in(head, &hdr, sizeof(hdr));
+	copy_in(head + sizeof(hdr), msg, hdr.len);
+	_head.store(head + sizeof(hdr) + hdr.len, std::memory_order_release);
+	
+	return (true);
+    }
+
+    // moves every record to out
+    void pop(std::vector<std::pair<record_st, std::string> >& out)
+    {
+	uint64_t tail = _tail.load(std::memory_order_relaxed);
+	uint64_t head = _head.load(std::memory_order_acquire);
+
+	while (tail < head) {
+	    record_st hdr;
+	    std::string msg;
+	    
+	    copy_out(tail, &hdr, sizeof(hdr));
+	    msg.resize(hdr.len);
+	    copy_out(tail + sizeof(hdr), &msg[0], hdr.len);
+	    tail += sizeof(hdr) + hdr.len;
+	    out.push_back(std::make_pair(hdr, std::move(msg)));
+	}
+	
+	_tail.store(tail, std::memory_order_release);
+    }
+
+    // nothing more will be pushed, its thread has exited or its logger is gone
+    void retire()
+    {
+	_retired.store(true, std::memory_order_release);
+    }
+
+    bool retired() const
+    {
+	return (_retired.load(std::memory_order_acquire));
+    }
+
+private:
+    void copy_in(const uint64_t pos, const void *src, const uint64_t len)
+    {
+	uint64_t off = pos & (_size - 1);
+	uint64_t first = std::min(len, _size - off);
+	
+	memcpy(_buf + off, src, first);
+	memcpy(_buf, (const char *)src + first, len - first);
+    }
+
+    void copy_out(const uint64_t pos, void *dst, const uint64_t len) const
+    {
+	uint64_t off = pos & (_size - 1);
+	uint64_t first = std::min(len, _size - off);
+	
+	memcpy(dst, _buf + off, first);
+	memcpy((char *)dst + first, _buf, len - first);
+    }
+    
+    char *_buf;
+    const uint64_t _size;
+    // kept on separate cache lines, one is written by each side
+    std::atomic<uint64_t> _head;
+    char _pad[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> _tail;
+    std::atomic<bool> _retired;
+};
+
+
+// ids are never reused, so a thread's cached ring for a destroyed
+// logger can never be mistaken for one belonging to a new logger
+static std::atomic<uint64_t> next_id(1);
+
+
+Logger::Logger(const char *f)
+{
+    open(f);
+}
+
+
+Logger::Logger(const std::string& f)
 {
-    assert(_file.is_open());
+    open(f.c_str());
 }
 
 
-Logger::Logger(const std::string& f) : _file(f.c_str(), std::ios::out | std::ios::app), 
-				       _log(_file),
-				       _level(INFO),
-				       _line_level(DEBUG)
+void Logger::open(const char *f)
 {
-    assert(_file.is_open());
+    _path = f;
+    _fd = -1;
+    open_file();
+    assert(_fd >= 0);
+    
+    _level = INFO;
+    _id = next_id++;
+    _seq = 0;
+    _stop = false;
+    _urgent = false;
+    _sync_requested = 0;
+    _sync_done = 0;
+    _reopen = false;
+    _max_size = 0;
+    _max_age = 0;
+    _keep = 0;
+    _compress = false;
+    _compress_stop = false;
+    _time = 0;
+    
+    _writer = std::thread(&Logger::writer, this);
 }
 
 
 Logger::~Logger()
 {
-    if (_file.is_open()) {
-	_log.flush();
-	_file.close();
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	_stop = true;
+    }
+    _wake.notify_one();
+    _writer.join();
+
+    // threads still holding one of these rings drop it on their next miss
+    {
+	std::lock_guard<std::mutex> l(_rings_lock);
+	for (size_t i = 0; i < _rings.size(); ++i) {
+	    _rings[i]->retire();
+	}
+    }
+
+    // segments already rotated are still compressed before we go
+    if (_compressor.joinable()) {
+	{
+	    std::lock_guard<std::mutex> l(_compress_lock);
+	    _compress_stop = true;
+	}
+	_compress_wake.notify_one();
+	_compressor.join();
+    }
+    
+    if (_fd >= 0) {
+	close(_fd);
     }
 }
 
@@ -50,19 +227,71 @@ void Logger::set_level(const logger_level& level)
 
 void Logger::flush()
 {
-    if (_line_level >= _level) {
-	_log << get_time() << " -- [" << level_str(_line_level) << "] -- " << str();
-	_log.flush();
+    local_st& t = local();
+    line_st& l = t.line;
+    
+    if (l.level >= _level) {
+	const std::string msg = l.buf.str();
+	record_st r = {_seq++, time(NULL), (uint32_t)msg.size(), l.level};
+	Ring *ring = t.ring.get();
+	bool full;
+	
+	// a full ring means the writer is behind, so hand it
+	// the CPU until there is room
+	while ((full = !ring->push(r, msg.data())) || l.level == ERROR) {
+	    {
+		std::lock_guard<std::mutex> lk(_lock);
+		_urgent = true;
+	    }
+	    _wake.notify_one();
+	    
+	    if (!full) {
+		break;
+	    }
+	    std::this_thread::yield();
+	}
     }
     
-    str("");
-    _line_level = DEBUG;
+    l.buf.str("");
+    l.level = DEBUG;
+}
+
+
+void Logger::sync()
+{
+    std::unique_lock<std::mutex> l(_lock);
+    uint64_t target = ++_sync_requested;
+    
+    _wake.notify_one();
+    _synced.wait(l, [this, target]{ return (_sync_done >= target); });
+}
+
+
+void Logger::set_rotation(const uint64_t max_size, const uint32_t max_age,
+			  const uint32_t keep, const bool compress)
+{
+    std::lock_guard<std::mutex> l(_lock);
+    
+    _max_size = max_size;
+    _max_age = max_age;
+    _keep = keep;
+    _compress = compress;
+}
+
+
+void Logger::reopen()
+{
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	_reopen = true;
+    }
+    _wake.notify_one();
 }
 
 
 Logger& Logger::operator<<(const logger_level& level)
 {
-    _line_level = level;
+    line().level = level;
     return (*this);
 }
 
@@ -73,22 +302,364 @@ Logger& Logger::operator<<(LoggerManip m)
 }
 
 
-std::string Logger::get_time()
+Logger::line_st& Logger::line()
+{
+    return (local().line);
+}
+
+
+// this thread's line and ring for this logger, created on first use
+Logger::local_st& Logger::local()
+{
+    // retires every ring of the thread when it exits
+    struct cache_st {
+	std::vector<std::unique_ptr<local_st> > entries;
+
+	~cache_st()
+	{
+	    for (size_t i = 0; i < entries.size(); ++i) {
+		entries[i]->ring->retire();
+	    }
+	}
+    };
+    static thread_local cache_st cache;
+    std::vector<std::unique_ptr<local_st> >& entries = cache.entries;
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+	if (entries[i]->id == _id) {
+	    return (*entries[i]);
+	}
+    }
+
+    // loggers destroyed since have retired their rings, let them go
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+				 [](const std::unique_ptr<local_st>& e) {
+				     return (e->ring->retired());
+				 }), entries.end());
+
+    std::unique_ptr<local_st> e(new local_st);
+    e->id = _id;
+    e->line.level = DEBUG;
+    e->ring = std::make_shared<Ring>(LOGGER_RING_SIZE);
+    {
+	std::lock_guard<std::mutex> l(_rings_lock);
+	_rings.push_back(e->ring);
+    }
+    entries.push_back(std::move(e));
+    
+    return (*entries.back());
+}
+
+
+void Logger::writer()
+{
+    std::string batch;
+    std::unique_lock<std::mutex> l(_lock);
+    
+    while (true) {
+	_wake.wait_for(l, LOGGER_FLUSH_MS, [this]{
+		return (_stop || _urgent || _reopen || _sync_requested != _sync_done);
+	    });
+	bool stop = _stop;
+	bool reopen = _reopen;
+	uint64_t sync = _sync_requested;
+	uint64_t max_size = _max_size;
+	uint32_t max_age = _max_age;
+	_urgent = false;
+	_reopen = false;
+	l.unlock();
+
+	drain(batch);
+
+	time_t now = time(NULL);
+	if (reopen || _fd < 0) {
+	    open_file();
+	}
+	if (_fd >= 0 && _size && max_age && now - _opened >= max_age) {
+	    rotate(now);
+	}
+	
+	size_t off = 0;
+	while (off < batch.size() && _fd >= 0) {
+	    size_t len = batch.size() - off;
+
+	    // only whole lines go in a segment, and a segment only goes
+	    // past max_size when a single line is longer than that
+	    if (max_size && _size + len > max_size) {
+		size_t room = (_size < max_size) ? max_size - _size : 0;
+		size_t end = room ? batch.rfind('\n', off + room - 1) : std::string::npos;
+		
+		if (end == std::string::npos || end < off) {
+		    if (_size && rotate(now)) {
+			continue;
+		    }
+		    // couldn't rotate, the rest goes where we are
+		    end = _size ? batch.size() - 1 : batch.find('\n', off);
+		}
+		len = end + 1 - off;
+	    }
+	    
+	    if (!write_out(batch.data() + off, len)) {
+		// nowhere to report it, drop the batch
+		break;
+	    }
+	    off += len;
+	}
+	batch.clear();
+	
+	l.lock();
+	_sync_done = sync;
+	_synced.notify_all();
+	if (stop) {
+	    return;
+	}
+    }
+}
+
+
+bool Logger::write_out(const char *p, size_t len)
+{
+    while (len) {
+	ssize_t n = write(_fd, p, len);
+	if (n < 0 && errno == EINTR) {
+	    continue;
+	}
+	if (n <= 0) {
+	    return (false);
+	}
+	p += n;
+	len -= n;
+	_size += n;
+    }
+
+    return (true);
+}
+
+
+// (re)opens the file by name. Called from the writer thread
+void Logger::open_file()
+{
+    struct stat s;
+    
+    if (_fd >= 0) {
+	close(_fd);
+    }
+    
+    _fd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    _size = (_fd >= 0 && fstat(_fd, &s) == 0) ? s.st_size : 0;
+    _opened = time(NULL);
+}
+
+
+/* Moves the current file aside and starts a new one. Called from the
+ * writer thread, callers carry on filling their rings meanwhile.
+ * false if the file could not be moved.
+ */
+bool Logger::rotate(const time_t now)
+{
+    struct tm timeinfo;
+    char stamp[32];
+    struct stat s;
+    
+    localtime_r(&now, &timeinfo);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &timeinfo);
+
+    // more than one rotation in a second gets a counter
+    std::string name = _path + "." + stamp;
+    for (uint32_t i = 1; stat(name.c_str(), &s) == 0 ||
+	     stat((name + ".gz").c_str(), &s) == 0; ++i) {
+	name = _path + "." + stamp + "." + std::to_string(i);
+    }
+
+    bool compress;
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	compress = _compress;
+    }
+    
+    if (rename(_path.c_str(), name.c_str()) != 0) {
+	// keep appending to what we have rather than lose lines
+	return (false);
+    }
+    open_file();
+
+    if (compress) {
+	{
+	    std::lock_guard<std::mutex> l(_compress_lock);
+	    _to_compress.push_back(name);
+	}
+	if (!_compressor.joinable()) {
+	    _compressor = std::thread(&Logger::compressor, this);
+	}
+	_compress_wake.notify_one();
+    } else {
+	prune();
+    }
+
+    return (true);
+}
+
+
+/* Deletes the oldest rotated segments beyond the number to keep. A
+ * segment counts once whether or not it has been compressed yet.
+ */
+void Logger::prune()
 {
-    struct tm *timeinfo;
-    time_t rawtime;
-    char *time_buf;
+    uint32_t keep;
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	keep = _keep;
+    }
+    if (!keep) {
+	return;
+    }
     
-    time(&rawtime);
-    timeinfo = localtime(&rawtime);
-    time_buf = asctime(timeinfo);
+    size_t slash = _path.rfind('/');
+    std::string dir = (slash == std::string::npos) ? "./" : _path.substr(0, slash + 1);
+    std::string base = ((slash == std::string::npos) ? _path : _path.substr(slash + 1)) + ".";
+    // timestamps sort in the order they were rotated
+    std::map<std::string, std::vector<std::string> > segments;
+    DIR *d = opendir(dir.c_str());
+    struct dirent *entry;
+
+    if (!d) {
+	return;
+    }
+    while ((entry = readdir(d)) != NULL) {
+	std::string name = entry->d_name;
+	
+	if (name.compare(0, base.size(), base) != 0 || name.size() == base.size() ||
+	    !isdigit(name[base.size()])) {
+	    continue;
+	}
+	std::string key = name;
+	if (key.size() > 3 && key.compare(key.size() - 3, 3, ".gz") == 0) {
+	    key.erase(key.size() - 3);
+	}
+	segments[key].push_back(name);
+    }
+    closedir(d);
+
+    while (segments.size() > keep) {
+	std::vector<std::string>& names = segments.begin()->second;
+	for (size_t i = 0; i < names.size(); ++i) {
+	    unlink((dir + names[i]).c_str());
+	}
+	segments.erase(segments.begin());
+    }
+}
+
+
+// gzips rotated segments in the background, replacing the originals
+void Logger::compressor()
+{
+    char buf[LOGGER_COMPRESS_CHUNK];
+    std::unique_lock<std::mutex> l(_compress_lock);
+
+    while (true) {
+	_compress_wake.wait(l, [this]{ return (_compress_stop || !_to_compress.empty()); });
+	if (_to_compress.empty()) {
+	    return;
+	}
+	std::string name = _to_compress.front();
+	_to_compress.pop_front();
+	l.unlock();
+
+	int in = ::open(name.c_str(), O_RDONLY);
+	int fd = (in >= 0) ? ::open((name + ".gz").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+	gzFile out = (fd >= 0) ? gzdopen(fd, "wb") : NULL;
+	bool ok = (out != NULL);
+	ssize_t n;
+
+	while (ok && (n = read(in, buf, sizeof(buf))) != 0) {
+	    if (n < 0) {
+		ok = (errno == EINTR);
+		continue;
+	    }
+	    ok = (gzwrite(out, buf, n) == n);
+	}
+	if (out && gzclose(out) != Z_OK) {
+	    ok = false;
+	} else if (!out && fd >= 0) {
+	    close(fd);
+	}
+	if (in >= 0) {
+	    close(in);
+	}
+
+	// on failure the uncompressed segment is kept instead
+	unlink(ok ? name.c_str() : (name + ".gz").c_str());
+	prune();
+	
+	l.lock();
+    }
+}
+
+
+// formats everything waiting in the rings into out, in the order logged
+void Logger::drain(std::string& out)
+{
+    std::vector<Ring*> rings;
+    std::vector<Ring*> retired;
+    std::vector<std::pair<record_st, std::string> > records;
+    
+    {
+	std::lock_guard<std::mutex> l(_rings_lock);
+	for (size_t i = 0; i < _rings.size(); ++i) {
+	    rings.push_back(_rings[i].get());
+	}
+    }
     
-    std::string ret(time_buf);
-    if (!ret.empty() && ret[ret.length() - 1] == '\n') {
-	ret.erase(ret.length()-1);
+    // a ring retired before it is popped is empty after, and can go
+    for (size_t i = 0; i < rings.size(); ++i) {
+	if (rings[i]->retired()) {
+	    retired.push_back(rings[i]);
+	}
+	rings[i]->pop(records);
+    }
+    if (!retired.empty()) {
+	std::lock_guard<std::mutex> l(_rings_lock);
+	_rings.erase(std::remove_if(_rings.begin(), _rings.end(),
+				    [&retired](const std::shared_ptr<Ring>& r) {
+					return (std::find(retired.begin(), retired.end(),
+							  r.get()) != retired.end());
+				    }), _rings.end());
+    }
+    
+    std::sort(records.begin(), records.end(), [](const std::pair<record_st, std::string>& a,
+						 const std::pair<record_st, std::string>& b) {
+		  return (a.first.seq < b.first.seq);
+	      });
+    
+    for (size_t i = 0; i < records.size(); ++i) {
+	out += format_time(records[i].first.time);
+	out += " -- [";
+	out += level_str((logger_level)records[i].first.level);
+	out += "] -- ";
+	out += records[i].second;
+	out += '\n';
+    }
+}
+
+
+// the same format asctime uses, without the newline. Only
+// reformatted when the second changes
+const std::string& Logger::format_time(const time_t t)
+{
+    if (t != _time || _time_str.empty()) {
+	struct tm timeinfo;
+	char buf[32];
+	
+	localtime_r(&t, &timeinfo);
+	asctime_r(&timeinfo, buf);
+	_time_str = buf;
+	if (!_time_str.empty() && _time_str[_time_str.length() - 1] == '\n') {
+	    _time_str.erase(_time_str.length() - 1);
+	}
+	_time = t;
     }
     
-    return (ret);
+    return (_time_str);
 }
 
 
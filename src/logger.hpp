@@ -2,13 +2,17 @@
  * Logger Library
  *
  *
- * Copyright (C) 2013-2014  Bryant Moscon - bmoscon@gmail.com
+ * Copyright (C) 2013-2026  Bryant Moscon - bmoscon@gmail.com
  * 
  * Please see the LICENSE file for the terms and conditions 
  * associated with this software.
  *
  *
  * 04/27/2014 - Initial open source release
+ * 10/19/2026 - Asynchronous backend: per-thread ring buffers drained
+ *              and written in batches by a background thread
+ * 10/19/2026 - LOG macro, compile time minimum level
+ * 10/19/2026 - Size and time based rotation, compression, reopen
  *
  */
 
@@ -16,10 +20,18 @@
 #define __LOGGER__
 
 
-#include <fstream>
 #include <cassert>
 #include <ctime>
 #include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <cstdint>
 
 
 // Log levels
@@ -31,8 +43,38 @@ typedef enum {
 } logger_level;
 
 
+/* Levels below this are compiled out of LOG() call sites entirely.
+ * Release builds set it to INFO.
+ */
+#ifndef LOGGER_MIN_LEVEL
+#define LOGGER_MIN_LEVEL DEBUG
+#endif
+
+/* LOG(log, level) << ... << std::endl;
+ *
+ * Nothing after LOG() is evaluated unless level is enabled, so disabled
+ * lines cost one comparison, and nothing at all below LOGGER_MIN_LEVEL.
+ */
+#define LOG(l, lvl)						\
+    if ((lvl) < LOGGER_MIN_LEVEL || !(l).enabled(lvl)) {}	\
+    else (l) << (lvl)
+
 
-class Logger : public std::ostringstream {
+/* Lines are built up in a buffer local to the calling thread and this
+ * logger. When a line ends it is copied, with its level and the time,
+ * into that thread's ring buffer for this logger. No locks are taken on
+ * that path. A thread's rings are retired when it exits, and freed by
+ * the writer once it has drained them. A background
+ * thread drains every ring, formats the timestamps and writes each batch
+ * with a single write(). ERROR lines wake the writer straight away,
+ * anything else is written within LOGGER_FLUSH_MS.
+ *
+ * Rotation is also done by the writer thread, between batches, so it
+ * never holds up a caller. A rotated segment is renamed to
+ * <file>.YYYYMMDD-HHMMSS and, if asked for, gzipped by a second
+ * background thread.
+ */
+class Logger {
 public:
     Logger(const char *f);
     Logger(const std::string& f);
@@ -42,11 +84,28 @@ public:
     
     
     void set_level(const logger_level& level);  
+    bool enabled(const logger_level& level) const
+    {
+	return (level >= _level.load(std::memory_order_relaxed));
+    }
+    // ends the current line
     void flush();
+    // blocks until everything logged so far is written
+    void sync();
+
+    /* Rotate once the file would grow past max_size bytes, or once it
+     * has been open for max_age seconds. 0 turns either off. Only the
+     * newest keep rotated segments are kept, 0 keeps them all.
+     */
+    void set_rotation(const uint64_t max_size, const uint32_t max_age,
+		      const uint32_t keep = 0, const bool compress = false);
+    // closes and reopens the file by name, for external log rotation
+    void reopen();
+    
     template <typename T>
     Logger& operator<<(const T& t)
     {
-	(*(std::ostringstream *)this) << t;
+	line().buf << t;
 	return (*this);
     }
     
@@ -55,20 +114,80 @@ public:
     Logger& operator<<(LoggerManip m);
     
 private:
-    std::string get_time();
-    inline const char* level_str(const logger_level& level);
+    typedef struct line_st {
+	std::ostringstream buf;
+	logger_level level;
+    } line_st;
+
+    class Ring;
+
+    // what a thread keeps for each logger it uses
+    typedef struct local_st {
+	uint64_t id;
+	line_st line;
+	std::shared_ptr<Ring> ring;
+    } local_st;
     
-    std::ofstream  _file;
-    std::ostream&  _log; 
-    logger_level   _level;
-    logger_level   _line_level;
+    void open(const char *f);
+    line_st& line();
+    local_st& local();
+    void writer();
+    void drain(std::string&);
+    bool write_out(const char *, size_t);
+    void open_file();
+    bool rotate(const time_t);
+    void prune();
+    void compressor();
+    const std::string& format_time(const time_t);
+    inline const char* level_str(const logger_level& level);
+
+    std::string _path;
+    int _fd;
+    std::atomic<int> _level;
+    uint64_t _id;
+    // orders lines from different threads
+    std::atomic<uint64_t> _seq;
+
+    // rings are only removed by the writer, so it can walk them
+    // after copying the list under the lock
+    std::mutex _rings_lock;
+    std::vector<std::shared_ptr<Ring> > _rings;
+
+    std::thread _writer;
+    std::mutex _lock;
+    std::condition_variable _wake;
+    std::condition_variable _synced;
+    bool _stop;
+    bool _urgent;
+    uint64_t _sync_requested;
+    uint64_t _sync_done;
+    bool _reopen;
+
+    // rotation settings, guarded by _lock
+    uint64_t _max_size;
+    uint32_t _max_age;
+    uint32_t _keep;
+    bool _compress;
+    // only touched by the writer thread
+    uint64_t _size;
+    time_t _opened;
+
+    // rotated segments waiting to be compressed
+    std::thread _compressor;
+    std::mutex _compress_lock;
+    std::condition_variable _compress_wake;
+    std::deque<std::string> _to_compress;
+    bool _compress_stop;
+
+    // the writer's cached timestamp string
+    time_t _time;
+    std::string _time_str;
 };
 
 
 namespace std { 
     inline Logger& endl(Logger& out) 
     { 
-	out.put('\n'); 
 	out.flush(); 
 	return (out); 
     } 
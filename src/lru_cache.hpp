@@ -0,0 +1,115 @@
+/* Bounded LRU Cache
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#ifndef __LRU_CACHE__
+#define __LRU_CACHE__
+
+#include <list>
+#include <unordered_map>
+#include <mutex>
+
+
+/* A thread safe key/value cache that holds at most capacity entries,
+ * evicting the least recently used entry when full. A capacity of 0
+ * disables the cache.
+ */
+template <typename K, typename V>
+class LRUCache {
+public:
+    LRUCache(const size_t capacity) : _capacity(capacity) {}
+    LRUCache(const LRUCache&) = delete;
+    LRUCache &operator=(const LRUCache&) = delete;
+    
+    bool get(const K& key, V& value)
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	auto it = _index.find(key);
+	
+	if (it == _index.end()) {
+	    return (false);
+	}
+
+	// move to the front of the list, it's now the most recently used
+	_items.splice(_items.begin(), _items, it->second);
+	value = it->second->second;
+	return (true);
+    }
+    
+    void put(const K& key, const V& value)
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	
+	if (!_capacity) {
+	    return;
+	}
+	
+	auto it = _index.find(key);
+	if (it != _index.end()) {
+	    it->second->second = value;
+	    _items.splice(_items.begin(), _items, it->second);
+	    return;
+	}
+
+	_items.push_front(std::make_pair(key, value));
+	_index.insert(std::make_pair(key, _items.begin()));
+	evict();
+    }
+    
+    void erase(const K& key)
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	auto it = _index.find(key);
+	
+	if (it != _index.end()) {
+	    _items.erase(it->second);
+	    _index.erase(it);
+	}
+    }
+    
+    void clear()
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	_items.clear();
+	_index.clear();
+    }
+
+    void set_capacity(const size_t capacity)
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	_capacity = capacity;
+	evict();
+    }
+
+    size_t size() const
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	return (_items.size());
+    }
+    
+private:
+    void evict()
+    {
+	while (_items.size() > _capacity) {
+	    _index.erase(_items.back().first);
+	    _items.pop_back();
+	}
+    }
+    
+    typedef std::list<std::pair<K, V> > list_t;
+    
+    list_t _items;
+    std::unordered_map<K, typename list_t::iterator> _index;
+    size_t _capacity;
+    mutable std::mutex _lock;
+};
+
+#endif
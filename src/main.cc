@@ -10,31 +10,48 @@
  * 09/26/2014 - Logger Support in config file
  *            - Add logging in main
  * 12/22/2015 - New design changes
+ * 10/19/2026 - Wait for SIGTERM with sigwait instead of polling
+ * 10/19/2026 - CRON mode and multiple windows
+ * 10/19/2026 - One BackupManager per config file, run concurrently
+ * 10/19/2026 - SIGHUP reopens log files
+ * 10/19/2026 - Reload configs on SIGHUP or when they change on disk
+ * 10/19/2026 - SyncManager for configs with a [Sync] section
  */
 
 #include <iostream>
 #include <string>
 #include <vector>
 #include <cstring>
+#include <climits>
 #include <thread>
 #include <mutex>
 
 #include <unistd.h>
+#include <poll.h>
 #include <sys/stat.h>
+#include <sys/signalfd.h>
+#include <sys/inotify.h>
 #include <signal.h>
 #include <fcntl.h>
 
 #include "scheduler.hpp"
 #include "backup_manager.hpp"
+#include "sync_manager.hpp"
 #include "config_parse.hpp"
+#include "common.hpp"
 
 #define LOCK_FILE "/var/run/backup_manager.pid"
+// editors write a file in several steps, wait for them to finish
+// before reloading it
+#define RELOAD_DELAY_MS 500
 
 
 static void usage();
 static void send_stop();
 static bool lock_file(int&);
-static void stop_handler(int);
+static int watch_configs(int, char*[]);
+static bool config_changed(int, int, char*[]);
+static void reload(Scheduler&, const char *);
 
 bool running = true;
 
@@ -45,7 +62,7 @@ int main(int argc, char* argv[])
     pid_t sid = 0;
     int fd = 0;
     
-    if (argc < 2 || argc > 3 || !strcmp(argv[1], "help")) {
+    if (argc < 2 || !strcmp(argv[1], "help")) {
 	usage();
 	return (EXIT_SUCCESS);
     }
@@ -53,7 +70,7 @@ int main(int argc, char* argv[])
     if (!strcmp(argv[1], "stop")) {
 	send_stop();
 	return (EXIT_SUCCESS);
-    } else if ((strcmp(argv[1], "start") != 0) || (argc != 3)) {
+    } else if ((strcmp(argv[1], "start") != 0) || (argc < 3)) {
 	usage();
 	return (EXIT_SUCCESS);
     }
@@ -82,8 +99,13 @@ int main(int argc, char* argv[])
 	exit(EXIT_SUCCESS);
     }
     
-    // set up a signal handler so we can respond to stop commands
-    signal(SIGTERM, stop_handler);
+    // block SIGTERM and SIGHUP before any threads are started, they
+    // inherit the mask, and the main thread reads them from a signalfd below
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
     
     if (chdir("/") < 0) {
 	perror("chdir failed");
@@ -92,42 +114,104 @@ int main(int argc, char* argv[])
     
    
 
+    // the schedule comes from the first config file
     ConfigParse config(argv[2]);
     mode_e m;
-    std::string mode = config.get_value("Settings", "mode");
     std::string time1, time2;
-    if (!mode.compare("RUN_STOP")) {
-	m = RUN_STOP;
-    } else if (!mode.compare("RUN_ALWAYS")) {
-	m = RUN_ALWAYS;
-    } else if (!mode.compare("RUN_WAIT")) {
-	m = RUN_WAIT;
-	time1 = config.get_value("Settings", "wait_time");
-    } else if (!mode.compare("WINDOW")) {
-	m = WINDOW;
-	time1 = config.get_value("Settings", "start_time");
-	time2 = config.get_value("Settings", "stop_time");
-    } else {
+    if (!BackupManager::read_schedule(config, m, time1, time2)) {
 	std::cerr << "Invalid mode specified in config. Exiting" << std::endl;
 	exit(EXIT_FAILURE);
     }
     
     
-    Scheduler s;
-    s.configure(m, time1, time2);
-    s.add("BackupManager", new BackupManager(argv[2]));
+    // a config with a [Sync] section also gets a SyncManager, on the
+    // same schedule as its BackupManager
+    int count = 0;
+    std::vector<int> priorities;
+    for (int i = 2; i < argc; ++i) {
+	ConfigParse c(argv[i]);
+	std::string priority = c.get_value("Settings", "priority");
+	int64_t p = 0;
+	
+	if (!priority.empty() && !parse_number(priority, p, INT_MIN, INT_MAX)) {
+	    std::cerr << "Invalid priority \"" << priority << "\" in " << argv[i]
+		      << ". Exiting" << std::endl;
+	    exit(EXIT_FAILURE);
+	}
+	priorities.push_back(p);
+	count += SyncManager::wanted(c) ? 2 : 1;
+    }
+    
+    Scheduler s(count);
+    if (!s.configure(m, time1, time2)) {
+	std::cerr << "Invalid schedule specified in config. Exiting" << std::endl;
+	exit(EXIT_FAILURE);
+    }
+
+    for (int i = 2; i < argc; ++i) {
+	ConfigParse c(argv[i]);
+	int p = priorities[i - 2];
+	
+	s.add(argv[i], new BackupManager(argv[i]), p);
+	if (SyncManager::wanted(c)) {
+	    s.add(std::string(argv[i]) + ":sync", new SyncManager(argv[i]), p);
+	}
+    }
     s.start();
 
+    int sig_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+    if (sig_fd < 0) {
+	perror("signalfd failed");
+	exit(EXIT_FAILURE);
+    }
+    // without inotify configs are only reloaded on SIGHUP
+    int watch_fd = watch_configs(argc, argv);
+    
     // all output via logging now
     close(STDIN_FILENO);
     close(STDOUT_FILENO);
     close(STDERR_FILENO);
+
+    bool reload_pending = false;
     
-    while (running) {	
-	sleep(30);
+    while (running) {
+	struct pollfd fds[2] = {{sig_fd, POLLIN, 0}, {watch_fd, POLLIN, 0}};
+	int n = poll(fds, watch_fd < 0 ? 1 : 2, reload_pending ? RELOAD_DELAY_MS : -1);
+	
+	if (n < 0) {
+	    continue;
+	}
+
+	// quiet for RELOAD_DELAY_MS since the last change
+	if (n == 0) {
+	    reload(s, argv[2]);
+	    reload_pending = false;
+	    continue;
+	}
+	
+	if (fds[0].revents & POLLIN) {
+	    struct signalfd_siginfo info;
+	    
+	    if (read(sig_fd, &info, sizeof(info)) == sizeof(info)) {
+		if (info.ssi_signo == SIGTERM) {
+		    running = false;
+		} else if (info.ssi_signo == SIGHUP) {
+		    reload(s, argv[2]);
+		    reload_pending = false;
+		}
+	    }
+	}
+	
+	if (watch_fd >= 0 && (fds[1].revents & POLLIN) && config_changed(watch_fd, argc, argv)) {
+	    reload_pending = true;
+	}
     }
 
     s.stop();
+    close(sig_fd);
+    if (watch_fd >= 0) {
+	close(watch_fd);
+    }
 
    
     // We shouldnt make it here until manager stops, 
@@ -145,7 +229,80 @@ int main(int argc, char* argv[])
 
 static void usage()
 {
-    std::cout << "usage: backup_manager [start <config file> | stop | help]" << std::endl;
+    std::cout << "usage: backup_manager [start <config file> [config file ...] | stop | help]" << std::endl;
+}
+
+
+/* Watches the directories holding the configs rather than the files,
+ * since editors tend to replace a file instead of writing to it.
+ */
+static int watch_configs(int argc, char* argv[])
+{
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (fd < 0) {
+	return (-1);
+    }
+    
+    for (int i = 2; i < argc; ++i) {
+	std::string path = argv[i];
+	size_t slash = path.rfind('/');
+	std::string dir = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+	
+	inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    }
+
+    return (fd);
+}
+
+
+// reads pending inotify events, true if any were for a config
+static bool config_changed(int fd, int argc, char* argv[])
+{
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    bool ret = false;
+    ssize_t len;
+    
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+	struct inotify_event *e;
+	
+	for (char *p = buf; p < buf + len; p += sizeof(*e) + e->len) {
+	    e = (struct inotify_event *)p;
+	    if (!e->len) {
+		continue;
+	    }
+	    for (int i = 2; i < argc; ++i) {
+		const char *name = strrchr(argv[i], '/');
+		if (!strcmp(name ? name + 1 : argv[i], e->name)) {
+		    ret = true;
+		}
+	    }
+	}
+    }
+
+    return (ret);
+}
+
+
+/* The schedule is reloaded from the first config, each BackupManager
+ * reloads its own. A bad schedule is reported by the BackupManager, the
+ * scheduler keeps the one it has.
+ */
+static void reload(Scheduler& s, const char *cfg)
+{
+    try {
+	ConfigParse config(cfg);
+	mode_e m;
+	std::string time1, time2;
+	
+	if (BackupManager::read_schedule(config, m, time1, time2)) {
+	    s.configure(m, time1, time2);
+	}
+    } catch (ConfigParseEx& e) {
+	// reported by the BackupManager for this config
+    }
+
+    s.hangup();
 }
 
 
@@ -175,12 +332,6 @@ static void send_stop()
 }
 
 
-static void stop_handler(int signo)
-{
-    running = false;
-}
-
-
 static bool lock_file(int& fd)
 {
     struct flock file_lock = {F_WRLCK, SEEK_SET, 0, 0, 0};
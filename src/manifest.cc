@@ -0,0 +1,256 @@
+/* Backup Manager Disk Manifest
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ * 10/19/2026 - path escaping moved to common
+ *
+ */
+
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "manifest.hpp"
+#include "common.hpp"
+
+
+static int compare(const char *a, const size_t a_len, const std::string& b)
+{
+    int ret = memcmp(a, b.data(), std::min(a_len, b.size()));
+
+    if (ret == 0) {
+	if (a_len < b.size()) {
+	    return (-1);
+	}
+	return (a_len > b.size());
+    }
+    
+    return (ret);
+}
+
+
+Manifest::Manifest() : _map(NULL), _map_len(0), _header(NULL), _records(NULL), _strings(NULL) {}
+
+
+Manifest::~Manifest()
+{
+    close();
+}
+
+
+bool Manifest::open(const std::string& path)
+{
+    int fd;
+    struct stat s;
+    
+    close();
+    
+    if ((fd = ::open(path.c_str(), O_RDONLY)) < 0) {
+	return (false);
+    }
+    
+    if (fstat(fd, &s) < 0 || (size_t)s.st_size < sizeof(manifest_header_st)) {
+	::close(fd);
+	return (false);
+    }
+
+    void *m = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    
+    if (m == MAP_FAILED) {
+	return (false);
+    }
+
+    _map = (const uint8_t *)m;
+    _map_len = s.st_size;
+    _header = (const manifest_header_st *)_map;
+    
+    // reject anything that does not look like a complete manifest
+    if (memcmp(_header->magic, MANIFEST_MAGIC, 4) != 0 ||
+	_header->version != MANIFEST_VERSION ||
+	_header->count > (_map_len - sizeof(manifest_header_st)) / sizeof(manifest_record_st) ||
+	_header->strings != sizeof(manifest_header_st) + _header->count * sizeof(manifest_record_st) ||
+	_header->strings_len != _map_len - _header->strings) {
+	close();
+	return (false);
+    }
+
+    _records = (const manifest_record_st *)(_map + sizeof(manifest_header_st));
+    _strings = (const char *)(_map + _header->strings);
+
+    // every name is read straight from the map, so none may point
+    // outside the strings
+    uint64_t len = _header->strings_len;
+    for (uint64_t i = 0; i < _header->count; ++i) {
+	const manifest_record_st& r = _records[i];
+
+	if (r.dir > len || r.dir_len > len - r.dir || r.name > len || r.name_len > len - r.name) {
+	    close();
+	    return (false);
+	}
+    }
+    
+    return (true);
+}
+
+
+void Manifest::close()
+{
+    if (_map) {
+	munmap((void *)_map, _map_len);
+    }
+    
+    _map = NULL;
+    _map_len = 0;
+    _header = NULL;
+    _records = NULL;
+    _strings = NULL;
+}
+
+
+uint64_t Manifest::size() const
+{
+    return (_header ? _header->count : 0);
+}
+
+
+int Manifest::compare_dir(const manifest_record_st& r, const std::string& dir) const
+{
+    return (compare(_strings + r.dir, r.dir_len, dir));
+}
+
+
+int Manifest::compare_name(const uint64_t i, const std::string& name) const
+{
+    return (compare(_strings + _records[i].name, _records[i].name_len, name));
+}
+
+
+bool Manifest::find(const std::string& dir, uint64_t& first, uint64_t& last) const
+{
+    const manifest_record_st *end = _records + size();
+    
+    const manifest_record_st *lo = std::lower_bound(_records, end, dir,
+						    [this](const manifest_record_st& r,
+							   const std::string& d) {
+							return (compare_dir(r, d) < 0);
+						    });
+    const manifest_record_st *hi = std::upper_bound(lo, end, dir,
+						    [this](const std::string& d,
+							   const manifest_record_st& r) {
+							return (compare_dir(r, d) > 0);
+						    });
+    first = lo - _records;
+    last = hi - _records;
+    
+    return (first != last);
+}
+
+
+File Manifest::record(const uint64_t i) const
+{
+    const manifest_record_st& r = _records[i];
+    File ret(std::string(_strings + r.dir, r.dir_len), std::string(_strings + r.name, r.name_len),
+	     r.size, r.modified, r.crc);
+    ret.checked = r.checked;
+    
+    return (ret);
+}
+
+
+std::string manifest_path(const std::string& dir, const std::string& mount)
+{
+    return (dir + "/" + escape_path(mount) + ".bmm");
+}
+
+
+void ManifestWriter::add(const File& f)
+{
+    _files.push_back(f);
+}
+
+
+void ManifestWriter::clear()
+{
+    _files.clear();
+}
+
+
+/* The manifest is written to a temporary file which is then renamed
+ * over the old one, so readers only ever see a complete manifest.
+ */
+bool ManifestWriter::write(const std::string& path)
+{
+    std::sort(_files.begin(), _files.end(), [](const File& a, const File& b) {
+	    int c = a.path.compare(b.path);
+	    return (c < 0 || (c == 0 && a.name.compare(b.name) < 0));
+	});
+
+    std::vector<manifest_record_st> records(_files.size());
+    std::unordered_map<std::string, uint64_t> dirs;
+    std::string strings;
+
+    for (uint64_t i = 0; i < _files.size(); ++i) {
+	const File& f = _files[i];
+	manifest_record_st& r = records[i];
+	
+	auto d = dirs.find(f.path);
+	if (d == dirs.end()) {
+	    d = dirs.insert(std::make_pair(f.path, strings.size())).first;
+	    strings += f.path;
+	}
+
+	memset(&r, 0, sizeof(r));
+	r.dir = d->second;
+	r.dir_len = f.path.size();
+	r.name = strings.size();
+	r.name_len = f.name.size();
+	r.size = f.size;
+	r.modified = f.modified;
+	r.checked = f.checked;
+	r.crc = f.crc;
+	strings += f.name;
+    }
+
+    manifest_header_st h;
+    memcpy(h.magic, MANIFEST_MAGIC, 4);
+    h.version = MANIFEST_VERSION;
+    h.count = records.size();
+    h.strings = sizeof(h) + records.size() * sizeof(manifest_record_st);
+    h.strings_len = strings.size();
+
+    std::string tmp = path + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "w");
+    if (!fp) {
+	return (false);
+    }
+
+    bool ok = (fwrite(&h, sizeof(h), 1, fp) == 1);
+    if (ok && records.size()) {
+	ok = (fwrite(records.data(), sizeof(manifest_record_st), records.size(), fp) ==
+	      records.size());
+    }
+    if (ok && strings.size()) {
+	ok = (fwrite(strings.data(), 1, strings.size(), fp) == strings.size());
+    }
+    ok = (fflush(fp) == 0) && ok;
+    ok = (fsync(fileno(fp)) == 0) && ok;
+    ok = (fclose(fp) == 0) && ok;
+
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+	remove(tmp.c_str());
+	return (false);
+    }
+    
+    return (true);
+}
@@ -0,0 +1,104 @@
+/* Backup Manager Disk Manifest
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#ifndef __MANIFEST__
+#define __MANIFEST__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "file.hpp"
+
+
+/* A manifest is a snapshot of the known state of every file on one disk.
+ * On disk it is laid out as:
+ *
+ *     manifest_header_st
+ *     manifest_record_st[count]   - sorted by (directory, name)
+ *     string table                - directory paths and file names
+ *
+ * All integers are stored in host byte order. Directory paths are stored
+ * once in the string table and shared by all records in that directory.
+ */
+#define MANIFEST_MAGIC   "BMMF"
+#define MANIFEST_VERSION 1
+
+struct manifest_header_st {
+    char     magic[4];
+    uint32_t version;
+    uint64_t count;
+    uint64_t strings;
+    uint64_t strings_len;
+};
+
+struct manifest_record_st {
+    uint64_t dir;
+    uint64_t name;
+    uint32_t dir_len;
+    uint32_t name_len;
+    uint64_t size;
+    uint64_t modified;
+    uint64_t checked;
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(manifest_header_st) == 32, "manifest header must be 32 bytes");
+static_assert(sizeof(manifest_record_st) == 56, "manifest record must be 56 bytes");
+
+
+// read-only, memory mapped view of a manifest file
+class Manifest {
+public:
+    Manifest();
+    Manifest(const Manifest&) = delete;
+    Manifest &operator=(const Manifest&) = delete;
+    ~Manifest();
+
+    bool open(const std::string&);
+    void close();
+    uint64_t size() const;
+    
+    // finds the records for directory path. On success [first, last)
+    // is the range of records, sorted by name
+    bool find(const std::string&, uint64_t& first, uint64_t& last) const;
+    int compare_name(const uint64_t, const std::string&) const;
+    File record(const uint64_t) const;
+    
+private:
+    int compare_dir(const manifest_record_st&, const std::string&) const;
+    
+    const uint8_t *_map;
+    size_t _map_len;
+    const manifest_header_st *_header;
+    const manifest_record_st *_records;
+    const char *_strings;
+};
+
+
+// path of the manifest for the disk mounted at mount, kept in directory dir
+std::string manifest_path(const std::string& dir, const std::string& mount);
+
+
+// collects file state during a pass and writes it out as a manifest
+class ManifestWriter {
+public:
+    void add(const File&);
+    void clear();
+    bool write(const std::string&);
+
+private:
+    std::vector<File> _files;
+};
+
+#endif
@@ -7,6 +7,8 @@
  *
  *
  * 12/8/2015 - Initial open source release
+ * 10/19/2026 - State change notifications
+ * 10/19/2026 - hangup()
  *
  */
 
@@ -14,6 +16,9 @@
 #define __SCHEDULABLE__
 
 #include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <string>
 
 
 typedef enum state_e : uint8_t {
@@ -35,6 +40,8 @@ public:
     virtual void run() = 0;
     virtual void wait() = 0;
     virtual void shutdown() = 0;
+    // SIGHUP, e.g. reopen log files. Can be called in any state
+    virtual void hangup() {}
     
     virtual state_e get_state() const
     {
@@ -58,8 +65,23 @@ public:
 	}
 	_state = s;
 	_state_lock.unlock();
+
+	_state_cv.notify_all();
+	if (_listener) {
+	    _listener();
+	}
+    }
+
+    // blocks the caller until the state is something other than s
+    void wait_for_change(const state_e& s)
+    {
+	std::unique_lock<std::recursive_mutex> l(_state_lock);
+	_state_cv.wait(l, [this, s]{ return (_state != s); });
     }
 
+    // called after every state change, from the thread that made it
+    void set_listener(const std::function<void()>& f) { _listener = f; }
+
     void state_lock() { _state_lock.lock(); }
     void state_unlock() { _state_lock.unlock(); }
     
@@ -67,6 +89,8 @@ protected:
     state_e _state;
     state_e _prev_state;
     std::recursive_mutex _state_lock;
+    std::condition_variable_any _state_cv;
+    std::function<void()> _listener;
 };
 
 
@@ -0,0 +1,382 @@
+/* Schedule Engine
+ * 
+ * Copyright (c) 2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <strings.h>
+
+#include "schedule.hpp"
+
+
+static const char *day_names[] = {"sun", "mon", "tue", "wed", "thu", "fri", "sat"};
+static const char *month_names[] = {"jan", "feb", "mar", "apr", "may", "jun",
+				    "jul", "aug", "sep", "oct", "nov", "dec"};
+
+
+static std::string trim(const std::string& s)
+{
+    size_t b = s.find_first_not_of(" \t");
+    size_t e = s.find_last_not_of(" \t");
+    
+    if (b == std::string::npos) {
+	return (std::string());
+    }
+    
+    return (s.substr(b, e - b + 1));
+}
+
+
+static std::vector<std::string> split(const std::string& s, const char delim)
+{
+    std::vector<std::string> ret;
+    std::istringstream in(s);
+    std::string item;
+
+    while (std::getline(in, item, delim)) {
+	ret.push_back(item);
+    }
+    
+    return (ret);
+}
+
+
+// a number, or one of the names (matched case insensitively) which map to offset + index
+static bool parse_value(const std::string& s, const char **names, const int count,
+			const int offset, int& value)
+{
+    if (s.empty()) {
+	return (false);
+    }
+
+    for (int i = 0; names && i < count; ++i) {
+	if (strcasecmp(s.c_str(), names[i]) == 0) {
+	    value = offset + i;
+	    return (true);
+	}
+    }
+
+    char *end;
+    long v = strtol(s.c_str(), &end, 10);
+    if (*end != '\0') {
+	return (false);
+    }
+    
+    value = v;
+    return (true);
+}
+
+
+/* Sets the bits for one cron field. Values must fall in [lo, hi], and are
+ * stored at bit (value - lo).
+ */
+template <size_t N>
+static bool parse_field(const std::string& field, const int lo, const int hi,
+			const char **names, const int name_count, const int name_offset,
+			std::bitset<N>& bits)
+{
+    bits.reset();
+    
+    std::vector<std::string> items = split(field, ',');
+    if (items.empty()) {
+	return (false);
+    }
+    
+    for (size_t i = 0; i < items.size(); ++i) {
+	std::string range = items[i];
+	int step = 1;
+	int first = lo;
+	int last = hi;
+	
+	size_t slash = range.find('/');
+	if (slash != std::string::npos) {
+	    if (!parse_value(range.substr(slash + 1), NULL, 0, 0, step) || step < 1) {
+		return (false);
+	    }
+	    range = range.substr(0, slash);
+	}
+
+	if (range != "*") {
+	    size_t dash = range.find('-');
+	    if (dash == std::string::npos) {
+		if (!parse_value(range, names, name_count, name_offset, first)) {
+		    return (false);
+		}
+		// a/n means from a to the end of the range
+		last = (slash == std::string::npos) ? first : hi;
+	    } else if (!parse_value(range.substr(0, dash), names, name_count, name_offset, first) ||
+		       !parse_value(range.substr(dash + 1), names, name_count, name_offset, last)) {
+		return (false);
+	    }
+	}
+	
+	if (first < lo || last > hi || first > last) {
+	    return (false);
+	}
+
+	for (int v = first; v <= last; v += step) {
+	    bits.set(v - lo);
+	}
+    }
+    
+    return (true);
+}
+
+
+CronExpr::CronExpr() : _mday_any(true), _wday_any(true) {}
+
+
+bool CronExpr::parse(const std::string& expr)
+{
+    std::istringstream in(expr);
+    std::vector<std::string> fields;
+    std::string f;
+    std::bitset<8> wdays;
+
+    while (in >> f) {
+	fields.push_back(f);
+    }
+    
+    if (fields.size() != 5 ||
+	!parse_field(fields[0], 0, 59, NULL, 0, 0, _minutes) ||
+	!parse_field(fields[1], 0, 23, NULL, 0, 0, _hours) ||
+	!parse_field(fields[2], 1, 31, NULL, 0, 0, _mdays) ||
+	!parse_field(fields[3], 1, 12, month_names, 12, 1, _months) ||
+	!parse_field(fields[4], 0, 7, day_names, 7, 0, wdays)) {
+	return (false);
+    }
+
+    // 7 is another name for Sunday
+    _wdays.reset();
+    for (int i = 0; i < 7; ++i) {
+	_wdays[i] = wdays[i];
+    }
+    _wdays[0] = _wdays[0] || wdays[7];
+    
+    _mday_any = (fields[2][0] == '*');
+    _wday_any = (fields[4][0] == '*');
+    
+    return (true);
+}
+
+
+bool CronExpr::matches(const struct tm& t) const
+{
+    if (!_minutes[t.tm_min] || !_hours[t.tm_hour] || !_months[t.tm_mon]) {
+	return (false);
+    }
+
+    bool mday = _mdays[t.tm_mday - 1];
+    bool wday = _wdays[t.tm_wday];
+
+    if (_mday_any || _wday_any) {
+	return (mday && wday);
+    }
+    return (mday || wday);
+}
+
+
+time_t CronExpr::next(const time_t t) const
+{
+    struct tm tm;
+    
+    localtime_r(&t, &tm);
+    tm.tm_sec = 0;
+    ++tm.tm_min;
+    tm.tm_isdst = -1;
+    mktime(&tm);
+
+    // step a day, an hour or a minute at a time depending on which field
+    // fails to match. Four years covers every combination including Feb 29
+    for (uint32_t i = 0; i < 4 * 366 * 24 * 60; ++i) {
+	bool day = _months[tm.tm_mon] &&
+	    ((_mday_any || _wday_any) ?
+	     (_mdays[tm.tm_mday - 1] && _wdays[tm.tm_wday]) :
+	     (_mdays[tm.tm_mday - 1] || _wdays[tm.tm_wday]));
+	
+	if (!day) {
+	    ++tm.tm_mday;
+	    tm.tm_hour = 0;
+	    tm.tm_min = 0;
+	} else if (!_hours[tm.tm_hour]) {
+	    ++tm.tm_hour;
+	    tm.tm_min = 0;
+	} else if (!_minutes[tm.tm_min]) {
+	    ++tm.tm_min;
+	} else {
+	    tm.tm_isdst = -1;
+	    return (mktime(&tm));
+	}
+	
+	tm.tm_isdst = -1;
+	mktime(&tm);
+    }
+
+    return (-1);
+}
+
+
+bool parse_hhmm(const std::string& s, uint32_t& minutes)
+{
+    int h, m;
+    char c;
+    std::istringstream in(s);
+
+    if (!(in >> h >> c >> m) || c != ':' || !in.eof() || h < 0 || h > 23 || m < 0 || m > 59) {
+	return (false);
+    }
+
+    minutes = h * 60 + m;
+    return (true);
+}
+
+
+bool Schedule::add_windows(const std::string& spec)
+{
+    std::vector<std::string> windows = split(spec, ';');
+
+    for (size_t i = 0; i < windows.size(); ++i) {
+	std::string w = trim(windows[i]);
+	TimeWindow tw;
+	
+	if (w.empty()) {
+	    continue;
+	}
+	
+	size_t space = w.find_first_of(" \t");
+	std::string times = w;
+	
+	if (space == std::string::npos) {
+	    tw.days.set();
+	} else {
+	    times = trim(w.substr(space));
+	    std::bitset<8> days;
+	    if (!parse_field(w.substr(0, space), 0, 7, day_names, 7, 0, days)) {
+		return (false);
+	    }
+	    for (int d = 0; d < 7; ++d) {
+		tw.days[d] = days[d];
+	    }
+	    tw.days[0] = tw.days[0] || days[7];
+	}
+
+	size_t dash = times.find('-');
+	if (dash == std::string::npos ||
+	    !parse_hhmm(times.substr(0, dash), tw.start) ||
+	    !parse_hhmm(times.substr(dash + 1), tw.stop)) {
+	    return (false);
+	}
+
+	_windows.push_back(tw);
+    }
+    
+    return (!_windows.empty());
+}
+
+
+void Schedule::add_window(const TimeWindow& w)
+{
+    _windows.push_back(w);
+}
+
+
+void Schedule::clear()
+{
+    _windows.clear();
+}
+
+
+bool Schedule::empty() const
+{
+    return (_windows.empty());
+}
+
+
+// t at minutes past local midnight, days_offset days from the day t falls on
+static time_t at_minute(const time_t t, const int days_offset, const uint32_t minutes)
+{
+    struct tm tm;
+    
+    localtime_r(&t, &tm);
+    tm.tm_mday += days_offset;
+    tm.tm_hour = minutes / 60;
+    tm.tm_min = minutes % 60;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    
+    return (mktime(&tm));
+}
+
+
+static int weekday(const time_t t, const int days_offset)
+{
+    struct tm tm;
+    
+    localtime_r(&t, &tm);
+    tm.tm_mday += days_offset;
+    tm.tm_hour = 12;
+    tm.tm_isdst = -1;
+    mktime(&tm);
+    
+    return (tm.tm_wday);
+}
+
+
+bool Schedule::in_window(const time_t t) const
+{
+    for (size_t i = 0; i < _windows.size(); ++i) {
+	const TimeWindow& w = _windows[i];
+	
+	// a window that wraps midnight may have opened yesterday
+	for (int d = -1; d <= 0; ++d) {
+	    if (!w.days[weekday(t, d)]) {
+		continue;
+	    }
+	    
+	    time_t open = at_minute(t, d, w.start);
+	    time_t close = at_minute(t, d + (w.stop <= w.start), w.stop);
+	    if (open <= t && t < close) {
+		return (true);
+	    }
+	}
+    }
+
+    return (false);
+}
+
+
+time_t Schedule::next_change(const time_t t) const
+{
+    time_t ret = -1;
+    
+    for (size_t i = 0; i < _windows.size(); ++i) {
+	const TimeWindow& w = _windows[i];
+	
+	for (int d = -1; d <= 7; ++d) {
+	    if (!w.days[weekday(t, d)]) {
+		continue;
+	    }
+	    
+	    time_t open = at_minute(t, d, w.start);
+	    time_t close = at_minute(t, d + (w.stop <= w.start), w.stop);
+	    
+	    if (open > t && (ret < 0 || open < ret)) {
+		ret = open;
+	    }
+	    if (close > t && (ret < 0 || close < ret)) {
+		ret = close;
+	    }
+	}
+    }
+
+    return (ret);
+}
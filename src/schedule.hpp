@@ -0,0 +1,84 @@
+/* Schedule Engine
+ * 
+ * Copyright (c) 2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#ifndef __SCHEDULE__
+#define __SCHEDULE__
+
+#include <string>
+#include <vector>
+#include <bitset>
+#include <cstdint>
+#include <ctime>
+
+
+// A standard five field cron expression:
+//
+//     minute hour day-of-month month day-of-week
+//
+// Each field is *, a number, a range a-b, a stepped range */n or a-b/n, or a
+// comma separated list of those. Day of week is 0-7 (0 and 7 are Sunday) and
+// may use Sun..Sat, months may use Jan..Dec. As in cron, if both day fields
+// are restricted a time matches when either of them does.
+class CronExpr {
+public:
+    CronExpr();
+    bool parse(const std::string&);
+    bool matches(const struct tm&) const;
+    // first matching minute strictly after t, or -1 if there is none
+    time_t next(const time_t t) const;
+    
+private:
+    std::bitset<60> _minutes;
+    std::bitset<24> _hours;
+    std::bitset<32> _mdays;
+    std::bitset<13> _months;
+    std::bitset<7>  _wdays;
+    bool _mday_any;
+    bool _wday_any;
+};
+
+
+// a daily period that opens on the given weekdays. stop <= start
+// means the window runs past midnight into the next day
+struct TimeWindow {
+    std::bitset<7> days;
+    uint32_t start;
+    uint32_t stop;
+};
+
+
+/* A set of time windows, written as
+ *
+ *     [days] HH:MM-HH:MM; [days] HH:MM-HH:MM; ...
+ *
+ * where days is a comma separated list of weekdays or ranges (Mon-Fri,Sun).
+ * Without days the window applies every day.
+ */
+class Schedule {
+public:
+    bool add_windows(const std::string&);
+    void add_window(const TimeWindow&);
+    void clear();
+    bool empty() const;
+    bool in_window(const time_t) const;
+    // next time after t at which any window opens or closes, or -1
+    time_t next_change(const time_t) const;
+
+private:
+    std::vector<TimeWindow> _windows;
+};
+
+
+// parses HH:MM into minutes since midnight, returns false if invalid
+bool parse_hhmm(const std::string&, uint32_t&);
+
+#endif
@@ -7,13 +7,19 @@
  *
  *
  * 12/8/2015 - Initial open source release
+ * 10/19/2026 - Event driven, wakes on state changes and deadlines
+ * 10/19/2026 - Cron and multi-window schedules
+ * 10/19/2026 - Run transitions on a thread pool
+ * 10/19/2026 - hangup
+ * 10/19/2026 - Reconfigure while running
  *
  */
 
 #include <unistd.h>
 #include <cassert>
+#include <ctime>
 #include <vector>
-#include <iostream>
+#include <algorithm>
 
 #include "scheduler.hpp"
 
@@ -24,35 +30,98 @@ Scheduler::~Scheduler()
     if (_scheduler_thread.joinable()) {
 	_scheduler_thread.join();
     }
+    _pool.wait_idle();
 
     for (map_it it = _s_map.begin(); it != _s_map.end(); ++it) {
-	delete it->second;
-	it->second = NULL;
+	delete it->second.s;
+	it->second.s = NULL;
     }
 }
 
 
-void Scheduler::configure(const mode_e& m,
+/* Can be called while running, the new schedule applies from the next
+ * decision. Reconfiguring with the settings already in use changes
+ * nothing, so a pending wait or cron fire isn't lost.
+ */
+bool Scheduler::configure(const mode_e& m,
 			  const std::string& first,
 			  const std::string& second)
 {
-    _mode = m;
+    uint32_t wait_minutes = 0;
+    Schedule schedule;
+    CronExpr cron;
+    
+    if (!parse(m, first, second, wait_minutes, schedule, cron)) {
+	return (false);
+    }
+
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	
+	if (_configured && m == _mode && first == _first && second == _second) {
+	    return (true);
+	}
+	
+	_configured = true;
+	_mode = m;
+	_first = first;
+	_second = second;
+	_wait_minutes = wait_minutes;
+	_schedule = schedule;
+	_cron = cron;
+	_next_change = -1;
+	_next_fire = -1;
+	for (map_it it = _s_map.begin(); it != _s_map.end(); ++it) {
+	    it->second.waiting = false;
+	    it->second.fired = false;
+	}
+    }
+
+    notify();
+    return (true);
+}
+
+
+bool Scheduler::valid(const mode_e& m, const std::string& first, const std::string& second)
+{
+    uint32_t wait_minutes;
+    Schedule schedule;
+    CronExpr cron;
+
+    return (parse(m, first, second, wait_minutes, schedule, cron));
+}
+
+
+bool Scheduler::parse(const mode_e& m, const std::string& first, const std::string& second,
+		      uint32_t& wait_minutes, Schedule& schedule, CronExpr& cron)
+{
     switch(m) {
     case RUN_ALWAYS:
     case RUN_STOP:
 	break;
     case RUN_WAIT:
-	assert(!first.empty());
-	_time1 = first;
-	break;
+	return (parse_hhmm(first, wait_minutes));
     case WINDOW:
-	assert(!first.empty() && !second.empty());
-	_time1 = first;
-	_time2 = second;
+	if (second.empty()) {
+	    return (schedule.add_windows(first));
+	} else {
+	    TimeWindow w;
+	    w.days.set();
+	    if (!parse_hhmm(first, w.start) || !parse_hhmm(second, w.stop)) {
+		return (false);
+	    }
+	    // the stop time is inclusive of its minute
+	    w.stop = (w.stop + 1) % (24 * 60);
+	    schedule.add_window(w);
+	}
 	break;
+    case CRON:
+	return (cron.parse(first));
     default:
-	assert(false);
+	return (false);
     }
+
+    return (true);
 }
 
 
@@ -71,12 +140,15 @@ void Scheduler::start()
 }
 
 
-void Scheduler::add(const std::string& name, Schedulable* s)
+void Scheduler::add(const std::string& name, Schedulable* s, const int priority)
 {
     _lock.lock();
 
-    s->init();
-    _s_map.insert(std::make_pair(name, s));
+    s->set_listener([this]{ notify(); });
+    sched_entry_st e = {s, priority, true, false, false, clock::time_point(), false};
+    sched_entry_st *ep = &_s_map.insert(std::make_pair(name, e)).first->second;
+    state_e c = s->get_state();
+    _pool.submit([this, ep, c]{ transition(ep, c, INIT); }, priority);
     
     _lock.unlock();
 }
@@ -84,30 +156,60 @@ void Scheduler::add(const std::string& name, Schedulable* s)
 
 void Scheduler::remove(const std::string& name)
 {
-    _lock.lock();
+    std::unique_lock<std::mutex> l(_lock);
     
     map_it it = _s_map.find(name);
 
     if (it != _s_map.end()) {
-	delete it->second;
-	it->second = NULL;
+	_idle_cv.wait(l, [it]{ return (!it->second.busy); });
+	delete it->second.s;
+	it->second.s = NULL;
 	_s_map.erase(it);
     }
-    
-    _lock.unlock();
 }
 
 
 void Scheduler::stop()
 {
     _running = false;
-    _lock.lock();
+    std::unique_lock<std::mutex> l(_lock);
+
+    // let running transitions finish. The scheduler thread can't queue
+    // more while we hold the lock
+    _idle_cv.wait(l, [this]{
+	    for (cmap_it it = _s_map.cbegin(); it != _s_map.cend(); ++it) {
+		if (it->second.busy) {
+		    return (false);
+		}
+	    }
+	    return (true);
+	});
     
     for (cmap_it it = _s_map.cbegin(); it != _s_map.cend(); ++it) {
-	it->second->shutdown();
+	it->second.s->shutdown();
     }
     
-    _lock.unlock();
+    l.unlock();
+    notify();
+}
+
+
+void Scheduler::hangup()
+{
+    std::lock_guard<std::mutex> l(_lock);
+
+    for (cmap_it it = _s_map.cbegin(); it != _s_map.cend(); ++it) {
+	it->second.s->hangup();
+    }
+}
+
+
+// wakes the scheduler thread so it re-evaluates every schedulable now
+void Scheduler::notify()
+{
+    std::lock_guard<std::mutex> l(_event_lock);
+    _event = true;
+    _event_cv.notify_one();
 }
 
 
@@ -117,7 +219,7 @@ std::unordered_map<std::string, state_e> Scheduler::get_states()
     _lock.lock();
 
     for (cmap_it it = _s_map.cbegin(); it != _s_map.cend(); ++it) {
-	ret.insert(std::make_pair(it->first, it->second->get_state()));
+	ret.insert(std::make_pair(it->first, it->second.s->get_state()));
     }
 
     _lock.unlock();
@@ -127,48 +229,95 @@ std::unordered_map<std::string, state_e> Scheduler::get_states()
 void Scheduler::main_thread()
 {
     std::vector<std::string> to_remove;
+
+    _lock.lock();
+    _next_change = -1;
+    _next_fire = -1;
+    _lock.unlock();
+    
     while (_running) {
 	_lock.lock();
-	for (cmap_it it = _s_map.cbegin(); it != _s_map.cend(); ++it) {
-	    it->second->state_lock();
+	update_times();
+	
+	for (map_it it = _s_map.begin(); it != _s_map.end(); ++it) {
+	    sched_entry_st *e = &it->second;
+	    
+	    if (e->busy) {
+		continue;
+	    }
+	    if (e->done) {
+		to_remove.push_back(it->first);
+		continue;
+	    }
 	    
-	    state_e c = it->second->get_state();
-	    state_e p = it->second->get_prev_state();
-	    state_e n = next_state(c, p);
+	    e->s->state_lock();
+	    state_e c = e->s->get_state();
+	    state_e p = e->s->get_prev_state();
+	    state_e n = next_state(*e, c, p);
+	    e->s->state_unlock();
 	    
 	    if (n != c) {
-		switch (n) {
-		case INIT:
-		    it->second->init();
-		    break;
-		case RUN:
-		    it->second->run();
-		    break;
-		case WAIT:
-		    it->second->wait();
-		    break;
-		case SHUTDOWN:
-		    it->second->shutdown();
-		    to_remove.push_back(it->first);
-		    break;
-		default:
-		    std::cout << "current " << c << "prev " << p << "next " << n << std::endl;
-		    assert(false);
-		}
+		e->busy = true;
+		_pool.submit([this, e, c, n]{ transition(e, c, n); }, e->priority);
 	    }
-	    it->second->state_unlock();
 	}
+	clock::time_point deadline = next_deadline();
 	_lock.unlock();
+	
 	for (uint32_t i = 0; i < to_remove.size(); ++i) {
 	    remove(to_remove[i]);
 	}
 	to_remove.clear();
-	sleep(5);
+
+	// sleep until something changes state or the next
+	// time based transition is due
+	std::unique_lock<std::mutex> l(_event_lock);
+	_event_cv.wait_until(l, deadline, [this]{ return (_event || !_running); });
+	_event = false;
     }
 }
 
 
-state_e Scheduler::next_state(const state_e& current, const state_e& prev)
+/* Runs on the pool. Moves e from state c to n, unless something else
+ * changed its state since the scheduler decided on the transition.
+ */
+void Scheduler::transition(sched_entry_st *e, const state_e c, const state_e n)
+{
+    e->s->state_lock();
+    
+    if (e->s->get_state() == c) {
+	switch (n) {
+	case INIT:
+	    e->s->init();
+	    break;
+	case RUN:
+	    e->s->run();
+	    break;
+	case WAIT:
+	    e->s->wait();
+	    break;
+	case SHUTDOWN:
+	    e->s->shutdown();
+	    break;
+	default:
+	    assert(false);
+	}
+    }
+    bool done = (e->s->get_state() == SHUTDOWN);
+    
+    e->s->state_unlock();
+
+    _lock.lock();
+    e->busy = false;
+    e->done = done;
+    _lock.unlock();
+    
+    _idle_cv.notify_all();
+    notify();
+}
+
+
+state_e Scheduler::next_state(sched_entry_st& e, const state_e& current, const state_e& prev)
 {
     if (!_running || current == SHUTDOWN) {
 	return (SHUTDOWN);
@@ -197,25 +346,19 @@ state_e Scheduler::next_state(const state_e& current, const state_e& prev)
 	    return (RUN);
 	}
 
-	if (current == WAIT && _time2.empty()) {
-	    _time2 = get_time();
+	if (current == WAIT && !e.waiting) {
+	    e.wait_until = clock::now() + std::chrono::minutes(_wait_minutes);
+	    e.waiting = true;
 	    return (current);
 	}
 
-	if (current == WAIT && !_time2.empty()) {
-	    std::pair<int, int> end, wait, now;
-	    end = parse_time(_time2);
-	    wait = parse_time(_time1);
-	    now = parse_time(get_time());
-	    
-	    if ((now.first - end.first >= wait.first) && (now.second - end.second >= wait.second)) {
-		_time2.clear();
-		return (INIT);
-	    }
+	if (current == WAIT && clock::now() >= e.wait_until) {
+	    e.waiting = false;
+	    return (INIT);
 	}
 	break;
     case WINDOW:
-	if (!in_window()) {
+	if (!_window_open) {
 	    return (WAIT);
 	}
 
@@ -226,51 +369,79 @@ state_e Scheduler::next_state(const state_e& current, const state_e& prev)
 	if (current == WAIT && prev == RUN) {
 	    return (INIT);
 	}
+	break;
+    case CRON:
+	if (current == WAIT && prev == INIT && e.fired) {
+	    e.fired = false;
+	    return (RUN);
+	}
+
+	if (current == WAIT && prev == RUN) {
+	    return (INIT);
+	}
+	break;
     }
     
     return (current);
 }
 
 
-std::string Scheduler::get_time() const
+/* Recomputes the window state and the next cron fire time, but only
+ * once the previously computed time has passed. Called with _lock held.
+ */
+void Scheduler::update_times()
 {
-    struct tm *timeinfo;
-    time_t rawtime;
-    char *time_buf;
-    
-    time(&rawtime);
-    timeinfo = localtime(&rawtime);
-    time_buf = asctime(timeinfo);
-    
-    std::string ret(time_buf);
-    if (!ret.empty() && ret[ret.length() - 1] == '\n') {
-	ret.erase(ret.length()-1);
+    time_t now = time(NULL);
+
+    if (_mode == WINDOW && (_next_change < 0 || now >= _next_change)) {
+	_window_open = _schedule.in_window(now);
+	_next_change = _schedule.next_change(now);
+    }
+
+    if (_mode == CRON) {
+	if (_next_fire >= 0 && now >= _next_fire) {
+	    for (map_it it = _s_map.begin(); it != _s_map.end(); ++it) {
+		it->second.fired = true;
+	    }
+	}
+	if (_next_fire < 0 || now >= _next_fire) {
+	    _next_fire = _cron.next(now);
+	}
     }
-    
-    return (ret);
 }
 
 
-std::pair<int, int> Scheduler::parse_time(const std::string& time) const
+/* Earliest time at which next_state() could give a different answer
+ * without any schedulable changing state. Called with _lock held.
+ */
+Scheduler::clock::time_point Scheduler::next_deadline() const
 {
-    std::pair<int, int> ret;
-    
-    size_t pos = time.find(":");
-    ret.first = std::stoi(time.substr(pos-2, 2));
-    ret.second =  std::stoi(time.substr(pos+1, 2));
+    // nothing time based pending, only state changes can wake us
+    clock::time_point ret = clock::now() + std::chrono::hours(24);
+    time_t wall = -1;
     
-    return (ret);
-}
-
+    switch (_mode) {
+    case RUN_WAIT:
+	for (cmap_it it = _s_map.cbegin(); it != _s_map.cend(); ++it) {
+	    if (it->second.waiting) {
+		ret = std::min(ret, it->second.wait_until);
+	    }
+	}
+	break;
+    case WINDOW:
+	wall = _next_change;
+	break;
+    case CRON:
+	wall = _next_fire;
+	break;
+    case RUN_ALWAYS:
+    case RUN_STOP:
+	break;
+    }
 
-bool Scheduler::in_window() const
-{
-    assert(_mode == WINDOW);
-    std::pair<int, int> time, stop_time, start_time;
-    time = parse_time(get_time());
-    start_time = parse_time(_time1);
-    stop_time = parse_time(_time2);
+    if (wall >= 0) {
+	ret = std::min(ret, clock::now() + std::chrono::seconds(wall - time(NULL)));
+    }
     
-    return (time.first >= start_time.first && time.first <= stop_time.first &&
-	    time.second >= start_time.second && time.second <= stop_time.second);
+    return (ret);
 }
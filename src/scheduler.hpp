@@ -7,6 +7,11 @@
  *
  *
  * 12/8/2015 - Initial open source release
+ * 10/19/2026 - Event driven, wakes on state changes and deadlines
+ * 10/19/2026 - Cron and multi-window schedules
+ * 10/19/2026 - Run transitions on a thread pool
+ * 10/19/2026 - hangup
+ * 10/19/2026 - Reconfigure while running
  *
  */
 
@@ -17,47 +22,110 @@
 #include <unordered_map>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 
 #include "schedulable.hpp"
+#include "schedule.hpp"
+#include "thread_pool.hpp"
 
 
 typedef enum mode_e {
     RUN_ALWAYS = 0,
     RUN_WAIT,
     RUN_STOP,
-    WINDOW
+    WINDOW,
+    CRON
 } mode_e;
 
     
 class Scheduler {
 public:
-    Scheduler() : _running(false), _mode(RUN_ALWAYS) {};
+    // threads is the number of transitions that can run at once
+    Scheduler(const uint32_t threads = 2) : _pool(threads), _running(false), _mode(RUN_ALWAYS),
+					    _configured(false), _event(false), _wait_minutes(0),
+					    _window_open(false), _next_change(-1), _next_fire(-1) {};
     ~Scheduler();
 
-    void configure(const mode_e& m, const std::string& first="", const std::string& second="");
+    /* RUN_WAIT:  first is the wait interval, HH:MM
+     * WINDOW:    first and second are the HH:MM start and stop times, or
+     *            first is a list of windows (see Schedule) and second is empty
+     * CRON:      first is a cron expression
+     *
+     * returns false if the times could not be parsed, the current
+     * schedule is kept
+     */
+    bool configure(const mode_e& m, const std::string& first="", const std::string& second="");
+    // whether configure() would accept these
+    static bool valid(const mode_e& m, const std::string& first="", const std::string& second="");
     void start();
-    void add(const std::string&, Schedulable*);
+    // schedulables with a higher priority get pool threads first
+    void add(const std::string&, Schedulable*, const int priority = 0);
     void remove(const std::string&);
     void stop();
+    // passes a SIGHUP on to every schedulable
+    void hangup();
     std::unordered_map<std::string, state_e> get_states();
+    void notify();
 
 private:
+    typedef std::chrono::steady_clock clock;
+
+    typedef struct sched_entry_st {
+	Schedulable *s;
+	int priority;
+	// a transition is queued or running on the pool. Transitions of
+	// one schedulable never overlap
+	bool busy;
+	// shut down, waiting to be removed
+	bool done;
+	// RUN_WAIT: when the current wait period ends
+	bool waiting;
+	clock::time_point wait_until;
+	// CRON: fired since the last run started
+	bool fired;
+    } sched_entry_st;
+    
+    static bool parse(const mode_e&, const std::string&, const std::string&,
+		      uint32_t&, Schedule&, CronExpr&);
     void main_thread();
-    state_e next_state(const state_e&, const state_e&);
-    std::string get_time() const;
-    std::pair<int, int> parse_time(const std::string&) const;
-    bool in_window() const;
+    void transition(sched_entry_st*, const state_e, const state_e);
+    state_e next_state(sched_entry_st&, const state_e&, const state_e&);
+    void update_times();
+    clock::time_point next_deadline() const;
     
-    typedef std::unordered_map<std::string, Schedulable*>::const_iterator cmap_it;
-    typedef std::unordered_map<std::string, Schedulable*>::iterator map_it;
-    std::unordered_map<std::string, Schedulable*> _s_map;
+    typedef std::unordered_map<std::string, sched_entry_st>::const_iterator cmap_it;
+    typedef std::unordered_map<std::string, sched_entry_st>::iterator map_it;
+    std::unordered_map<std::string, sched_entry_st> _s_map;
+    ThreadPool _pool;
     std::thread _scheduler_thread;
     std::mutex _lock;
-    bool _running;
+    // signalled when a transition finishes
+    std::condition_variable _idle_cv;
+    std::atomic<bool> _running;
     mode_e _mode;
-    std::string _time1;
-    std::string _time2;
-    
+    // what configure() was last given
+    bool _configured;
+    std::string _first;
+    std::string _second;
+
+    // set by notify(), the scheduler thread sleeps until
+    // this is set or the next deadline passes
+    std::mutex _event_lock;
+    std::condition_variable _event_cv;
+    bool _event;
+
+    uint32_t _wait_minutes;
+
+    // WINDOW: whether a window is open, and when that next changes.
+    // CRON: when the expression next fires. Both are only recomputed
+    // once the stored time passes
+    Schedule _schedule;
+    bool _window_open;
+    time_t _next_change;
+    CronExpr _cron;
+    time_t _next_fire;
 };
 
 
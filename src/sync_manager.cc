@@ -0,0 +1,490 @@
+/* Sync Manager
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ * 10/19/2026 - CRC taken while copying, sync_verify
+ * 10/19/2026 - parallel copies of large files
+ * 10/19/2026 - small files copied in batches
+ * 10/19/2026 - delta copies of large files
+ * 10/19/2026 - copies committed a directory at a time
+ * 10/19/2026 - compressed copies, sync_compress
+ *
+ */
+
+#include <iostream>
+#include <cassert>
+#include <algorithm>
+#include <unordered_set>
+#include <cerrno>
+#include <sys/stat.h>
+
+#include "sync_manager.hpp"
+#include "backup_manager.hpp"
+#include "common.hpp"
+
+
+// small files handed to the copier at once, between checks for shutdown
+#define SYNC_BATCH 4096
+// most sync_threads
+#define SYNC_THREADS_MAX 256
+
+
+SyncManager::SyncManager(const std::string& cfg) : _cfg(cfg), _files(0), _bytes(0)
+{
+    try {
+	ConfigParse config(cfg);
+
+	// the sync has its own log so the two never rotate the same file
+	std::string log = config.get_value("Settings", "sync_log_path");
+	_log = new Logger(log.empty() ? config.get_value("Settings", "log_path") + ".sync" : log);
+	BackupManager::configure_log(config, _log);
+	_db = BackupManager::open_db(config, _log);
+
+	_throttle = new Throttle(_log);
+	_throttles = new ThrottleRegistry(_throttle, _log);
+	configure_throttles(config);
+
+	std::string threads = config.get_value("Settings", "sync_threads");
+	int64_t count = 4;
+	if (!threads.empty() && !parse_number(threads, count, 1, SYNC_THREADS_MAX)) {
+	    throw ConfigParseEx("Invalid sync_threads \"" + threads + "\"");
+	}
+	_pool = new ThreadPool(count);
+	_copier = new CopyEngine(_log);
+	configure_copier(config);
+	
+	_pairs = read_pairs(config);
+    } catch (ConfigParseEx& e) {
+	std::cerr << e.what() << std::endl;
+	exit(EXIT_FAILURE);
+    }
+
+    _main_thread = std::thread(&SyncManager::worker, this);
+}
+
+
+SyncManager::~SyncManager()
+{
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+
+    set_state(SHUTDOWN);
+    _throttles->cancel();
+    
+    if (_main_thread.joinable()) {
+	_main_thread.join();
+    }
+
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+
+    delete _pool;
+    delete _copier;
+    delete _throttles;
+    delete _throttle;
+    delete _db;
+    delete _log;
+}
+
+
+bool SyncManager::wanted(const ConfigParse& config)
+{
+    std::vector<std::string> sections = config.get_sections();
+    
+    return (std::find(sections.begin(), sections.end(), "Sync") != sections.end());
+}
+
+
+// throws ConfigParseEx if an entry isn't source:destination
+std::vector<SyncManager::sync_pair_st> SyncManager::read_pairs(const ConfigParse& config)
+{
+    std::vector<sync_pair_st> ret;
+
+    if (!wanted(config)) {
+	return (ret);
+    }
+    
+    for (ConfigParse::const_iterator it = config.begin("Sync"); it != config.end("Sync"); ++it) {
+	size_t colon = it->second.find(':');
+	sync_pair_st p;
+	
+	if (colon == std::string::npos || colon == 0 || colon + 1 == it->second.size()) {
+	    throw ConfigParseEx("Invalid sync \"" + it->second + "\" for " + it->first);
+	}
+	p.src = it->second.substr(0, colon);
+	p.dst = it->second.substr(colon + 1);
+	// paths are built by appending to these
+	while (p.src.size() > 1 && p.src[p.src.size() - 1] == '/') {
+	    p.src.erase(p.src.size() - 1);
+	}
+	while (p.dst.size() > 1 && p.dst[p.dst.size() - 1] == '/') {
+	    p.dst.erase(p.dst.size() - 1);
+	}
+	ret.push_back(p);
+    }
+
+    return (ret);
+}
+
+
+void SyncManager::init()
+{
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+   
+    set_state(INIT);
+
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+}
+
+
+void SyncManager::run()
+{
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+    
+    set_state(RUN);
+    
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+}
+
+
+void SyncManager::wait()
+{
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+    
+    set_state(WAIT);
+    
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+}
+
+
+void SyncManager::shutdown()
+{
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+    
+    set_state(SHUTDOWN);
+    _throttles->cancel();
+    
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+}
+
+
+// throws ConfigParseEx before changing anything if a value is bad
+void SyncManager::configure_copier(const ConfigParse& config)
+{
+    // files this size and up are copied in ranges across the pool
+    double parallel = 1024.0 * 1024 * 1024;
+    std::string value = config.get_value("Settings", "sync_parallel_size");
+    
+    if (!value.empty() && !parse_rate(value, parallel)) {
+	throw ConfigParseEx("Invalid sync_parallel_size \"" + value + "\"");
+    }
+    // and only the changed blocks of files this size and up are written
+    double delta = 1024.0 * 1024 * 1024;
+    value = config.get_value("Settings", "sync_delta_size");
+    if (!value.empty() && !parse_rate(value, delta)) {
+	throw ConfigParseEx("Invalid sync_delta_size \"" + value + "\"");
+    }
+    std::string index = config.get_value("Settings", "sync_index_dir");
+    if (index.empty()) {
+	index = config.get_value("Settings", "manifest_dir");
+    }
+    // a zlib level, 0 copies as is
+    value = config.get_value("Settings", "sync_compress");
+    if (!value.empty() && (value.size() != 1 || value[0] < '0' || value[0] > '9')) {
+	throw ConfigParseEx("Invalid sync_compress \"" + value + "\"");
+    }
+
+    _copier->set_verify(config.get_value("Settings", "sync_verify") == "1");
+    _copier->set_durable(config.get_value("Settings", "sync_durable") != "0");
+    _copier->set_parallel(parallel > 0 ? _pool : NULL, parallel);
+    _copier->set_delta(index, delta);
+    _copier->set_compress(value.empty() ? 0 : value[0] - '0');
+}
+
+
+/* Copies have their own budget, sync_bps and sync_iops, but pause for
+ * the same host pressure as the scans. Throws ConfigParseEx, without
+ * changing anything, if a setting is wrong.
+ */
+void SyncManager::configure_throttles(const ConfigParse& config)
+{
+    double bps = 0, iops = 0, pressure, load, util;
+    std::string value = config.get_value("Settings", "sync_bps");
+    if (!value.empty() && !parse_rate(value, bps)) {
+	throw ConfigParseEx("Invalid sync_bps \"" + value + "\"");
+    }
+    value = config.get_value("Settings", "sync_iops");
+    if (!value.empty() && !parse_rate(value, iops)) {
+	throw ConfigParseEx("Invalid sync_iops \"" + value + "\"");
+    }
+    BackupManager::read_thresholds(config, pressure, load, util);
+
+    _throttle->set_limits(bps, iops);
+    _throttle->set_thresholds(pressure, load, 0);
+    _throttles->set_max_utilisation(util);
+}
+
+
+/* Reopens the log and rereads the log settings, the throttling, the
+ * copy settings and [Sync]. Changed pairs are used from the next
+ * pass. sync_threads needs a restart.
+ */
+void SyncManager::hangup()
+{
+    _log->reopen();
+
+    try {
+	ConfigParse config(_cfg);
+	std::vector<sync_pair_st> pairs = read_pairs(config);
+	
+	BackupManager::configure_log(config, _log);
+	configure_throttles(config);
+	configure_copier(config);
+	std::lock_guard<std::mutex> l(_pairs_lock);
+	_pairs = pairs;
+    } catch (std::exception& e) {
+	LOG(*_log, ERROR) << "Reload of " << _cfg << " failed: " << e.what() << std::endl;
+    }
+}
+
+
+void SyncManager::worker()
+{
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+    
+    Directory current_dir;
+    
+    while (_state != SHUTDOWN) {
+	state_e state = _state;
+	
+	LOG(*_log, DEBUG) << "Current state: " << state_to_str(state) << std::endl;
+	switch (state) {
+	case INIT:
+	    setup_pairs();
+	    current_dir = next_dir();
+	    wait();
+	    break;
+	case RUN:
+	    sync_dir(current_dir);
+	    current_dir = next_dir();
+	    if (current_dir.empty()) {
+		wait();
+	    }
+	    break;
+	case NONE:
+	case WAIT:
+	    wait_for_change(state);
+	    break;
+	case SHUTDOWN:
+	    break;
+	default:
+	    assert(false);
+	}
+    }
+
+    _db->thread_end();
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+}
+
+
+void SyncManager::setup_pairs()
+{
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+
+    {
+	std::lock_guard<std::mutex> l(_pairs_lock);
+	_pending = _pairs;
+    }
+    _disks.clear();
+    
+    for (uint32_t i = 0; i < _pending.size(); ++i) {
+	// only size and time are compared, the CRC is taken as it's copied
+	_disks.push_back(Disk(_pending[i].src, _log, _throttles->get(_pending[i].src), false));
+    }
+    _files = 0;
+    _bytes = 0;
+
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+}
+
+
+Directory SyncManager::next_dir()
+{
+    Directory ret;
+    
+    while (_disks.size()) {
+	ret = _disks[0].next_directory();
+	if (!ret.empty()) {
+	    break;
+	}
+	
+	if (_files) {
+	    LOG(*_log, INFO) << "Synced " << _pending[0].src << " to " << _pending[0].dst << ", "
+			     << _files << " files and " << _bytes << " bytes copied" << std::endl;
+	} else {
+	    LOG(*_log, DEBUG) << _pending[0].dst << " is up to date" << std::endl;
+	}
+	_files = 0;
+	_bytes = 0;
+	_disks.erase(_disks.begin());
+	_pending.erase(_pending.begin());
+    }
+
+    return (ret);
+}
+
+
+/* Copies the files in d that the destination doesn't have as they are
+ * now. The destination is up to date if the DB has a record for it with
+ * the source's size and time, and the file on disk still matches that,
+ * or the size it was stored at if it was compressed.
+ */
+void SyncManager::sync_dir(const Directory& d)
+{
+    LOG(*_log, DEBUG) << "Entering " << __PRETTY_FUNCTION__ << std::endl;
+    
+    if (d.empty() || _disks.empty()) {
+	LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+	return;
+    }
+
+    const sync_pair_st& p = _pending[0];
+    std::string dst_path = p.dst + d.path.substr(p.src.size());
+    Directory dst(dst_path, d.name, std::unordered_map<std::string, File>());
+    Directory known = _db->get(dst);
+    std::vector<copy_st> copies;
+    
+    for (file_cit it = d.files.cbegin(); it != d.files.cend(); ++it) {
+	file_cit k = known.files.find(it->first);
+	struct stat s;
+	
+	if (k != known.files.cend() && k->second.size == it->second.size &&
+	    k->second.modified == it->second.modified &&
+	    stat((dst_path + "/" + it->first).c_str(), &s) == 0 &&
+	    (uint64_t)s.st_size == (k->second.stored ? k->second.stored : it->second.size) &&
+	    (uint64_t)s.st_mtime == it->second.modified) {
+	    continue;
+	}
+	
+	copy_st c = {it->second, File(), 0, k != known.files.cend(), false, {0, 0}};
+	copies.push_back(c);
+    }
+
+    if (copies.empty()) {
+	LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+	return;
+    }
+
+    if (!make_dirs(dst_path)) {
+	LOG(*_log, ERROR) << "Cannot create " << dst_path << std::endl;
+	LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+	return;
+    }
+
+    Throttle *rd = _throttles->get(p.src);
+    Throttle *wr = _throttles->get(dst_path);
+    
+    // small files are copied in batches that this thread works on
+    // along with the pool, the rest get a task each
+    std::vector<uint32_t> small;
+    
+    for (uint32_t i = 0; i < copies.size(); ++i) {
+	copy_st *c = &copies[i];
+
+	if (c->src.size < COPY_SMALL_FILE) {
+	    small.push_back(i);
+	    continue;
+	}
+	
+	_pool->submit([this, c, dst_path, rd, wr]{
+		if (_state == SHUTDOWN) {
+		    return;
+		}
+		std::string in = c->src.path + "/" + c->src.name;
+		std::string out = dst_path + "/" + c->src.name;
+		
+		// the CRC comes from the copy, the file isn't read again
+		c->ok = _copier->copy(in, out, rd, wr, &c->crc, &c->stored);
+	    });
+    }
+
+    for (uint32_t i = 0; i < small.size() && _state != SHUTDOWN; i += SYNC_BATCH) {
+	std::vector<copy_item_st> batch;
+	uint32_t end = std::min((uint32_t)small.size(), i + SYNC_BATCH);
+	
+	for (uint32_t k = i; k < end; ++k) {
+	    const File& f = copies[small[k]].src;
+	    copy_item_st item = {f.path + "/" + f.name, dst_path + "/" + f.name, 0, false, {0, 0}};
+	    batch.push_back(item);
+	}
+	_copier->copy_batch(batch, rd, wr);
+	
+	for (uint32_t k = i; k < end; ++k) {
+	    copies[small[k]].ok = batch[k - i].ok;
+	    copies[small[k]].crc = batch[k - i].crc;
+	    copies[small[k]].stored = batch[k - i].stored;
+	}
+    }
+    _pool->wait_idle();
+
+    std::vector<std::string> failed = _copier->commit();
+    std::unordered_set<std::string> lost(failed.begin(), failed.end());
+
+    // the DB is only written from this thread
+    bool dir_known = _db->exists(dst);
+    for (uint32_t i = 0; i < copies.size(); ++i) {
+	copy_st& c = copies[i];
+	
+	if (!c.ok || lost.count(dst_path + "/" + c.src.name)) {
+	    continue;
+	}
+	c.dst = File(dst_path, c.src.name, NULL, false);
+	c.dst.crc = c.crc;
+	// a compressed copy is recorded with the size of what it holds
+	if (c.stored.size) {
+	    c.dst.size = c.src.size;
+	    c.dst.stored = c.stored.size;
+	    c.dst.stored_crc = c.stored.crc;
+	}
+	
+	LOG(*_log, INFO) << "Copied " << c.src.path << "/" << c.src.name << " to "
+			 << dst_path << std::endl;
+	++_files;
+	_bytes += c.dst.size;
+	c.dst.checked = std::time(NULL);
+	
+	if (!dir_known) {
+	    dst.files.insert(std::make_pair(c.dst.name, c.dst));
+	} else if (c.known) {
+	    _db->update(c.dst);
+	} else {
+	    _db->insert(c.dst);
+	}
+    }
+    if (!dst.files.empty()) {
+	_db->insert(dst);
+    }
+    
+    LOG(*_log, DEBUG) << "Leaving " << __PRETTY_FUNCTION__ << std::endl;
+}
+
+
+// creates path and any missing parents
+bool SyncManager::make_dirs(const std::string& path)
+{
+    struct stat s;
+    
+    if (stat(path.c_str(), &s) == 0) {
+	return (S_ISDIR(s.st_mode));
+    }
+
+    size_t slash = path.rfind('/');
+    if (slash != std::string::npos && slash > 0 && !make_dirs(path.substr(0, slash))) {
+	return (false);
+    }
+
+    return (mkdir(path.c_str(), 0755) == 0 || errno == EEXIST);
+}
@@ -0,0 +1,105 @@
+/* Sync Manager
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ * 10/19/2026 - CRC taken while copying, sync_verify
+ * 10/19/2026 - parallel copies of large files
+ * 10/19/2026 - copies committed a directory at a time
+ *
+ */
+
+#ifndef __SYNC_MANAGER__
+#define __SYNC_MANAGER__
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+
+#include "schedulable.hpp"
+#include "config_parse.hpp"
+#include "logger.hpp"
+#include "db.hpp"
+#include "disk.hpp"
+#include "throttle.hpp"
+#include "thread_pool.hpp"
+#include "copy_engine.hpp"
+
+
+/* Replicates each source in [Sync] to its destination, given as
+ * name=source:destination. Every pass walks the sources and copies the
+ * files that are new or have changed since they were last copied, which
+ * is known from the destination's records in the DB. Files are copied
+ * on a thread pool, and each copy is recorded in the DB with the CRC
+ * taken as it was copied. Files removed from a source are left on the
+ * destination. The copies into a directory are committed to disk
+ * together, and only recorded once they have been.
+ */
+class SyncManager : public Schedulable {
+public:
+    SyncManager(const std::string&);
+    ~SyncManager();
+    
+    void init();
+    void run();
+    void wait();
+    void shutdown();
+    void hangup();
+
+    // whether a config has anything for a SyncManager to do
+    static bool wanted(const ConfigParse&);
+
+private:
+    // test/sync_manager_test.cc
+    friend class SyncManagerTest;
+    
+    typedef struct sync_pair_st {
+	std::string src;
+	std::string dst;
+    } sync_pair_st;
+
+    typedef struct copy_st {
+	File src;
+	File dst;
+	uint32_t crc;
+	bool known;
+	bool ok;
+	copy_stored_st stored;
+    } copy_st;
+    
+    static std::vector<sync_pair_st> read_pairs(const ConfigParse&);
+    void configure_copier(const ConfigParse&);
+    void configure_throttles(const ConfigParse&);
+    void worker();
+    void setup_pairs();
+    Directory next_dir();
+    void sync_dir(const Directory&);
+    bool make_dirs(const std::string&);
+    
+    std::thread _main_thread;
+    std::string _cfg;
+    Logger *_log;
+    BackupManagerDB *_db;
+    Throttle *_throttle;
+    ThrottleRegistry *_throttles;
+    ThreadPool *_pool;
+    CopyEngine *_copier;
+
+    // the pairs from the config, and those left in the current pass
+    // with the walk of each one's source
+    std::mutex _pairs_lock;
+    std::vector<sync_pair_st> _pairs;
+    std::vector<sync_pair_st> _pending;
+    std::vector<Disk> _disks;
+
+    // for the current pass
+    uint64_t _files;
+    uint64_t _bytes;
+};
+
+#endif
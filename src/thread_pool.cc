@@ -0,0 +1,85 @@
+/* Thread Pool
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#include "thread_pool.hpp"
+
+
+ThreadPool::ThreadPool(const uint32_t threads) : _seq(0), _active(0), _stop(false)
+{
+    for (uint32_t i = 0; i < (threads ? threads : 1); ++i) {
+	_threads.push_back(std::thread(&ThreadPool::worker, this));
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	_stop = true;
+    }
+    _task_cv.notify_all();
+
+    for (size_t i = 0; i < _threads.size(); ++i) {
+	_threads[i].join();
+    }
+}
+
+
+void ThreadPool::submit(const std::function<void()>& task, const int priority)
+{
+    {
+	std::lock_guard<std::mutex> l(_lock);
+	_tasks.push({task, priority, _seq++});
+    }
+    _task_cv.notify_one();
+}
+
+
+void ThreadPool::wait_idle()
+{
+    std::unique_lock<std::mutex> l(_lock);
+    _idle_cv.wait(l, [this]{ return (_tasks.empty() && !_active); });
+}
+
+
+uint32_t ThreadPool::size() const
+{
+    return (_threads.size());
+}
+
+
+void ThreadPool::worker()
+{
+    std::unique_lock<std::mutex> l(_lock);
+    
+    while (true) {
+	_task_cv.wait(l, [this]{ return (_stop || !_tasks.empty()); });
+	if (_tasks.empty()) {
+	    // stopping, and nothing left to run
+	    return;
+	}
+
+	std::function<void()> fn = _tasks.top().fn;
+	_tasks.pop();
+	++_active;
+	
+	l.unlock();
+	fn();
+	l.lock();
+	
+	--_active;
+	if (_tasks.empty() && !_active) {
+	    _idle_cv.notify_all();
+	}
+    }
+}
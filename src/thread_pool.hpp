@@ -0,0 +1,71 @@
+/* Thread Pool
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#ifndef __THREAD_POOL__
+#define __THREAD_POOL__
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+
+/* A fixed set of worker threads that run submitted tasks. Higher priority
+ * tasks run first, tasks of equal priority run in the order submitted.
+ * Destroying the pool runs every task already queued, then joins the
+ * workers.
+ */
+class ThreadPool {
+public:
+    ThreadPool(const uint32_t threads);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool &operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    void submit(const std::function<void()>& task, const int priority = 0);
+    // blocks until the queue is empty and no task is running
+    void wait_idle();
+    uint32_t size() const;
+
+private:
+    typedef struct task_st {
+	std::function<void()> fn;
+	int priority;
+	uint64_t seq;
+
+	bool operator<(const task_st& t) const
+	{
+	    // priority_queue pops the largest element
+	    if (priority != t.priority) {
+		return (priority < t.priority);
+	    }
+	    return (seq > t.seq);
+	}
+    } task_st;
+    
+    void worker();
+    
+    std::vector<std::thread> _threads;
+    std::priority_queue<task_st> _tasks;
+    std::mutex _lock;
+    std::condition_variable _task_cv;
+    std::condition_variable _idle_cv;
+    uint64_t _seq;
+    uint32_t _active;
+    bool _stop;
+};
+
+
+#endif
@@ -0,0 +1,389 @@
+/* I/O Throttling
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ * 10/19/2026 - Per device throttles, idle I/O priority
+ *
+ */
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/sysmacros.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/ioprio.h>
+
+#include "throttle.hpp"
+
+
+// how often the pressure files are read, and how long a paused
+// consumer waits before looking again
+#define SAMPLE_INTERVAL std::chrono::seconds(1)
+
+
+TokenBucket::TokenBucket(const double rate, const double burst)
+{
+    set_rate(rate, burst);
+}
+
+
+void TokenBucket::set_rate(const double rate, const double burst)
+{
+    std::lock_guard<std::mutex> l(_lock);
+    
+    _rate = rate;
+    // default to one second's worth
+    _burst = burst > 0 ? burst : rate;
+    _tokens = _burst;
+    _last = clock::now();
+}
+
+
+double TokenBucket::rate() const
+{
+    std::lock_guard<std::mutex> l(_lock);
+    return (_rate);
+}
+
+
+void TokenBucket::consume(const double n)
+{
+    std::unique_lock<std::mutex> l(_lock);
+    
+    if (_rate <= 0) {
+	return;
+    }
+
+    clock::time_point now = clock::now();
+    _tokens = std::min(_burst, _tokens + _rate * std::chrono::duration<double>(now - _last).count());
+    _last = now;
+    _tokens -= n;
+    
+    if (_tokens >= 0) {
+	return;
+    }
+
+    std::chrono::duration<double> debt(-_tokens / _rate);
+    l.unlock();
+    std::this_thread::sleep_for(debt);
+}
+
+
+PressureMonitor::PressureMonitor(const std::string& proc) : _proc(proc), _pressure(-1), _load(0)
+{
+    sample();
+}
+
+
+void PressureMonitor::sample()
+{
+    std::string line;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double elapsed_ms = std::chrono::duration<double, std::milli>(now - _last).count();
+    
+    // some avg10=1.23 avg60=0.50 avg300=0.10 total=123456
+    std::ifstream pressure(_proc + "/pressure/io");
+    _pressure = -1;
+    while (std::getline(pressure, line)) {
+	if (line.compare(0, 5, "some ") == 0) {
+	    size_t pos = line.find("avg10=");
+	    if (pos != std::string::npos) {
+		_pressure = std::stod(line.substr(pos + 6));
+	    }
+	}
+    }
+
+    std::ifstream loadavg(_proc + "/loadavg");
+    if (!(loadavg >> _load)) {
+	_load = 0;
+    }
+
+    // major minor name, then 11 or more counters. The 10th counter is
+    // the milliseconds spent with I/O in flight
+    std::ifstream diskstats(_proc + "/diskstats");
+    while (std::getline(diskstats, line)) {
+	std::istringstream in(line);
+	unsigned int major, minor;
+	std::string name;
+	uint64_t v, ticks = 0;
+	int i;
+	
+	if (!(in >> major >> minor >> name)) {
+	    continue;
+	}
+	for (i = 0; i < 10 && (in >> v); ++i) {
+	    ticks = v;
+	}
+	if (i < 10) {
+	    continue;
+	}
+
+	dev_t dev = makedev(major, minor);
+	auto it = _disks.find(dev);
+	if (it == _disks.end()) {
+	    _disks.insert(std::make_pair(dev, disk_sample_st{ticks, -1}));
+	} else {
+	    if (elapsed_ms > 0) {
+		it->second.util = std::min(100.0, 100.0 * (ticks - it->second.io_ticks) / elapsed_ms);
+	    }
+	    it->second.io_ticks = ticks;
+	}
+    }
+    
+    _last = now;
+}
+
+
+double PressureMonitor::io_pressure() const
+{
+    return (_pressure);
+}
+
+
+double PressureMonitor::load() const
+{
+    return (_load);
+}
+
+
+double PressureMonitor::utilisation(const dev_t dev) const
+{
+    auto it = _disks.find(dev);
+    
+    if (it == _disks.end()) {
+	return (-1);
+    }
+    return (it->second.util);
+}
+
+
+double PressureMonitor::max_utilisation() const
+{
+    double ret = -1;
+    
+    for (auto it = _disks.cbegin(); it != _disks.cend(); ++it) {
+	ret = std::max(ret, it->second.util);
+    }
+    
+    return (ret);
+}
+
+
+Throttle::Throttle(Logger *log, const std::string& proc, Throttle *parent) : _log(log),
+									    _parent(parent),
+									    _monitor(proc),
+									    _max_pressure(0),
+									    _max_load(0),
+									    _max_util(0),
+									    _overloaded(false),
+									    _cancelled(false) {}
+
+
+void Throttle::set_limits(const double bps, const double iops)
+{
+    _bytes.set_rate(bps);
+    _ops.set_rate(iops);
+}
+
+
+void Throttle::set_thresholds(const double io_pressure, const double load, const double util)
+{
+    std::lock_guard<std::mutex> l(_lock);
+    
+    _max_pressure = io_pressure;
+    _max_load = load;
+    _max_util = util;
+}
+
+
+void Throttle::watch(const dev_t dev)
+{
+    std::lock_guard<std::mutex> l(_lock);
+
+    if (std::find(_devices.begin(), _devices.end(), dev) == _devices.end()) {
+	_devices.push_back(dev);
+    }
+}
+
+
+void Throttle::consume(const uint64_t bytes)
+{
+    std::unique_lock<std::mutex> l(_lock);
+    
+    while (!_cancelled && overloaded()) {
+	_cv.wait_for(l, SAMPLE_INTERVAL);
+    }
+    l.unlock();
+
+    _ops.consume(1);
+    _bytes.consume(bytes);
+    
+    if (_parent) {
+	_parent->consume(bytes);
+    }
+}
+
+
+void Throttle::cancel()
+{
+    _cancelled = true;
+    _cv.notify_all();
+    
+    if (_parent) {
+	_parent->cancel();
+    }
+}
+
+
+// called with _lock held. Resamples at most once per interval
+bool Throttle::overloaded()
+{
+    if (!_max_pressure && !_max_load && !_max_util) {
+	return (false);
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now < _next_sample) {
+	return (_overloaded);
+    }
+    _next_sample = now + SAMPLE_INTERVAL;
+    _monitor.sample();
+    
+    double util = -1;
+    if (_devices.empty()) {
+	util = _monitor.max_utilisation();
+    }
+    for (size_t i = 0; i < _devices.size(); ++i) {
+	util = std::max(util, _monitor.utilisation(_devices[i]));
+    }
+    
+    bool over = (_max_pressure > 0 && _monitor.io_pressure() > _max_pressure) ||
+	(_max_load > 0 && _monitor.load() > _max_load) ||
+	(_max_util > 0 && util > _max_util);
+
+    if (_log && over != _overloaded) {
+	if (over) {
+	    LOG(*_log, INFO) << "Pausing scan: io pressure " << _monitor.io_pressure()
+			     << "%, load " << _monitor.load() << ", utilisation " << util << "%" << std::endl;
+	} else {
+	    LOG(*_log, INFO) << "Resuming scan" << std::endl;
+	}
+    }
+    _overloaded = over;
+    
+    return (_overloaded);
+}
+
+
+ThrottleRegistry::ThrottleRegistry(Throttle *parent, Logger *log) : _parent(parent),
+								    _log(log),
+								    _max_util(0) {}
+
+
+ThrottleRegistry::~ThrottleRegistry()
+{
+    for (auto it = _throttles.begin(); it != _throttles.end(); ++it) {
+	delete it->second;
+    }
+}
+
+
+void ThrottleRegistry::set_max_utilisation(const double util)
+{
+    std::lock_guard<std::mutex> l(_lock);
+
+    _max_util = util;
+    for (auto it = _throttles.begin(); it != _throttles.end(); ++it) {
+	it->second->set_thresholds(0, 0, _max_util);
+    }
+}
+
+
+Throttle* ThrottleRegistry::get(const dev_t dev)
+{
+    std::lock_guard<std::mutex> l(_lock);
+    auto it = _throttles.find(dev);
+
+    if (it != _throttles.end()) {
+	return (it->second);
+    }
+
+    Throttle *t = new Throttle(_log, "/proc", _parent);
+    t->watch(dev);
+    t->set_thresholds(0, 0, _max_util);
+    _throttles.insert(std::make_pair(dev, t));
+    
+    return (t);
+}
+
+
+Throttle* ThrottleRegistry::get(const std::string& path)
+{
+    struct stat s;
+    
+    if (stat(path.c_str(), &s) != 0) {
+	return (_parent);
+    }
+    return (get(s.st_dev));
+}
+
+
+void ThrottleRegistry::cancel()
+{
+    std::lock_guard<std::mutex> l(_lock);
+    
+    for (auto it = _throttles.begin(); it != _throttles.end(); ++it) {
+	it->second->cancel();
+    }
+    if (_parent) {
+	_parent->cancel();
+    }
+}
+
+
+bool parse_rate(const std::string& s, double& rate)
+{
+    char *end;
+    
+    rate = strtod(s.c_str(), &end);
+    if (end == s.c_str() || rate < 0) {
+	return (false);
+    }
+
+    switch (*end) {
+    case 'G':
+    case 'g':
+	rate *= 1024;
+	// fall through
+    case 'M':
+    case 'm':
+	rate *= 1024;
+	// fall through
+    case 'K':
+    case 'k':
+	rate *= 1024;
+	++end;
+	break;
+    default:
+	break;
+    }
+
+    return (*end == '\0');
+}
+
+
+bool set_io_idle()
+{
+    // who 0 is the calling thread
+    return (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+		    IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0)) == 0);
+}
@@ -0,0 +1,164 @@
+/* I/O Throttling
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ * 10/19/2026 - Per device throttles, idle I/O priority
+ *
+ */
+
+#ifndef __THROTTLE__
+#define __THROTTLE__
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <sys/types.h>
+
+#include "logger.hpp"
+
+
+/* Limits a rate to so many units per second, with bursts of up to burst
+ * units. A consumer that takes more than is available goes into debt and
+ * sleeps until it is paid off, so requests larger than the burst still
+ * work. A rate of 0 is unlimited.
+ */
+class TokenBucket {
+public:
+    TokenBucket(const double rate = 0, const double burst = 0);
+    TokenBucket(const TokenBucket&) = delete;
+    TokenBucket &operator=(const TokenBucket&) = delete;
+
+    void set_rate(const double rate, const double burst = 0);
+    double rate() const;
+    void consume(const double n);
+    
+private:
+    typedef std::chrono::steady_clock clock;
+    
+    mutable std::mutex _lock;
+    double _rate;
+    double _burst;
+    double _tokens;
+    clock::time_point _last;
+};
+
+
+/* Samples host load from /proc. All values are as of the last call to
+ * sample(), utilisation is over the time between the last two samples.
+ */
+class PressureMonitor {
+public:
+    PressureMonitor(const std::string& proc = "/proc");
+    
+    void sample();
+    // percentage of the last 10s some task was stalled on I/O, -1 if
+    // the kernel doesn't have pressure stall information
+    double io_pressure() const;
+    // one minute load average
+    double load() const;
+    // percentage of time the device had I/O in flight, -1 if unknown
+    double utilisation(const dev_t) const;
+    // highest utilisation of any device
+    double max_utilisation() const;
+    
+private:
+    typedef struct disk_sample_st {
+	uint64_t io_ticks;
+	double util;
+    } disk_sample_st;
+    
+    std::string _proc;
+    double _pressure;
+    double _load;
+    std::unordered_map<dev_t, disk_sample_st> _disks;
+    std::chrono::steady_clock::time_point _last;
+};
+
+
+/* Rate limits and pauses the I/O done by a scan. Callers report each
+ * read or write with consume(), which blocks while the host is busier
+ * than the configured thresholds, then charges the bytes and one op to
+ * the token buckets, and then to the parent's. A threshold of 0
+ * disables that check.
+ */
+class Throttle {
+public:
+    Throttle(Logger* = NULL, const std::string& proc = "/proc", Throttle *parent = NULL);
+    Throttle(const Throttle&) = delete;
+    Throttle &operator=(const Throttle&) = delete;
+    
+    void set_limits(const double bps, const double iops);
+    void set_thresholds(const double io_pressure, const double load, const double util);
+    // only look at these devices for utilisation, default is all of them
+    void watch(const dev_t);
+    
+    void consume(const uint64_t bytes);
+    // wake up anything paused in consume() and stop pausing for good
+    void cancel();
+    
+private:
+    bool overloaded();
+    
+    Logger *_log;
+    Throttle *_parent;
+    TokenBucket _bytes;
+    TokenBucket _ops;
+    PressureMonitor _monitor;
+    std::vector<dev_t> _devices;
+    double _max_pressure;
+    double _max_load;
+    double _max_util;
+    
+    std::mutex _lock;
+    std::condition_variable _cv;
+    std::chrono::steady_clock::time_point _next_sample;
+    bool _overloaded;
+    std::atomic<bool> _cancelled;
+};
+
+
+/* One Throttle per device, so every path on a device shares its budget.
+ * Each is a child of parent, and pauses on its own device's utilisation.
+ */
+class ThrottleRegistry {
+public:
+    ThrottleRegistry(Throttle *parent, Logger* = NULL);
+    ThrottleRegistry(const ThrottleRegistry&) = delete;
+    ThrottleRegistry &operator=(const ThrottleRegistry&) = delete;
+    ~ThrottleRegistry();
+
+    // applies to every device, those already added and those to come
+    void set_max_utilisation(const double);
+    Throttle* get(const dev_t);
+    // the throttle for the device path is on, or the parent if it can't be stat'd
+    Throttle* get(const std::string& path);
+    void cancel();
+    
+private:
+    std::mutex _lock;
+    Throttle *_parent;
+    Logger *_log;
+    double _max_util;
+    std::unordered_map<dev_t, Throttle*> _throttles;
+};
+
+
+/* Parses a rate such as 500, 64K, 100M or 1G (powers of 1024),
+ * returns false if it isn't one.
+ */
+bool parse_rate(const std::string&, double&);
+
+// puts the calling thread in the idle I/O scheduling class
+bool set_io_idle();
+
+#endif
@@ -0,0 +1,155 @@
+/* Block Index Test Code
+ * 
+ * Copyright (c) 2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "block_index.hpp"
+#include "copy_engine.hpp"
+#include "crc32.hpp"
+
+#define INDEX_DIR "/tmp/block_index_test"
+#define SRC       INDEX_DIR "/src"
+#define DST       INDEX_DIR "/dst"
+#define BLOCK     (128 * 1024)
+
+
+static std::string read_file(const char *path)
+{
+    std::ifstream f(path, std::ios::binary);
+
+    return (std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>()));
+}
+
+
+static void write_file(const char *path, const std::string& data)
+{
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+
+    f.write(data.data(), data.size());
+}
+
+
+int main()
+{
+    std::string index = INDEX_DIR "/index.bmi";
+    BlockIndex w(BLOCK), r(BLOCK);
+    block_sum_st a, b;
+    struct stat s;
+
+    mkdir(INDEX_DIR, 0755);
+    write_file(SRC, std::string(3 * BLOCK + 100, 'a'));
+    assert(stat(SRC, &s) == 0);
+
+    // the last block is short
+    w.resize(s.st_size);
+    a = BlockIndex::sum((const uint8_t *)"abc", 3);
+    b = BlockIndex::sum((const uint8_t *)"abd", 3);
+    assert(!BlockIndex::same(a, b));
+    assert(BlockIndex::same(a, BlockIndex::sum((const uint8_t *)"abc", 3)));
+    w.set(0, a);
+    w.set(3, b);
+    assert(w.save(index, s));
+
+    assert(r.load(index, s));
+    assert(r.get(0, BLOCK, a) && BlockIndex::same(a, BlockIndex::sum((const uint8_t *)"abc", 3)));
+    assert(r.get(3, 100, b));
+    assert(!r.get(3, BLOCK, b));
+    assert(!r.get(4, 100, b));
+
+    // an index of a file that has changed since isn't used
+    s.st_mtim.tv_nsec += 1;
+    assert(!r.load(index, s));
+    s.st_mtim.tv_nsec -= 1;
+    assert(truncate(index.c_str(), 100) == 0);
+    assert(!r.load(index, s));
+
+    assert(block_index_path("/var/lib/bm", "/mnt/a%b") == "/var/lib/bm/%2Fmnt%2Fa%25b.bmi");
+    unlink(index.c_str());
+
+    Logger log("/tmp/block_index_test.log");
+    CopyEngine engine(&log);
+    CRC32 c(4096);
+    uint32_t crc;
+    std::string data;
+
+    for (uint32_t i = 0; i < 70 * BLOCK; ++i) {
+	data += (char)('A' + rand() % 26);
+    }
+    write_file(SRC, data);
+    unlink(DST);
+    engine.set_delta(INDEX_DIR, 1);
+
+    assert(engine.copy(SRC, DST, NULL, NULL, &crc));
+    if (engine.copied(COPY_CLONE)) {
+	std::cout << "reflinks work here, delta copies aren't used" << std::endl;
+	std::cout << "**** PASS ****" << std::endl;
+	return (0);
+    }
+    assert(engine.copied(COPY_DELTA) == 0);
+
+    // no index yet, the destination is read to compare
+    data[5 * BLOCK + 7] = 'a';
+    write_file(SRC, data);
+    assert(engine.copy(SRC, DST, NULL, NULL, &crc));
+    assert(engine.copied(COPY_DELTA) == 1);
+    assert(read_file(DST) == data);
+    assert((ssize_t)crc == c.crc32(SRC));
+    index = block_index_path(INDEX_DIR, DST);
+    assert(access(index.c_str(), F_OK) == 0);
+
+    // with the index the destination isn't read, so a block changed
+    // behind its back, times and all, is left alone
+    struct timespec times[2];
+    assert(stat(DST, &s) == 0);
+    times[0] = s.st_atim;
+    times[1] = s.st_mtim;
+    {
+	std::fstream f(DST, std::ios::binary | std::ios::in | std::ios::out);
+	f.seekp(BLOCK);
+	f.put('a');
+    }
+    assert(utimensat(AT_FDCWD, DST, times, 0) == 0);
+    data[65 * BLOCK] = 'a';
+    write_file(SRC, data);
+    assert(engine.copy(SRC, DST, NULL, NULL, &crc));
+    assert(engine.copied(COPY_DELTA) == 2);
+    std::string copied = read_file(DST);
+    assert(copied[65 * BLOCK] == 'a');
+    assert(copied[BLOCK] == 'a' && data[BLOCK] != 'a');
+
+    // shrinking and growing
+    data.resize(10 * BLOCK + 3);
+    write_file(SRC, data);
+    assert(engine.copy(SRC, DST, NULL, NULL, &crc));
+    data[BLOCK] = copied[BLOCK];
+    assert(read_file(DST) == data);
+    data += std::string(2 * BLOCK, 'z');
+    write_file(SRC, data);
+    assert(engine.copy(SRC, DST, NULL, NULL, &crc));
+    assert(read_file(DST) == data);
+    assert((ssize_t)crc == c.crc32(SRC));
+    assert(engine.copied(COPY_DELTA) == 4);
+
+    unlink(index.c_str());
+    unlink(SRC);
+    unlink(DST);
+    rmdir(INDEX_DIR);
+    std::cout << "**** PASS ****" << std::endl;
+    return (0);
+}
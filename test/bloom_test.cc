@@ -0,0 +1,49 @@
+/* Bloom Filter Test Code
+ * 
+ * Copyright (c) 2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ */
+
+#include <iostream>
+#include <cassert>
+#include <string>
+
+#include "bloom.hpp"
+
+
+int main()
+{
+    const uint32_t n = 100000;
+    BloomFilter b(n, 0.01, 1 << 20);
+    uint32_t fp = 0;
+
+    for (uint32_t i = 0; i < n; ++i) {
+	b.add("/mnt/disk/" + std::to_string(i));
+    }
+
+    // no false negatives
+    for (uint32_t i = 0; i < n; ++i) {
+	assert(b.maybe_contains("/mnt/disk/" + std::to_string(i)));
+    }
+
+    // roughly the requested false positive rate
+    for (uint32_t i = n; i < 2 * n; ++i) {
+	fp += b.maybe_contains("/mnt/disk/" + std::to_string(i));
+    }
+    assert(fp < n / 50);
+
+    b.clear();
+    assert(!b.maybe_contains("/mnt/disk/0"));
+
+    // the memory cap wins over the requested rate
+    BloomFilter small(n, 0.0001, 1024);
+    assert(small.bits() == 1024 * 8);
+    
+    std::cout << "**** PASS ****" << std::endl;
+    return (0);
+}
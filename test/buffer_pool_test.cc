@@ -0,0 +1,68 @@
+/* Buffer Pool Test Code
+ * 
+ * Copyright (c) 2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ */
+
+#include <iostream>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+
+#include "buffer_pool.hpp"
+
+
+int main()
+{
+    BufferPool& pool = BufferPool::instance();
+    uint8_t *a, *b;
+
+    // sizes are rounded up, and buffers aligned for O_DIRECT
+    a = pool.get(100);
+    assert(a && (uintptr_t)a % BUFFER_ALIGN == 0);
+    a[BUFFER_ALIGN - 1] = 1;
+    pool.put(a, 100);
+    
+    // a buffer given back is reused by the same thread, for any size
+    // that rounds up the same
+    b = pool.get(BUFFER_ALIGN);
+    assert(b == a);
+    pool.put(b, BUFFER_ALIGN);
+    assert(pool.cached() == 0);
+
+    {
+	Buffer huge(3 * 1024 * 1024);
+	assert(huge.data() && (uintptr_t)huge.data() % BUFFER_HUGE == 0);
+	assert(huge.size() == 3 * 1024 * 1024);
+	huge.data()[huge.size() - 1] = 1;
+    }
+    
+    // too big to keep
+    {
+	Buffer big((size_t)BUFFER_ALIGN << BUFFER_CLASSES);
+	assert(big.data());
+    }
+    assert(pool.cached() == 0);
+
+    // a thread gives its buffers to the shared list when it exits, and
+    // other threads take them from there
+    std::thread t([]{
+	    Buffer x(64 * 1024), y(64 * 1024), z(64 * 1024);
+	    assert(x.data() && y.data() && z.data());
+	});
+    t.join();
+    assert(pool.cached() == 3 * 64 * 1024);
+    {
+	Buffer x(64 * 1024);
+	assert(x.data() != NULL);
+	assert(pool.cached() == 2 * 64 * 1024);
+    }
+
+    std::cout << "**** PASS ****" << std::endl;
+    return (0);
+}
@@ -0,0 +1,54 @@
+/* LRU Cache Test Code
+ * 
+ * Copyright (c) 2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ */
+
+#include <iostream>
+#include <cassert>
+#include <string>
+
+#include "lru_cache.hpp"
+
+
+int main()
+{
+    LRUCache<int, std::string> c(2);
+    std::string v;
+
+    c.put(1, "one");
+    c.put(2, "two");
+    assert(c.get(1, v) && v == "one");
+
+    // 2 is now the least recently used
+    c.put(3, "three");
+    assert(c.size() == 2);
+    assert(!c.get(2, v));
+    assert(c.get(1, v) && v == "one");
+    assert(c.get(3, v) && v == "three");
+
+    c.put(3, "THREE");
+    assert(c.get(3, v) && v == "THREE");
+    
+    c.erase(3);
+    assert(!c.get(3, v));
+    assert(c.size() == 1);
+
+    c.set_capacity(0);
+    assert(c.size() == 0);
+    c.put(4, "four");
+    assert(!c.get(4, v));
+
+    c.set_capacity(4);
+    c.put(5, "five");
+    c.clear();
+    assert(!c.get(5, v));
+    
+    std::cout << "**** PASS ****" << std::endl;
+    return (0);
+}
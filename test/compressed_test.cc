@@ -0,0 +1,160 @@
+/* Compressed Copy Test Code
+ * 
+ * Copyright (c) 2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "compressed.hpp"
+#include "copy_engine.hpp"
+#include "thread_pool.hpp"
+#include "crc32.hpp"
+
+#define TEST_DIR "/tmp/compressed_test"
+#define SRC      TEST_DIR "/src"
+#define DST      TEST_DIR "/dst"
+
+
+static void write_file(const char *path, const std::string& data)
+{
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+
+    f.write(data.data(), data.size());
+}
+
+
+// every byte of the copy at path, read back through its frames
+static std::string read_back(const char *path)
+{
+    CompressedFile f;
+    std::string ret;
+
+    assert(f.open(path));
+    ret.resize(f.size());
+    assert(f.read(0, (uint8_t *)&ret[0], ret.size()) == (ssize_t)ret.size());
+
+    return (ret);
+}
+
+
+int main()
+{
+    Logger log("/tmp/compressed_test.log");
+    ThreadPool pool(4);
+    CopyEngine engine(&log);
+    CRC32 c(4096);
+    copy_stored_st stored;
+    struct stat s;
+    uint32_t crc;
+    std::string data;
+
+    mkdir(TEST_DIR, 0755);
+    engine.set_verify(true);
+    engine.set_parallel(&pool, 1);
+    engine.set_compress(6);
+
+    // text compresses, the random tail doesn't and is stored as it is
+    for (uint32_t i = 0; i < 5 * COMPRESSED_FRAME; ++i) {
+	data += "backup manager "[i % 15];
+    }
+    for (uint32_t i = 0; i < COMPRESSED_FRAME + 100; ++i) {
+	data += (char)rand();
+    }
+    write_file(SRC, data);
+
+    assert(engine.copy(SRC, DST, NULL, NULL, &crc, &stored));
+    assert(engine.copied(COPY_COMPRESS) == 1);
+    assert((ssize_t)crc == c.crc32(SRC));
+    assert(stat(DST, &s) == 0);
+    assert((uint64_t)s.st_size == stored.size && stored.size < data.size() / 2);
+    assert((ssize_t)stored.crc == c.crc32(DST));
+    assert(read_back(DST) == data);
+
+    // a read across frames only inflates the frames it needs
+    {
+	CompressedFile f;
+	char buffer[100];
+
+	assert(f.open(DST));
+	assert(f.size() == data.size() && f.crc() == crc);
+	assert(f.read(COMPRESSED_FRAME - 50, (uint8_t *)buffer, 100) == 100);
+	assert(memcmp(buffer, data.data() + COMPRESSED_FRAME - 50, 100) == 0);
+	assert(f.read(data.size() - 10, (uint8_t *)buffer, 100) == 10);
+	assert(f.read(data.size(), (uint8_t *)buffer, 100) == 0);
+	assert(f.check(crc));
+	assert(!f.check(crc + 1));
+    }
+
+    // a damaged frame is found without inflating anything
+    {
+	std::fstream f(DST, std::ios::binary | std::ios::in | std::ios::out);
+	char byte;
+
+	f.seekg(100);
+	f.get(byte);
+	f.seekp(100);
+	f.put(byte ^ 1);
+    }
+    {
+	CompressedFile f;
+	char buffer[100];
+
+	assert(f.open(DST));
+	assert(!f.check(crc));
+	assert(f.read(0, (uint8_t *)buffer, 100) < 0);
+    }
+
+    // not a compressed file at all
+    {
+	CompressedFile f;
+
+	assert(!f.open(SRC));
+    }
+
+    // small and empty files go through batches
+    std::vector<copy_item_st> batch;
+    const char *names[] = {TEST_DIR "/a", TEST_DIR "/b", TEST_DIR "/c"};
+    const std::string contents[] = {"", "hello", std::string(60000, 'x')};
+    for (uint32_t i = 0; i < 3; ++i) {
+	copy_item_st item = {names[i], std::string(names[i]) + ".z", 0, false, {0, 0}};
+
+	write_file(names[i], contents[i]);
+	batch.push_back(item);
+    }
+    engine.copy_batch(batch);
+    for (uint32_t i = 0; i < 3; ++i) {
+	assert(batch[i].ok);
+	assert(batch[i].stored.size > 0);
+	assert((ssize_t)batch[i].stored.crc == c.crc32(batch[i].out));
+	assert(read_back(batch[i].out.c_str()) == contents[i]);
+	unlink(names[i]);
+	unlink(batch[i].out.c_str());
+    }
+    assert(engine.copied(COPY_COMPRESS) == 4);
+
+    // with compression off copies are plain again
+    engine.set_compress(0);
+    assert(engine.copy(SRC, DST, NULL, NULL, &crc, &stored));
+    assert(stored.size == 0);
+    assert((ssize_t)crc == c.crc32(DST));
+
+    unlink(SRC);
+    unlink(DST);
+    rmdir(TEST_DIR);
+    std::cout << "**** PASS ****" << std::endl;
+    return (0);
+}
@@ -8,24 +8,41 @@
  *
  * 05/03/2014 - Initial open source release
  * 06/07/2014 - Changed computation of wall time to include microseconds
+ * 10/19/2026 - CopyEngine
+ * 10/19/2026 - Reflink and copy_file_range
+ * 10/19/2026 - Parallel copies
+ * 10/19/2026 - Durable copies, failed copies leave nothing behind
+ * 10/19/2026 - Batches of small, large and missing files
+ * 10/19/2026 - Sparse files
  */
 
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <sstream>
 #include <cassert>
 #include <cmath>
+#include <csignal>
 #include <string>
 #include <vector>
+#include <dirent.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 
 #include "crc32.hpp"
 #include "common.hpp"
+#include "copy_engine.hpp"
 
 
 
 #define OUT_FILE "/tmp/temp_out"
+#define TEST_DIR "/tmp/copy_test_dir"
+#define SPARSE_SIZE (8 << 20)
+// blocks a sparse copy may take beyond its source's, for the filesystem
+#define SPARSE_SLACK 128
 
 
 typedef bool (*copyfp_chunk)(const char*, const char*, const uint32_t);
@@ -44,6 +61,8 @@ char buffer[1024 * 1024];
 std::vector<size_t> files;
 std::vector<size_t> chunks;
 std::vector<copy_type_st> functions;
+CopyEngine *engine;
+CopyEngine *parallel;
 
 
 
@@ -74,6 +93,23 @@ static void buffer_init()
 
 
 
+// with the CRC, as the sync does
+static bool copyengine(const char *in, const char *out)
+{
+    uint32_t crc;
+    
+    return (engine->copy(in, out, NULL, NULL, &crc));
+}
+
+
+static bool copyparallel(const char *in, const char *out)
+{
+    uint32_t crc;
+    
+    return (parallel->copy(in, out, NULL, NULL, &crc));
+}
+
+
 static bool match(const char *in, const char *out)
 {
     CRC32 test(4096);
@@ -82,6 +118,270 @@ static bool match(const char *in, const char *out)
 }
 
 
+static void write_file(const std::string& path, const std::string& data)
+{
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+
+    f.write(data.data(), data.size());
+}
+
+
+static std::string read_file(const std::string& path)
+{
+    std::ifstream f(path, std::ios::binary);
+    std::stringstream s;
+
+    s << f.rdbuf();
+    return (s.str());
+}
+
+
+// files in TEST_DIR named like a copy's temporary, .name.XXXXXX
+static int temp_files()
+{
+    DIR *d = opendir(TEST_DIR);
+    struct dirent *entry;
+    int ret = 0;
+
+    while ((entry = readdir(d)) != NULL) {
+	std::string name = entry->d_name;
+	
+	if (name != "." && name != ".." && name[0] == '.') {
+	    ++ret;
+	}
+    }
+    closedir(d);
+
+    return (ret);
+}
+
+
+/* Durable copies wait for commit() to replace their destinations. A copy
+ * that fails, here by going past the file size limit, leaves both its
+ * destination and the directory as they were
+ */
+static void test_durable(Logger& log)
+{
+    CopyEngine e(&log);
+    const char *names[] = {"a", "b", "c"};
+    std::string in[3], out[3];
+
+    mkdir(TEST_DIR, 0755);
+    e.set_durable(true);
+    for (uint32_t i = 0; i < 3; ++i) {
+	in[i] = std::string(TEST_DIR "/src_") + names[i];
+	out[i] = std::string(TEST_DIR "/") + names[i];
+	write_file(in[i], std::string("new ") + names[i]);
+	write_file(out[i], std::string("old ") + names[i]);
+	assert(e.copy(in[i], out[i]));
+    }
+    for (uint32_t i = 0; i < 3; ++i) {
+	assert(read_file(out[i]) == std::string("old ") + names[i]);
+    }
+    assert(temp_files() == 3);
+    assert(e.commit().empty());
+    for (uint32_t i = 0; i < 3; ++i) {
+	assert(read_file(out[i]) == std::string("new ") + names[i]);
+    }
+    assert(temp_files() == 0);
+
+    struct rlimit limit, small;
+    assert(getrlimit(RLIMIT_FSIZE, &limit) == 0);
+    small = limit;
+    small.rlim_cur = 4096;
+    signal(SIGXFSZ, SIG_IGN);
+    write_file(in[0], std::string(8192, 'x'));
+    assert(setrlimit(RLIMIT_FSIZE, &small) == 0);
+    assert(!e.copy(in[0], out[0]));
+    assert(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+    assert(read_file(out[0]) == "new a");
+    assert(temp_files() == 0);
+    assert(e.commit().empty());
+    
+    for (uint32_t i = 0; i < 3; ++i) {
+	unlink(in[i].c_str());
+	unlink(out[i].c_str());
+    }
+}
+
+
+// a source that isn't there never costs the destination its contents
+static void test_missing_source(Logger& log)
+{
+    CopyEngine e(&log);
+    std::string missing = TEST_DIR "/missing";
+    std::string out = TEST_DIR "/kept";
+
+    mkdir(TEST_DIR, 0755);
+    write_file(out, "kept");
+    assert(!copyposix(missing.c_str(), out.c_str(), 4096));
+    assert(!copylinux(missing.c_str(), out.c_str()));
+    assert(!copyrange(missing.c_str(), out.c_str()));
+    assert(!e.copy(missing, out));
+    assert(read_file(out) == "kept");
+    assert(temp_files() == 0);
+    unlink(out.c_str());
+}
+
+
+/* A batch mixing small files, one too large to be copied whole from a
+ * buffer and a source that isn't there. Every item reports for itself
+ */
+static void test_batch(Logger& log)
+{
+    CopyEngine e(&log);
+    CRC32 c(4096);
+    std::vector<copy_item_st> batch;
+    std::vector<std::string> contents;
+
+    mkdir(TEST_DIR, 0755);
+    contents.push_back("");
+    contents.push_back("small");
+    contents.push_back(std::string(COPY_SMALL_FILE - 1, 's'));
+    contents.push_back(std::string(buffer, COPY_SMALL_FILE * 3 + 7));
+    for (uint32_t i = 0; i < contents.size(); ++i) {
+	copy_item_st item;
+
+	item.in = TEST_DIR "/in" + std::to_string(i);
+	item.out = TEST_DIR "/out" + std::to_string(i);
+	write_file(item.in, contents[i]);
+	batch.push_back(item);
+    }
+    copy_item_st missing;
+    missing.in = TEST_DIR "/missing";
+    missing.out = TEST_DIR "/out_missing";
+    batch.push_back(missing);
+
+    e.copy_batch(batch);
+    for (uint32_t i = 0; i < contents.size(); ++i) {
+	assert(batch[i].ok);
+	assert((ssize_t)batch[i].crc == c.crc32(batch[i].in));
+	assert(read_file(batch[i].out) == contents[i]);
+	unlink(batch[i].in.c_str());
+	unlink(batch[i].out.c_str());
+    }
+    assert(!batch.back().ok);
+    assert(access(missing.out.c_str(), F_OK) != 0);
+    assert(temp_files() == 0);
+}
+
+
+/* A file with holes at the start, in the middle and at the end, and 1 MB
+ * of data at 2 MB and 5 MB. Returns what it reads back as
+ */
+static std::string create_sparse(const std::string& path)
+{
+    std::string data(SPARSE_SIZE, '\0');
+    const off_t offsets[] = {2 << 20, 5 << 20};
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    assert(fd >= 0);
+    for (uint32_t i = 0; i < 2; ++i) {
+	assert(pwrite(fd, buffer, sizeof(buffer), offsets[i]) == sizeof(buffer));
+	data.replace(offsets[i], sizeof(buffer), buffer, sizeof(buffer));
+    }
+    assert(ftruncate(fd, SPARSE_SIZE) == 0);
+    assert(close(fd) == 0);
+
+    return (data);
+}
+
+
+// out reads back as data and takes no more space than in
+static void check_sparse(const std::string& in, const std::string& out, const std::string& data)
+{
+    struct stat s_in, s_out;
+
+    assert(read_file(out) == data);
+    assert(stat(in.c_str(), &s_in) == 0 && stat(out.c_str(), &s_out) == 0);
+    assert(s_out.st_size == s_in.st_size);
+    assert(s_out.st_blocks <= s_in.st_blocks + SPARSE_SLACK);
+}
+
+
+// an older copy, larger and with no holes, for a copy to go over
+static void write_older(const std::string& out)
+{
+    write_file(out, std::string(SPARSE_SIZE + (1 << 20), 'o'));
+}
+
+
+/* Holes in the source are holes in every kind of copy, including one
+ * over an older, larger file whose blocks where the holes go must be
+ * punched out
+ */
+static void test_sparse(Logger& log)
+{
+    std::string in = TEST_DIR "/sparse";
+    std::string out = TEST_DIR "/sparse_copy";
+    CopyEngine e(&log), delta(&log);
+    struct stat s;
+    int in_fd, out_fd;
+
+    mkdir(TEST_DIR, 0755);
+    std::string data = create_sparse(in);
+    assert(stat(in.c_str(), &s) == 0);
+    if ((uint64_t)s.st_blocks * 512 >= SPARSE_SIZE) {
+	std::cout << TEST_DIR << " doesn't keep holes, sparse copies not checked" << std::endl;
+	unlink(in.c_str());
+	return;
+    }
+
+    for (uint32_t older = 0; older < 2; ++older) {
+	unlink(out.c_str());
+	if (older) {
+	    write_older(out);
+	}
+	assert(copyposix(in.c_str(), out.c_str(), 65536));
+	check_sparse(in, out, data);
+	
+	if (older) {
+	    write_older(out);
+	}
+	assert(copylinux(in.c_str(), out.c_str()));
+	check_sparse(in, out, data);
+	
+	if (older) {
+	    write_older(out);
+	}
+	assert(copyrange(in.c_str(), out.c_str()));
+	check_sparse(in, out, data);
+	
+	if (older) {
+	    write_older(out);
+	}
+	assert(e.copy(in, out));
+	check_sparse(in, out, data);
+    }
+
+    // copies between open files keep what's already there, so the holes
+    // have to be punched
+    for (uint32_t i = 0; i < 3; ++i) {
+	write_older(out);
+	assert((in_fd = open(in.c_str(), O_RDONLY)) >= 0);
+	assert((out_fd = open(out.c_str(), O_RDWR)) >= 0);
+	assert(i == 0 ? copyposix(in_fd, out_fd, 65536, NULL, NULL, NULL) :
+	       i == 1 ? copylinux(in_fd, out_fd, NULL, NULL) :
+	       copyrange(in_fd, out_fd, NULL, NULL));
+	assert(close(in_fd) == 0 && close(out_fd) == 0);
+	check_sparse(in, out, data);
+    }
+
+    // so do delta copies, which write over the older copy in place.
+    // Where the copy can be a reflink there's no delta
+    delta.set_delta("", 1 << 20);
+    write_older(out);
+    assert(delta.copy(in, out));
+    write_older(out);
+    assert(delta.copy(in, out));
+    assert(delta.copied(COPY_CLONE) > 0 || delta.copied(COPY_DELTA) == 1);
+    check_sparse(in, out, data);
+
+    unlink(in.c_str());
+    unlink(out.c_str());
+}
+
+
 // Create a file of size megabytes
 // filled with random data
 static std::string create_file(size_t size) 
@@ -126,10 +426,37 @@ int main()
     copy.fp = copylinux;
     functions.push_back(copy);
 
+    copy.name = "Reflink";
+    copy.fp = copyclone;
+    functions.push_back(copy);
+
+    copy.name = "copy_file_range";
+    copy.fp = copyrange;
+    functions.push_back(copy);
+
     copy.name = "StreamBuffer";
     copy.fp = copystreambuff;
     functions.push_back(copy);
 
+    Logger log("/tmp/copy_test.log");
+    test_durable(log);
+    test_missing_source(log);
+    test_batch(log);
+    test_sparse(log);
+    rmdir(TEST_DIR);
+
+    engine = new CopyEngine(&log);
+    copy.name = "Copy Engine";
+    copy.fp = copyengine;
+    functions.push_back(copy);
+
+    ThreadPool pool(4);
+    parallel = new CopyEngine(&log);
+    parallel->set_parallel(&pool, 0);
+    copy.name = "Parallel Copy Engine";
+    copy.fp = copyparallel;
+    functions.push_back(copy);
+
     files.push_back(512);
     files.push_back(1024);
     files.push_back(1024 * 2);
@@ -167,6 +494,9 @@ int main()
 	    }
 	}
     }
+
+    delete engine;
+    delete parallel;
     
     return (0);
 }
@@ -10,11 +10,15 @@
  *
  *
  * 04/27/2014 - Initial open source release
+ * 10/19/2026 - sparse files and zero runs
+ * 10/19/2026 - combining CRCs
  */
 
 #include <iostream>
 #include <cassert>
+#include <cstring>
 #include <fcntl.h>
+#include <unistd.h>
 #include <zlib.h>
 
 #include "crc32.hpp"
@@ -55,6 +59,36 @@ int main()
     assert(zlib_crc32("crc32_test") == a.crc32("crc32_test"));
     assert(zlib_crc32("crc32_test.cc") == a.crc32("crc32_test.cc"));
 
+    // zero runs computed without any zeros
+    uint8_t zeros[100000];
+    memset(zeros, 0, sizeof(zeros));
+    const uint64_t runs[] = {0, 1, 2, 3, 7, 8, 1000, 4096, 65537, 100000};
+    for (uint32_t i = 0; i < sizeof(runs) / sizeof(runs[0]); ++i) {
+	uint32_t crc = crc32(0L, (const Bytef*)"abc", 3);
+	assert(a.zeros(crc, runs[i]) == crc32(crc, zeros, runs[i]));
+	assert(a.zeros(0, runs[i]) == crc32(0L, zeros, runs[i]));
+    }
+
+    // pieces computed apart and put together
+    const char *text = "the quick brown fox jumps over the lazy dog";
+    for (uint32_t i = 0; i <= strlen(text); ++i) {
+	uint32_t first = crc32(0L, (const Bytef*)text, i);
+	uint32_t second = crc32(0L, (const Bytef*)text + i, strlen(text) - i);
+	assert(a.combine(first, second, strlen(text) - i) ==
+	       crc32(0L, (const Bytef*)text, strlen(text)));
+    }
+
+    // a sparse file, with leading, inner and trailing holes
+    const char *sparse = "/tmp/crc32_test_sparse";
+    int fd = open(sparse, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    assert(pwrite(fd, "data", 4, 1 << 20) == 4);
+    assert(pwrite(fd, "more data", 9, 5 << 20) == 9);
+    assert(ftruncate(fd, 9 << 20) == 0);
+    close(fd);
+    assert(zlib_crc32(sparse) == a.crc32(sparse));
+    unlink(sparse);
+
     std::cout << "*** PASS ***" << std::endl;
     return (0);
 }
@@ -7,34 +7,64 @@
  *
  *
  * 11/28/2015- Initial open source release
+ * 10/19/2026- Concurrent lookups
+ * 10/19/2026- SQLite backend
+ * 10/19/2026- Bloom filter
+ * 10/19/2026- Stored size and CRC
+ * 10/19/2026- Caches cleared by set_db
  */
 
 #include <cassert>
 #include <iostream>
 #include <exception>
+#include <thread>
+#include <vector>
 
 #include "db.hpp"
+#include "db_sqlite.hpp"
+#ifndef NO_MYSQL
+#include "db_mysql.hpp"
+#endif
 #include "disk.hpp"
 
 static void usage()
 {
     std::cout << "db_test [log path] [DB IP] [DB User] [DB Pass] [Dir path]" << std::endl;
+    std::cout << "db_test [log path] sqlite [DB File] [Dir path]" << std::endl;
 }
 
 int main(int argc, char* argv[])
 {
-    if (argc != 6) {
+    bool sqlite = (argc == 5 && std::string(argv[2]) == "sqlite");
+    
+    if (argc != 6 && !sqlite) {
 	usage();
 	return (1);
     }
     
     Logger l(argv[1]);
-    BackupManagerDB db(argv[2], argv[3], argv[4], &l);
-    Disk disk(argv[5], &l);
+#ifndef NO_MYSQL
+    DBBackend *backend;
+    if (sqlite) {
+	backend = new SQLiteBackend(argv[3], &l);
+    } else {
+	backend = new MySQLBackend(argv[2], argv[3], argv[4], &l);
+    }
+    BackupManagerDB db(backend, &l);
+#else
+    if (!sqlite) {
+	usage();
+	return (1);
+    }
+    BackupManagerDB db(new SQLiteBackend(argv[3], &l), &l);
+#endif
+    Disk disk(argv[sqlite ? 4 : 5], &l);
     Directory dir;
+    std::vector<Directory> dirs;
 
     db.set_db("backup_manager_test", "Directories", "Files");
     db.init_tables();
+    db.enable_bloom(0.01, 1 << 20);
 
     try {
 	while (true) {
@@ -49,12 +79,42 @@ int main(int argc, char* argv[])
 
 	    for(auto f = dir.files.begin(); f != dir.files.end(); ++f) {
 		f->second.checked = 0xFFFF;
+		f->second.stored = 0x1FFFFFFFFULL;
+		f->second.stored_crc = 0xFFFFFFFF;
 		db.update(f->second);
 		auto tmp = db.get(dir);
 		auto r = tmp.files.find(f->first);
 		assert(r->second.checked == f->second.checked);
+		assert(r->second.stored == f->second.stored);
+		assert(r->second.stored_crc == f->second.stored_crc);
 	    }
+	    dirs.push_back(db.get(dir));
 	}
+
+	// every thread gets its own connection from the pool
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; ++i) {
+	    threads.push_back(std::thread([&db, &dirs] {
+		for (auto d = dirs.cbegin(); d != dirs.cend(); ++d) {
+		    assert(db.get(*d).identical(*d));
+		}
+		db.thread_end();
+	    }));
+	}
+	for (auto t = threads.begin(); t != threads.end(); ++t) {
+	    t->join();
+	}
+
+	// nothing cached from one DB is served from another
+	db.set_db("backup_manager_test", "Directories2", "Files2");
+	db.init_tables();
+	for (auto d = dirs.cbegin(); d != dirs.cend(); ++d) {
+	    assert(!db.exists(*d) && db.get(*d).files.empty());
+	}
+	db.drop_tables();
+	db.set_db("backup_manager_test", "Directories", "Files");
+	db.init_tables();
+	assert(dirs.empty() || db.get(dirs[0]).identical(dirs[0]));
     } catch (std::exception& e) {
 	std::cout << e.what() << std::endl;
 	db.drop_tables();
@@ -0,0 +1,117 @@
+/* Event Log Test Code
+ * 
+ * Copyright (c) 2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ */
+
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "event_log.hpp"
+
+#define EVENTS "test_events.bme"
+
+
+int main()
+{
+    EventLog w;
+    EventReader r;
+    Event e;
+
+    remove(EVENTS);
+    assert(w.open(EVENTS));
+    w.log(Event(EVENT_NEW, File("/mnt/a", "x", 1, 10, 0xAA)));
+    w.log(Event(EVENT_MISMATCH, File("/mnt/a", "y", 2, 20, 0xBB), File("/mnt/a", "y", 3, 15, 0xCC)));
+    w.close();
+
+    // reopening appends after what is there
+    assert(w.open(EVENTS));
+    w.log(Event(EVENT_MISSING, File("/mnt/b", "z", 4, 40, 0xDD)));
+    assert(w.flush());
+    
+    assert(r.open(EVENTS));
+    assert(r.next(e));
+    assert(e.type == EVENT_NEW && e.file.path == "/mnt/a" && e.file.name == "x");
+    assert(e.file.size == 1 && e.file.modified == 10 && e.file.crc == 0xAA);
+    assert(e.time > 0);
+    assert(r.next(e));
+    assert(e.type == EVENT_MISMATCH && e.file.name == "y" && e.file.crc == 0xBB);
+    assert(e.old.size == 3 && e.old.modified == 15 && e.old.crc == 0xCC);
+    assert(r.next(e));
+    assert(e.type == EVENT_MISSING && e.file.path == "/mnt/b");
+    assert(!r.next(e));
+    r.close();
+
+    // several threads logging at once, records must not interleave
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+	threads.push_back(std::thread([&w, t]{
+		    for (int i = 0; i < 10000; ++i) {
+			w.log(Event(EVENT_CHECKED, File("/mnt/t" + std::to_string(t),
+							std::to_string(i), i, i, t)));
+		    }
+		}));
+    }
+    for (uint32_t t = 0; t < threads.size(); ++t) {
+	threads[t].join();
+    }
+    w.close();
+
+    uint32_t count = 0;
+    assert(r.open(EVENTS));
+    while (r.next(e)) {
+	if (e.type == EVENT_CHECKED) {
+	    assert(e.file.path == "/mnt/t" + std::to_string(e.file.crc));
+	    assert(e.file.name == std::to_string(e.file.size));
+	    ++count;
+	}
+    }
+    assert(count == 40000);
+    r.close();
+
+    // a record cut short by a crash ends the log without an error
+    struct stat s;
+    assert(stat(EVENTS, &s) == 0);
+    assert(truncate(EVENTS, s.st_size - 3) == 0);
+    count = 0;
+    assert(r.open(EVENTS));
+    while (r.next(e)) {
+	++count;
+    }
+    assert(count == 40002);
+    r.close();
+
+    // reopening drops the torn record, so what is logged next can be read
+    assert(w.open(EVENTS));
+    w.log(Event(EVENT_NEW, File("/mnt/c", "w", 5, 50, 0xEE)));
+    w.close();
+    count = 0;
+    assert(r.open(EVENTS));
+    while (r.next(e)) {
+	++count;
+    }
+    assert(count == 40003);
+    assert(e.type == EVENT_NEW && e.file.path == "/mnt/c" && e.file.crc == 0xEE);
+    r.close();
+
+    assert(event_type_from_str("mismatch") == EVENT_MISMATCH);
+    assert(event_type_from_str("bogus") == 0);
+    
+    // not an event log
+    assert(truncate(EVENTS, 0) == 0);
+    assert(!r.open(EVENTS));
+    
+    remove(EVENTS);
+    std::cout << "**** PASS ****" << std::endl;
+    return (0);
+}
@@ -7,6 +7,10 @@
  *
  *
  * 04/29/2014 - Initial open source release
+ * 10/19/2026 - sync before counting, logging from many threads
+ * 10/19/2026 - LOG macro
+ * 10/19/2026 - rotation and reopen
+ * 10/19/2026 - nested lines, short lived threads
  */
 
 #include <iostream>
@@ -14,13 +18,23 @@
 #include <string>
 #include <cstdio>
 #include <cassert>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
 #include "logger.hpp"
 
-#define LOG "test_log.log"
+#define LOG_FILE "test_log.log"
+#define OTHER_FILE "test_log_other.log"
+#define ROTATE_DIR "test_log_rotate"
+#define ROTATE_FILE ROTATE_DIR "/test.log"
 
 static int count_lines()
 {
-    std::ifstream ifile(LOG);
+    std::ifstream ifile(LOG_FILE);
     if (!ifile) {
 	return (-1);
     }
@@ -29,26 +43,268 @@ static int count_lines()
     std::string line;
 
     while (std::getline(ifile, line)) {
-        ++num_lines;
+	++num_lines;
     }
 
     return (num_lines);
 }
 
+// every line is whole, and each thread's lines are in order
+static void test_threads()
+{
+    const int threads = 8;
+    const int lines = 20000;
+    
+    remove(LOG_FILE);
+    {
+	Logger l(LOG_FILE);
+	std::vector<std::thread> t;
+
+	l.set_level(DEBUG);
+	for (int i = 0; i < threads; ++i) {
+	    t.push_back(std::thread([&l, i]{
+			for (int j = 0; j < lines; ++j) {
+			    l << INFO << "thread " << i << " line " << j << std::endl;
+			}
+		    }));
+	}
+	for (int i = 0; i < threads; ++i) {
+	    t[i].join();
+	}
+    }
+
+    std::ifstream ifile(LOG_FILE);
+    std::string line;
+    std::vector<int> next(threads, 0);
+    int total = 0;
+    
+    while (std::getline(ifile, line)) {
+	int i, j;
+	size_t pos = line.find("] -- thread ");
+	
+	assert(pos != std::string::npos);
+	assert(sscanf(line.c_str() + pos, "] -- thread %d line %d", &i, &j) == 2);
+	assert(i >= 0 && i < threads && j == next[i]);
+	++next[i];
+	++total;
+    }
+    assert(total == threads * lines);
+}
+
+
+// a line to one logger started while another's is half built
+static void test_nested()
+{
+    remove(LOG_FILE);
+    remove(OTHER_FILE);
+    {
+	Logger a(LOG_FILE);
+	Logger b(OTHER_FILE);
+	std::string line;
+
+	a << ERROR << "outer ";
+	b << ERROR << "inner" << std::endl;
+	a << "line" << std::endl;
+	a.sync();
+	b.sync();
+
+	std::ifstream fa(LOG_FILE);
+	assert(std::getline(fa, line) && line.find("] -- outer line") != std::string::npos);
+	std::ifstream fb(OTHER_FILE);
+	assert(std::getline(fb, line) && line.find("] -- inner") != std::string::npos);
+	assert(line.find("outer") == std::string::npos);
+    }
+    remove(OTHER_FILE);
+}
+
+
+// threads that exit leave their lines behind, and not their rings
+static void test_thread_exit()
+{
+    const int threads = 500;
+    
+    remove(LOG_FILE);
+    Logger l(LOG_FILE);
+    
+    for (int i = 0; i < threads; ++i) {
+	std::thread t([&l, i]{ l << ERROR << "thread " << i << std::endl; });
+	t.join();
+    }
+    l.sync();
+    assert(count_lines() == threads);
+}
+
+
+static int evaluated = 0;
+
+static int count_call()
+{
+    return (++evaluated);
+}
+
+
+// disabled lines don't evaluate their arguments
+static void test_macro()
+{
+    remove(LOG_FILE);
+    Logger l(LOG_FILE);
+    
+    l.set_level(WARNING);
+    assert(!l.enabled(DEBUG) && !l.enabled(INFO));
+    assert(l.enabled(WARNING) && l.enabled(ERROR));
+    
+    LOG(l, DEBUG) << "skipped " << count_call() << std::endl;
+    LOG(l, INFO) << "skipped " << count_call() << std::endl;
+    assert(evaluated == 0);
+    
+    LOG(l, WARNING) << "logged " << count_call() << std::endl;
+    if (evaluated == 1)
+	LOG(l, ERROR) << "logged " << count_call() << std::endl;
+    else
+	assert(false);
+    assert(evaluated == 2);
+    
+    l.sync();
+    assert(count_lines() == 2);
+}
+
+
+// rotated segments of ROTATE_FILE, and the lines in them
+static std::vector<std::string> segments(int& lines)
+{
+    std::vector<std::string> ret;
+    DIR *d = opendir(ROTATE_DIR);
+    struct dirent *entry;
+    char buf[4096];
+
+    lines = 0;
+    while ((entry = readdir(d)) != NULL) {
+	std::string name = entry->d_name;
+	if (name.compare(0, 9, "test.log.") != 0) {
+	    continue;
+	}
+	ret.push_back(name);
+
+	gzFile f = gzopen((std::string(ROTATE_DIR "/") + name).c_str(), "rb");
+	int n;
+	while ((n = gzread(f, buf, sizeof(buf))) > 0) {
+	    lines += std::count(buf, buf + n, '\n');
+	}
+	gzclose(f);
+    }
+    closedir(d);
+
+    return (ret);
+}
+
+
+static void clear_rotate_dir()
+{
+    int lines;
+    std::vector<std::string> s = segments(lines);
+    
+    for (size_t i = 0; i < s.size(); ++i) {
+	remove((std::string(ROTATE_DIR "/") + s[i]).c_str());
+    }
+    remove(ROTATE_FILE);
+}
+
+
+static void test_rotate()
+{
+    int lines;
+    struct stat st;
+    
+    mkdir(ROTATE_DIR, 0755);
+    clear_rotate_dir();
+
+    // by size, keeping 3 segments
+    {
+	Logger l(ROTATE_FILE);
+	l.set_rotation(2000, 0, 3);
+	for (int i = 0; i < 200; ++i) {
+	    l << ERROR << "line " << i << std::endl;
+	    if (i % 10 == 0) {
+		l.sync();
+	    }
+	}
+	l.sync();
+
+	std::vector<std::string> s = segments(lines);
+	assert(s.size() == 3);
+	for (size_t i = 0; i < s.size(); ++i) {
+	    assert(stat((std::string(ROTATE_DIR "/") + s[i]).c_str(), &st) == 0);
+	    assert(st.st_size <= 2000);
+	}
+	assert(stat(ROTATE_FILE, &st) == 0 && st.st_size <= 2000);
+    }
+    clear_rotate_dir();
+
+    // compressed, every segment kept. Nothing is lost
+    {
+	Logger l(ROTATE_FILE);
+	l.set_rotation(2000, 0, 0, true);
+	for (int i = 0; i < 200; ++i) {
+	    l << ERROR << "line " << i << std::endl;
+	    if (i % 10 == 0) {
+		l.sync();
+	    }
+	}
+    }
+    std::vector<std::string> s = segments(lines);
+    assert(s.size() > 3);
+    for (size_t i = 0; i < s.size(); ++i) {
+	assert(s[i].compare(s[i].size() - 3, 3, ".gz") == 0);
+    }
+    std::ifstream current(ROTATE_FILE);
+    std::string line;
+    while (std::getline(current, line)) {
+	++lines;
+    }
+    assert(lines == 200);
+    clear_rotate_dir();
+
+    // reopen after the file was moved away
+    {
+	Logger l(ROTATE_FILE);
+	l << ERROR << "before" << std::endl;
+	l.sync();
+	assert(rename(ROTATE_FILE, ROTATE_FILE ".old") == 0);
+	l.reopen();
+	l << ERROR << "after" << std::endl;
+	l.sync();
+	assert(stat(ROTATE_FILE, &st) == 0);
+	std::ifstream f(ROTATE_FILE);
+	assert(std::getline(f, line) && line.find("after") != std::string::npos);
+    }
+    remove(ROTATE_FILE ".old");
+    clear_rotate_dir();
+    rmdir(ROTATE_DIR);
+}
+
+
 int main()
 {
-    remove(LOG);
-    Logger l(LOG);
+    remove(LOG_FILE);
+    Logger l(LOG_FILE);
     l.set_level(ERROR);
     l << "Hello" << std::endl;
     l << INFO << "Hello" << std::endl;
     l << WARNING << "Hello" << std::endl;
+    l.sync();
     assert(count_lines() == 0);
     l << ERROR << "Hello" << std::endl;
+    l.sync();
     assert(count_lines() == 1);
 
+    test_threads();
+    test_nested();
+    test_thread_exit();
+    test_macro();
+    test_rotate();
+
 
     std::cout << "**** PASS ****" << std::endl;
-    remove(LOG);
+    remove(LOG_FILE);
     return (0);
 }
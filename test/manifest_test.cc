@@ -0,0 +1,81 @@
+/* Manifest Test Code
+ * 
+ * Copyright (c) 2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ * 10/19/2026 - Records pointing outside the strings
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <unistd.h>
+
+#include "manifest.hpp"
+
+#define MANIFEST "test_manifest.bmm"
+
+
+int main()
+{
+    ManifestWriter w;
+    Manifest m;
+    uint64_t first, last;
+
+    // added out of order on purpose
+    w.add(File("/mnt/b", "z", 3, 30, 0xCC));
+    w.add(File("/mnt/a", "y", 2, 20, 0xBB));
+    w.add(File("/mnt/b", "a", 4, 40, 0xDD));
+    w.add(File("/mnt/a", "x", 1, 10, 0xAA));
+    w.add(File("/mnt/a/c", "x", 5, 50, 0xEE));
+    
+    assert(w.write(MANIFEST));
+    assert(m.open(MANIFEST));
+    assert(m.size() == 5);
+
+    assert(m.find("/mnt/a", first, last));
+    assert(last - first == 2);
+    assert(m.compare_name(first, "x") == 0);
+    assert(m.compare_name(first + 1, "y") == 0);
+    assert(m.compare_name(first, "y") < 0);
+    assert(m.record(first) == File("/mnt/a", "x", 1, 10, 0xAA));
+    assert(m.record(first).path == "/mnt/a");
+
+    assert(m.find("/mnt/b", first, last));
+    assert(last - first == 2);
+    assert(m.record(first).name == "a");
+    assert(m.record(last - 1).crc == 0xCC);
+    
+    assert(m.find("/mnt/a/c", first, last));
+    assert(last - first == 1);
+    
+    assert(!m.find("/mnt", first, last));
+    assert(!m.find("/mnt/c", first, last));
+    m.close();
+
+    // so must one with a name running past the end of the strings
+    {
+	std::fstream f(MANIFEST, std::ios::binary | std::ios::in | std::ios::out);
+	uint32_t len = 1000;
+
+	f.seekp(sizeof(manifest_header_st) + offsetof(manifest_record_st, name_len));
+	f.write((const char *)&len, sizeof(len));
+    }
+    assert(!m.open(MANIFEST));
+
+    // a truncated manifest must be rejected
+    assert(truncate(MANIFEST, 100) == 0);
+    assert(!m.open(MANIFEST));
+    
+    assert(manifest_path("/var/lib/bm", "/mnt/a%b") == "/var/lib/bm/%2Fmnt%2Fa%25b.bmm");
+    
+    remove(MANIFEST);
+    std::cout << "**** PASS ****" << std::endl;
+    return (0);
+}
@@ -0,0 +1,158 @@
+/* Schedule Test Code
+ * 
+ * Copyright (c) 2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ */
+
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <ctime>
+
+#include "schedule.hpp"
+
+
+// local time for the given date, month is 1-12
+static time_t at(int year, int month, int day, int hour, int min)
+{
+    struct tm t = {};
+    
+    t.tm_year = year - 1900;
+    t.tm_mon = month - 1;
+    t.tm_mday = day;
+    t.tm_hour = hour;
+    t.tm_min = min;
+    t.tm_isdst = -1;
+    
+    return (mktime(&t));
+}
+
+
+static void test_cron()
+{
+    CronExpr c;
+
+    assert(!c.parse(""));
+    assert(!c.parse("* * * *"));
+    assert(!c.parse("60 * * * *"));
+    assert(!c.parse("* 24 * * *"));
+    assert(!c.parse("* * 0 * *"));
+    assert(!c.parse("5-1 * * * *"));
+    assert(!c.parse("*/0 * * * *"));
+    assert(!c.parse("a * * * *"));
+    
+    assert(c.parse("* * * * *"));
+    assert(c.next(at(2026, 10, 19, 12, 0)) == at(2026, 10, 19, 12, 1));
+    // seconds within a minute still move on to the next minute
+    assert(c.next(at(2026, 10, 19, 12, 0) + 30) == at(2026, 10, 19, 12, 1));
+
+    assert(c.parse("30 2 * * *"));
+    assert(c.next(at(2026, 10, 19, 1, 0)) == at(2026, 10, 19, 2, 30));
+    assert(c.next(at(2026, 10, 19, 2, 30)) == at(2026, 10, 20, 2, 30));
+    assert(c.next(at(2026, 12, 31, 3, 0)) == at(2027, 1, 1, 2, 30));
+
+    // 10/19/2026 is a Monday
+    assert(c.parse("0 22 * * Mon-Fri"));
+    assert(c.next(at(2026, 10, 23, 23, 0)) == at(2026, 10, 26, 22, 0));
+    assert(c.parse("0 22 * * 0,6"));
+    assert(c.next(at(2026, 10, 19, 0, 0)) == at(2026, 10, 24, 22, 0));
+    assert(c.parse("0 22 * * 7"));
+    assert(c.next(at(2026, 10, 19, 0, 0)) == at(2026, 10, 25, 22, 0));
+
+    assert(c.parse("*/15 9-17/4 * * *"));
+    assert(c.next(at(2026, 10, 19, 9, 50)) == at(2026, 10, 19, 13, 0));
+    assert(c.next(at(2026, 10, 19, 13, 0)) == at(2026, 10, 19, 13, 15));
+    assert(c.next(at(2026, 10, 19, 17, 45)) == at(2026, 10, 20, 9, 0));
+
+    // both day fields restricted, either one matches
+    assert(c.parse("0 0 1 * Sun"));
+    assert(c.next(at(2026, 10, 19, 0, 0)) == at(2026, 10, 25, 0, 0));
+    assert(c.next(at(2026, 10, 25, 0, 0)) == at(2026, 11, 1, 0, 0));
+    assert(c.next(at(2026, 11, 1, 0, 0)) == at(2026, 11, 8, 0, 0));
+
+    assert(c.parse("0 0 29 Feb *"));
+    assert(c.next(at(2026, 10, 19, 0, 0)) == at(2028, 2, 29, 0, 0));
+    
+    assert(c.parse("0 0 31 2 *"));
+    assert(c.next(at(2026, 10, 19, 0, 0)) == -1);
+
+    struct tm t = {};
+    t.tm_year = 126;
+    t.tm_mon = 9;
+    t.tm_mday = 19;
+    t.tm_wday = 1;
+    assert(c.parse("0 0 * Oct Mon"));
+    assert(c.matches(t));
+    t.tm_min = 1;
+    assert(!c.matches(t));
+}
+
+
+static void test_windows()
+{
+    Schedule s;
+    uint32_t m;
+
+    assert(parse_hhmm("00:00", m) && m == 0);
+    assert(parse_hhmm("23:59", m) && m == 23 * 60 + 59);
+    assert(!parse_hhmm("24:00", m));
+    assert(!parse_hhmm("12:60", m));
+    assert(!parse_hhmm("12", m));
+    
+    assert(!s.add_windows(""));
+    assert(!s.add_windows("22:50"));
+    assert(!s.add_windows("Xyz 22:50-02:10"));
+    assert(s.empty());
+    
+    // wraps midnight
+    assert(s.add_windows("22:50-02:10"));
+    assert(!s.in_window(at(2026, 10, 19, 22, 49)));
+    assert(s.in_window(at(2026, 10, 19, 22, 50)));
+    assert(s.in_window(at(2026, 10, 19, 23, 30)));
+    assert(s.in_window(at(2026, 10, 20, 0, 5)));
+    assert(s.in_window(at(2026, 10, 20, 2, 9)));
+    assert(!s.in_window(at(2026, 10, 20, 2, 10)));
+    assert(!s.in_window(at(2026, 10, 20, 12, 0)));
+    assert(s.next_change(at(2026, 10, 20, 12, 0)) == at(2026, 10, 20, 22, 50));
+    assert(s.next_change(at(2026, 10, 20, 22, 50)) == at(2026, 10, 21, 2, 10));
+
+    // weekdays apply to the day the window opens
+    s.clear();
+    assert(s.add_windows("Mon-Fri 22:00-06:00; Sat,Sun 01:00-05:00"));
+    assert(s.in_window(at(2026, 10, 24, 3, 0)));     // Saturday, opened Friday
+    assert(!s.in_window(at(2026, 10, 24, 6, 30)));
+    assert(!s.in_window(at(2026, 10, 24, 22, 30)));  // Saturday night
+    assert(s.in_window(at(2026, 10, 25, 4, 0)));     // Sunday
+    assert(!s.in_window(at(2026, 10, 26, 4, 0)));    // Monday, no Sunday night window
+    assert(s.in_window(at(2026, 10, 26, 23, 0)));
+    assert(s.next_change(at(2026, 10, 24, 6, 30)) == at(2026, 10, 25, 1, 0));
+    assert(s.next_change(at(2026, 10, 25, 5, 0)) == at(2026, 10, 26, 22, 0));
+
+    // several windows on the same day
+    s.clear();
+    assert(s.add_windows("08:00-09:00; 12:00-13:00"));
+    assert(s.in_window(at(2026, 10, 19, 8, 30)));
+    assert(!s.in_window(at(2026, 10, 19, 10, 0)));
+    assert(s.in_window(at(2026, 10, 19, 12, 0)));
+    assert(s.next_change(at(2026, 10, 19, 8, 30)) == at(2026, 10, 19, 9, 0));
+    assert(s.next_change(at(2026, 10, 19, 9, 0)) == at(2026, 10, 19, 12, 0));
+}
+
+
+int main()
+{
+    // keep the expected times free of DST changes
+    setenv("TZ", "UTC", 1);
+    tzset();
+    
+    test_cron();
+    test_windows();
+
+    std::cout << "**** PASS ****" << std::endl;
+    return (0);
+}
@@ -7,16 +7,41 @@
  *
  *
  * 12/10/2015- Initial open source release
+ * 10/19/2026- Record states in the test object, transitions are no longer
+ *             slow enough to catch by polling
+ * 10/19/2026- Window times are plain HH:MM
+ * 10/19/2026- Slow transitions don't hold up other schedulables
+ * 10/19/2026- Reconfigure while running
  */
 
 #include <iostream>
 #include <unistd.h>
 #include <unordered_set>
 #include <cassert>
+#include <mutex>
 
 #include "scheduler.hpp"
 
 
+// every state a Test object has been put in
+static std::mutex seen_lock;
+static std::unordered_set<uint8_t> seen;
+
+static void record(const state_e s)
+{
+    std::lock_guard<std::mutex> l(seen_lock);
+    seen.insert(s);
+}
+
+static std::unordered_set<uint8_t> seen_states()
+{
+    std::lock_guard<std::mutex> l(seen_lock);
+    std::unordered_set<uint8_t> ret = seen;
+    seen.clear();
+    return (ret);
+}
+
+
 class Test : public Schedulable {
 public:
     std::thread t;
@@ -28,6 +53,7 @@ public:
 	}
     }
     void worker() { sleep(1); wait(); }
+    void set_state(const state_e& s) { record(s); Schedulable::set_state(s); }
     void init() { _state = INIT; wait(); }
     void wait() { set_state(WAIT); }
     void run()
@@ -38,7 +64,7 @@ public:
 	}
 	t = std::thread(&Test::worker, this);
     }
-    void shutdown() { _state = SHUTDOWN; }
+    void shutdown() { record(SHUTDOWN); _state = SHUTDOWN; }
 
     void print_state()
     {
@@ -64,10 +90,18 @@ public:
 };
 
 
+// init takes a long time
+class Slow : public Test {
+public:
+    void init() { sleep(10); Test::init(); }
+};
+
+
 static void test_start_stop()
 {
     std::unordered_set<uint8_t> states;
     
+    seen_states();
     Scheduler sch;
     sch.configure(RUN_STOP);
     sch.add("TEST", new Test());
@@ -80,14 +114,11 @@ static void test_start_stop()
 	    break;
 	}
 	
-	for (auto i = s.begin(); i != s.end(); ++i) {
-	    states.insert(i->second);
-	}
-	
 	++count;
 	sleep(1);
     }
 
+    states = seen_states();
     sch.stop();
     assert(states.find(RUN) != states.end() &&
 	   states.find(WAIT) != states.end());
@@ -98,6 +129,7 @@ static void test_start_wait()
 {
     std::unordered_set<uint8_t> states;
     
+    seen_states();
     Scheduler sch;
     sch.configure(RUN_WAIT, "00:01");
     sch.add("TEST", new Test());
@@ -110,14 +142,11 @@ static void test_start_wait()
 	    break;
 	}
 	
-	for (auto i = s.begin(); i != s.end(); ++i) {
-	    states.insert(i->second);
-	}
-	
 	++count;
 	sleep(1);
     }
 
+    states = seen_states();
     sch.stop();
     
     assert(states.find(RUN) != states.end() &&
@@ -130,6 +159,7 @@ static void test_run_always()
 {
     std::unordered_set<uint8_t> states;
     
+    seen_states();
     Scheduler sch;
     sch.configure(RUN_ALWAYS);
     sch.add("TEST", new Test());
@@ -142,14 +172,11 @@ static void test_run_always()
 	    break;
 	}
 	
-	for (auto i = s.begin(); i != s.end(); ++i) {
-	    states.insert(i->second);
-	}
-	
 	++count;
 	sleep(1);
     }
 
+    states = seen_states();
     sch.stop();
 
     assert(states.find(RUN) != states.end() &&
@@ -158,29 +185,24 @@ static void test_run_always()
 }
 
 
+// HH:MM, plus_mins from now
 static std::string get_time(int plus_mins)
 {
-    struct tm *timeinfo;
-    time_t rawtime;
-    char *time_buf;
-    
-    time(&rawtime);
-    timeinfo = localtime(&rawtime);
-    timeinfo->tm_min += plus_mins;
-    time_buf = asctime(timeinfo);
+    time_t t = time(NULL) + plus_mins * 60;
+    struct tm timeinfo;
+    char buf[8];
     
-    std::string ret(time_buf);
-    if (!ret.empty() && ret[ret.length() - 1] == '\n') {
-	ret.erase(ret.length()-1);
-    }
+    localtime_r(&t, &timeinfo);
+    strftime(buf, sizeof(buf), "%H:%M", &timeinfo);
     
-    return (ret);
+    return (std::string(buf));
 }
 
 static void test_run_window()
 {
     std::unordered_set<uint8_t> states;
     
+    seen_states();
     Scheduler sch;
     sch.configure(WINDOW, get_time(1), get_time(2));
     sch.add("TEST", new Test());
@@ -193,14 +215,11 @@ static void test_run_window()
 	    break;
 	}
 	
-	for (auto i = s.begin(); i != s.end(); ++i) {
-	    states.insert(i->second);
-	}
-	
 	++count;
 	sleep(1);
     }
 
+    states = seen_states();
     sch.stop();
     assert(states.find(RUN) != states.end() &&
 	   states.find(WAIT) != states.end() &&
@@ -208,6 +227,69 @@ static void test_run_window()
 }
 
 
+static void test_concurrent()
+{
+    Scheduler sch;
+    sch.configure(RUN_STOP);
+    sch.add("SLOW", new Slow());
+    sch.add("TEST", new Test());
+    sch.start();
+
+    // TEST runs and shuts down while SLOW is still in init
+    uint32_t count = 0;
+    while (count < 8) {
+	auto s = sch.get_states();
+	if (s.find("TEST") == s.end()) {
+	    break;
+	}
+	++count;
+	sleep(1);
+    }
+    
+    auto s = sch.get_states();
+    assert(s.size() == 1 && s.find("SLOW") != s.end());
+    sch.stop();
+}
+
+
+static void test_reconfigure()
+{
+    std::unordered_set<uint8_t> states;
+
+    assert(!Scheduler::valid(WINDOW, "25:00", "02:00"));
+    assert(Scheduler::valid(CRON, "*/5 * * * *"));
+    
+    seen_states();
+    Scheduler sch;
+    // a window that won't open during the test
+    sch.configure(WINDOW, get_time(120), get_time(121));
+    sch.add("TEST", new Test());
+    sch.start();
+    sleep(2);
+    
+    states = seen_states();
+    assert(states.find(RUN) == states.end());
+    // a bad schedule leaves the current one alone
+    assert(!sch.configure(RUN_WAIT, "bogus"));
+    sleep(1);
+    states = seen_states();
+    assert(states.find(RUN) == states.end());
+
+    // runs once and is removed
+    assert(sch.configure(RUN_STOP));
+    uint32_t count = 0;
+    while (count < 10 && sch.get_states().size()) {
+	++count;
+	sleep(1);
+    }
+    
+    states = seen_states();
+    assert(states.find(RUN) != states.end());
+    assert(sch.get_states().empty());
+    sch.stop();
+}
+
+
 int main()
 {
     std::cout << "These tests will take several minutes (5+) to run" << std::endl;
@@ -222,6 +304,12 @@ int main()
 
     std::cout << "Testing RUN_WINDOW scheduler ..." << std::endl;
     test_run_window();
+
+    std::cout << "Testing concurrent schedulables ..." << std::endl;
+    test_concurrent();
+
+    std::cout << "Testing reconfiguring while running ..." << std::endl;
+    test_reconfigure();
     
 
     std::cout << "**** PASS ****" << std::endl;
@@ -0,0 +1,193 @@
+/* Sync Manager Test Code
+ *
+ * Copyright (c) 2026 Bryant Moscon - bmoscon@gmail.com
+ *
+ * Please see the LICENSE file for the terms and conditions
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cassert>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <utility>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "sync_manager.hpp"
+#include "db_sqlite.hpp"
+#include "crc32.hpp"
+
+#define TEST_DIR "/tmp/sync_manager_test"
+#define SRC      TEST_DIR "/src"
+#define DST      TEST_DIR "/dst"
+#define CONFIG   TEST_DIR "/test.ini"
+#define DB_PATH  TEST_DIR "/test.sqlite"
+
+#define SETTINGS "[Settings]\n"					\
+    "log_path=" TEST_DIR "/test.log\n"				\
+    "db_backend=sqlite\n"					\
+    "db_path=" DB_PATH "\n"					\
+    "sync_threads=2\n"
+
+
+// reaches the parts of a SyncManager a pass is made of
+class SyncManagerTest {
+public:
+    static std::vector<SyncManager::sync_pair_st> read_pairs(const std::string& cfg)
+    {
+	return (SyncManager::read_pairs(ConfigParse(cfg)));
+    }
+
+    // one whole pass over every pair, returning the number of copies
+    static uint64_t pass(SyncManager& m)
+    {
+	uint64_t before = copies(m);
+
+	m.setup_pairs();
+	for (Directory d = m.next_dir(); !d.empty(); d = m.next_dir()) {
+	    m.sync_dir(d);
+	}
+
+	return (copies(m) - before);
+    }
+
+    static Directory known(SyncManager& m, const std::string& path)
+    {
+	return (m._db->get(Directory(path, "", std::unordered_map<std::string, File>())));
+    }
+
+private:
+    static uint64_t copies(SyncManager& m)
+    {
+	uint64_t ret = 0;
+
+	for (uint32_t i = 0; i < COPY_METHODS; ++i) {
+	    ret += m._copier->copied((copy_method_e)i);
+	}
+
+	return (ret);
+    }
+};
+
+
+static void write_file(const std::string& path, const std::string& data)
+{
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+
+    f.write(data.data(), data.size());
+}
+
+
+static std::string read_file(const std::string& path)
+{
+    std::ifstream f(path, std::ios::binary);
+    std::stringstream s;
+
+    s << f.rdbuf();
+    return (s.str());
+}
+
+
+static bool throws(const std::string& cfg)
+{
+    try {
+	SyncManagerTest::read_pairs(cfg);
+    } catch (ConfigParseEx& e) {
+	return (true);
+    }
+
+    return (false);
+}
+
+
+int main()
+{
+    CRC32 c(4096);
+    std::string big(3 * COPY_SMALL_FILE, 'b');
+
+    assert(system("rm -rf " TEST_DIR) == 0);
+    assert(mkdir(TEST_DIR, 0755) == 0);
+
+    // no [Sync] section, nothing to do
+    write_file(CONFIG, SETTINGS);
+    assert(!SyncManager::wanted(ConfigParse(CONFIG)));
+    assert(SyncManagerTest::read_pairs(CONFIG).empty());
+
+    // trailing slashes are dropped, but not from /. The pairs come in
+    // no particular order
+    write_file(CONFIG, SETTINGS "[Sync]\na=/mnt/a//:/mnt/b/\nb=/:/backup\n");
+    auto pairs = SyncManagerTest::read_pairs(CONFIG);
+    assert(pairs.size() == 2);
+    if (pairs[0].src == "/") {
+	std::swap(pairs[0], pairs[1]);
+    }
+    assert(pairs[0].src == "/mnt/a" && pairs[0].dst == "/mnt/b");
+    assert(pairs[1].src == "/" && pairs[1].dst == "/backup");
+
+    // each side must be there
+    write_file(CONFIG, SETTINGS "[Sync]\na=/mnt/a\n");
+    assert(throws(CONFIG));
+    write_file(CONFIG, SETTINGS "[Sync]\na=:/mnt/b\n");
+    assert(throws(CONFIG));
+    write_file(CONFIG, SETTINGS "[Sync]\na=/mnt/a:\n");
+    assert(throws(CONFIG));
+
+    // a small file, one in a subdirectory and one too big to batch
+    assert(mkdir(SRC, 0755) == 0 && mkdir(SRC "/sub", 0755) == 0);
+    write_file(SRC "/small", "backup manager");
+    write_file(SRC "/sub/inner", "sync manager");
+    write_file(SRC "/big", big);
+    write_file(CONFIG, SETTINGS "[Sync]\na=" SRC ":" DST "/\n");
+
+    {
+	SyncManager m(CONFIG);
+	Directory d;
+
+	assert(SyncManagerTest::pass(m) == 3);
+	assert(read_file(DST "/small") == "backup manager");
+	assert(read_file(DST "/sub/inner") == "sync manager");
+	assert(read_file(DST "/big") == big);
+
+	// each copy is recorded with the CRC taken as it was copied
+	d = SyncManagerTest::known(m, DST);
+	assert(d.files.size() == 2);
+	assert(d.files["small"].size == 14);
+	assert((ssize_t)d.files["small"].crc == c.crc32(DST "/small"));
+	assert((ssize_t)d.files["big"].crc == c.crc32(DST "/big"));
+	d = SyncManagerTest::known(m, DST "/sub");
+	assert(d.files.size() == 1);
+	assert((ssize_t)d.files["inner"].crc == c.crc32(DST "/sub/inner"));
+
+	// nothing changed, nothing copied
+	assert(SyncManagerTest::pass(m) == 0);
+
+	// only the file that changed is copied again, and its record updated
+	write_file(SRC "/small", "backup manager, again");
+	assert(SyncManagerTest::pass(m) == 1);
+	assert(read_file(DST "/small") == "backup manager, again");
+	d = SyncManagerTest::known(m, DST);
+	assert(d.files["small"].size == 21);
+	assert((ssize_t)d.files["small"].crc == c.crc32(DST "/small"));
+
+	// a destination that went missing is copied again
+	assert(unlink(DST "/sub/inner") == 0);
+	assert(SyncManagerTest::pass(m) == 1);
+	assert(read_file(DST "/sub/inner") == "sync manager");
+
+	// a file removed from the source is left on the destination
+	assert(unlink(SRC "/big") == 0);
+	assert(SyncManagerTest::pass(m) == 0);
+	assert(read_file(DST "/big") == big);
+    }
+
+    assert(system("rm -rf " TEST_DIR) == 0);
+    std::cout << "**** PASS ****" << std::endl;
+    return (0);
+}
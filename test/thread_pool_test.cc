@@ -0,0 +1,87 @@
+/* Thread Pool Test Code
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ */
+
+#include <iostream>
+#include <cassert>
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include "thread_pool.hpp"
+
+
+static void test_all_run()
+{
+    std::atomic<uint32_t> count(0);
+    
+    {
+	ThreadPool pool(4);
+	assert(pool.size() == 4);
+	
+	for (uint32_t i = 0; i < 1000; ++i) {
+	    pool.submit([&count]{ ++count; });
+	}
+	pool.wait_idle();
+	assert(count == 1000);
+
+	// the destructor runs whatever is still queued
+	for (uint32_t i = 0; i < 1000; ++i) {
+	    pool.submit([&count]{ ++count; });
+	}
+    }
+    assert(count == 2000);
+}
+
+
+static void test_priority()
+{
+    ThreadPool pool(1);
+    std::mutex lock;
+    std::condition_variable cv;
+    bool go = false;
+    std::vector<int> order;
+
+    // hold the only thread so everything below queues up
+    pool.submit([&]{
+	    std::unique_lock<std::mutex> l(lock);
+	    cv.wait(l, [&go]{ return (go); });
+	});
+
+    int prio[] = {0, 5, 1, 5, -1};
+    for (int i = 0; i < 5; ++i) {
+	pool.submit([&order, i]{ order.push_back(i); }, prio[i]);
+    }
+
+    {
+	std::lock_guard<std::mutex> l(lock);
+	go = true;
+    }
+    cv.notify_one();
+    pool.wait_idle();
+
+    // highest first, equal priorities in submission order
+    int expected[] = {1, 3, 2, 0, 4};
+    assert(order.size() == 5);
+    for (int i = 0; i < 5; ++i) {
+	assert(order[i] == expected[i]);
+    }
+}
+
+
+int main()
+{
+    test_all_run();
+    test_priority();
+    
+    std::cout << "**** PASS ****" << std::endl;
+    return (0);
+}
@@ -0,0 +1,202 @@
+/* Throttle Test Code
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ * 10/19/2026 - Per device throttles and rate parsing
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include "throttle.hpp"
+
+#define PROC "/tmp/throttle_test_proc"
+
+typedef std::chrono::steady_clock clk;
+
+
+static double elapsed(const clk::time_point& start)
+{
+    return (std::chrono::duration<double>(clk::now() - start).count());
+}
+
+
+static void write_proc(const double pressure, const double load, const uint64_t ticks)
+{
+    std::ofstream p(PROC "/pressure/io");
+    p << "some avg10=" << pressure << " avg60=0.00 avg300=0.00 total=1" << std::endl;
+    p << "full avg10=0.00 avg60=0.00 avg300=0.00 total=1" << std::endl;
+
+    std::ofstream l(PROC "/loadavg");
+    l << load << " 0.25 0.47 2/71 6631" << std::endl;
+
+    std::ofstream d(PROC "/diskstats");
+    d << "   8       0 sda 1 0 0 0 0 0 0 0 0 " << ticks << " 0 0 0 0 0 0 0" << std::endl;
+    d << "   8       1 sda1 1 0 0 0 0 0 0 0 0 0 0" << std::endl;
+}
+
+
+static void test_bucket()
+{
+    TokenBucket unlimited;
+    clk::time_point start = clk::now();
+    
+    unlimited.consume(1e12);
+    assert(elapsed(start) < 0.1);
+
+    // the first second's worth is already there, the next
+    // second's worth has to wait for it
+    TokenBucket b(1000);
+    start = clk::now();
+    b.consume(1000);
+    assert(elapsed(start) < 0.1);
+    for (int i = 0; i < 10; ++i) {
+	b.consume(100);
+    }
+    assert(elapsed(start) > 0.9 && elapsed(start) < 1.5);
+
+    // bigger than the burst
+    start = clk::now();
+    b.consume(500);
+    assert(elapsed(start) > 0.4 && elapsed(start) < 1.0);
+}
+
+
+static void test_monitor()
+{
+    write_proc(12.5, 3.5, 1000);
+    PressureMonitor m(PROC);
+    
+    assert(m.io_pressure() == 12.5);
+    assert(m.load() == 3.5);
+    // one sample isn't enough for utilisation
+    assert(m.utilisation(makedev(8, 0)) == -1);
+    assert(m.utilisation(makedev(9, 0)) == -1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    write_proc(0, 0.5, 1100);
+    m.sample();
+    assert(m.io_pressure() == 0);
+    assert(m.load() == 0.5);
+    double u = m.utilisation(makedev(8, 0));
+    assert(u > 40 && u <= 50.5);
+    assert(m.max_utilisation() == u);
+    assert(m.utilisation(makedev(8, 1)) == 0);
+
+    PressureMonitor none("/nonexistent");
+    assert(none.io_pressure() == -1 && none.max_utilisation() == -1);
+}
+
+
+static void test_pause()
+{
+    write_proc(50, 0, 0);
+    Throttle t(NULL, PROC);
+    clk::time_point start = clk::now();
+    
+    t.consume(1);
+    assert(elapsed(start) < 0.1);
+    
+    t.set_thresholds(10, 0, 0);
+    std::thread relieve([]{
+	    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+	    write_proc(5, 0, 0);
+	});
+    
+    // paused until pressure drops and the next sample sees it
+    start = clk::now();
+    t.consume(1);
+    assert(elapsed(start) > 1.4 && elapsed(start) < 3.5);
+    relieve.join();
+
+    write_proc(50, 0, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    std::thread cancel([&t]{
+	    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	    t.cancel();
+	});
+    start = clk::now();
+    t.consume(1);
+    assert(elapsed(start) > 0.4 && elapsed(start) < 1.5);
+    cancel.join();
+}
+
+
+static void test_registry()
+{
+    Throttle parent;
+    ThrottleRegistry r(&parent);
+    struct stat s;
+
+    assert(stat("/tmp", &s) == 0);
+    Throttle *t = r.get("/tmp");
+    assert(t && t != &parent);
+    assert(r.get(s.st_dev) == t);
+    assert(r.get("/nonexistent/path") == &parent);
+    
+    // children charge the parent too
+    parent.set_limits(1000, 0);
+    clk::time_point start = clk::now();
+    t->consume(1000);
+    t->consume(500);
+    assert(elapsed(start) > 0.4 && elapsed(start) < 1.0);
+
+    // and their own limits
+    parent.set_limits(0, 0);
+    t->set_limits(0, 10);
+    start = clk::now();
+    for (int i = 0; i < 15; ++i) {
+	t->consume(1);
+    }
+    assert(elapsed(start) > 0.4 && elapsed(start) < 1.0);
+}
+
+
+static void test_parse_rate()
+{
+    double r;
+
+    assert(parse_rate("500", r) && r == 500);
+    assert(parse_rate("1.5", r) && r == 1.5);
+    assert(parse_rate("64K", r) && r == 64 * 1024);
+    assert(parse_rate("100m", r) && r == 100 * 1024 * 1024);
+    assert(parse_rate("2G", r) && r == 2.0 * 1024 * 1024 * 1024);
+    assert(!parse_rate("", r));
+    assert(!parse_rate("M", r));
+    assert(!parse_rate("10X", r));
+    assert(!parse_rate("10MB", r));
+    assert(!parse_rate("-1", r));
+}
+
+
+int main()
+{
+    mkdir(PROC, 0755);
+    mkdir(PROC "/pressure", 0755);
+    
+    test_bucket();
+    test_monitor();
+    test_pause();
+    test_registry();
+    test_parse_rate();
+
+    unlink(PROC "/pressure/io");
+    unlink(PROC "/loadavg");
+    unlink(PROC "/diskstats");
+    rmdir(PROC "/pressure");
+    rmdir(PROC);
+    
+    std::cout << "**** PASS ****" << std::endl;
+    return (0);
+}
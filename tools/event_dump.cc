@@ -0,0 +1,183 @@
+/* Backup Manager Event Log Reader
+ * 
+ * Copyright (c) 2012-2026 Bryant Moscon - bmoscon@gmail.com
+ * 
+ * Please see the LICENSE file for the terms and conditions 
+ * associated with this software.
+ *
+ *
+ * 10/19/2026 - Initial version
+ *
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+
+#include "event_log.hpp"
+
+
+static void usage(const char *name)
+{
+    std::cerr << "usage: " << name << " [--csv | --json] [--type <type>[,<type>...]] "
+	"[--path <prefix>] [--since <time>] [--until <time>] <event log>..." << std::endl;
+    std::cerr << "    types are mismatch, missing, new and checked. times are seconds "
+	"since the epoch" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+
+static std::string json_str(const std::string& s)
+{
+    std::string ret = "\"";
+    char buf[8];
+    
+    for (size_t i = 0; i < s.size(); ++i) {
+	unsigned char c = s[i];
+	if (c == '"' || c == '\\') {
+	    ret += '\\';
+	    ret += c;
+	} else if (c < 0x20) {
+	    snprintf(buf, sizeof(buf), "\\u%04x", c);
+	    ret += buf;
+	} else {
+	    ret += c;
+	}
+    }
+    
+    return (ret + "\"");
+}
+
+
+static std::string csv_str(const std::string& s)
+{
+    if (s.find_first_of(",\"\n") == std::string::npos) {
+	return (s);
+    }
+
+    std::string ret = "\"";
+    for (size_t i = 0; i < s.size(); ++i) {
+	if (s[i] == '"') {
+	    ret += '"';
+	}
+	ret += s[i];
+    }
+    
+    return (ret + "\"");
+}
+
+
+int main(int argc, char* argv[])
+{
+    bool json = false;
+    bool types[EVENT_CHECKED + 1];
+    bool any_type = true;
+    std::string prefix;
+    uint64_t since = 0;
+    uint64_t until = UINT64_MAX;
+    int i;
+
+    memset(types, 0, sizeof(types));
+    
+    for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+	std::string arg = argv[i];
+	
+	if (arg == "--csv") {
+	    json = false;
+	} else if (arg == "--json") {
+	    json = true;
+	} else if (i + 1 == argc) {
+	    usage(argv[0]);
+	} else if (arg == "--type") {
+	    std::string list = argv[++i];
+	    size_t start = 0;
+	    any_type = false;
+	    while (start <= list.size()) {
+		size_t end = list.find(',', start);
+		if (end == std::string::npos) {
+		    end = list.size();
+		}
+		event_type_e t = event_type_from_str(list.substr(start, end - start));
+		if (!t) {
+		    usage(argv[0]);
+		}
+		types[t] = true;
+		start = end + 1;
+	    }
+	} else if (arg == "--path") {
+	    prefix = argv[++i];
+	} else if (arg == "--since") {
+	    since = strtoull(argv[++i], NULL, 10);
+	} else if (arg == "--until") {
+	    until = strtoull(argv[++i], NULL, 10);
+	} else {
+	    usage(argv[0]);
+	}
+    }
+
+    if (i == argc) {
+	usage(argv[0]);
+    }
+
+    if (json) {
+	std::cout << "[";
+    } else {
+	std::cout << "time,type,path,name,size,modified,crc,old_size,old_modified,old_crc\n";
+    }
+
+    bool first = true;
+    Event e;
+    EventReader reader;
+    
+    for (; i < argc; ++i) {
+	if (!reader.open(argv[i])) {
+	    std::cerr << "Cannot read event log " << argv[i] << std::endl;
+	    return (EXIT_FAILURE);
+	}
+
+	while (reader.next(e)) {
+	    if ((!any_type && (e.type > EVENT_CHECKED || !types[e.type])) ||
+		e.time < since || e.time > until ||
+		e.file.path.compare(0, prefix.size(), prefix) != 0) {
+		continue;
+	    }
+	    
+	    if (json) {
+		std::cout << (first ? "\n" : ",\n") << "{\"time\":" << e.time
+			  << ",\"type\":\"" << event_type_str(e.type) << "\""
+			  << ",\"path\":" << json_str(e.file.path)
+			  << ",\"name\":" << json_str(e.file.name)
+			  << ",\"size\":" << e.file.size
+			  << ",\"modified\":" << e.file.modified
+			  << ",\"crc\":" << e.file.crc;
+		if (e.type == EVENT_MISMATCH) {
+		    std::cout << ",\"old_size\":" << e.old.size
+			      << ",\"old_modified\":" << e.old.modified
+			      << ",\"old_crc\":" << e.old.crc;
+		}
+		std::cout << "}";
+	    } else {
+		std::cout << e.time << "," << event_type_str(e.type) << ","
+			  << csv_str(e.file.path) << "," << csv_str(e.file.name) << ","
+			  << e.file.size << "," << e.file.modified << "," << e.file.crc;
+		if (e.type == EVENT_MISMATCH) {
+		    std::cout << "," << e.old.size << "," << e.old.modified << "," << e.old.crc;
+		} else {
+		    std::cout << ",,,";
+		}
+		std::cout << "\n";
+	    }
+	    first = false;
+	}
+	
+	reader.close();
+    }
+
+    if (json) {
+	std::cout << (first ? "]\n" : "\n]\n");
+    }
+    
+    return (EXIT_SUCCESS);
+}